@@ -39,6 +39,7 @@
 #include <limits>
 #include <sstream>
 #include <stdexcept>
+#include <string>
 #include <unordered_map>
 
 #include "../memconsistency/cats.hpp"
@@ -100,15 +101,24 @@ class EvtStateCats {
   static_assert(kMinOther > kMaxWrite, "Invalid read/write ID limits!");
 
   explicit EvtStateCats(mc::cats::ExecWitness *ew, mc::cats::Architecture *arch)
-      : ew_(ew), arch_(arch), addr_mask_(~0) {}
+      : ew_(ew),
+        arch_(arch),
+        streaming_(nullptr),
+        addr_mask_(~0),
+        throw_obs_errors_(true) {}
 
   void Reset() {
     last_write_id_ = kMinWrite - 1;
     last_other_id = kMinOther - 1;
 
     writes_.clear();
+    obs_error_.clear();
     ew_->Clear();
     arch_->Clear();
+
+    if (streaming_ != nullptr) {
+      streaming_->Reset();
+    }
   }
 
   bool Exhausted() const {
@@ -153,7 +163,7 @@ class EvtStateCats {
       const mc::Event event =
           mc::Event(type, addr + offset, mc::Iiid(pid, last_other_id));
 
-      return &ew_->events.Insert(event, true);
+      return InsertEvent(event, true);
     });
   }
 
@@ -171,7 +181,7 @@ class EvtStateCats {
           mc::Event(type, addr + offset, mc::Iiid(pid, write_id));
 
       *(data + offset) = write_id;
-      return (writes_[write_id] = &ew_->events.Insert(event, true));
+      return (writes_[write_id] = InsertEvent(event, true));
     });
   }
 
@@ -222,11 +232,11 @@ class EvtStateCats {
                                                             : "");
           }
 
-          throw std::logic_error(oss.str());
+          ObsError<std::logic_error>(oss.str());
         }
 
         auto initial = mc::Event(mc::Event::kWrite, addr, mc::Iiid(-1, addr));
-        result[i] = &ew_->events.Insert(initial);
+        result[i] = InsertEvent(initial);
       }
 
       addr += sizeof(types::WriteID);
@@ -235,6 +245,106 @@ class EvtStateCats {
     return result;
   }
 
+  /**
+   * Reports an invalid observation (e.g. by Operation::UpdateObs): throws
+   * Exception(what), unless disabled via set_throw_obs_errors(false), in
+   * which case only the first is recorded (see obs_error()).
+   */
+  template <class Exception>
+  void ObsError(const std::string &what) {
+    if (throw_obs_errors_) {
+      throw Exception(what);
+    }
+
+    if (obs_error_.empty()) {
+      obs_error_ = what;
+    }
+  }
+
+  /**
+   * Where invalid observations are frequent (e.g. while bringing up a buggy
+   * design), unwinding is costly: if val is false, invalid observations are
+   * recorded instead of thrown. GetWrite then returns the initial write for
+   * invalid write-IDs, and Operation::UpdateObs may return false; the
+   * execution witness is then not the execution observed, which Check()
+   * reports.
+   */
+  void set_throw_obs_errors(bool val) { throw_obs_errors_ = val; }
+
+  bool throw_obs_errors() const { return throw_obs_errors_; }
+
+  /**
+   * @return First invalid observation since Reset() which was not thrown;
+   *         empty if none.
+   */
+  const std::string &obs_error() const { return obs_error_; }
+
+  /**
+   * Checks the execution witness with checker (see
+   * memconsistency::cats::Checker::check). If an observation was invalid (see
+   * obs_error()), the witness does not reflect the execution observed, and
+   * the result is kIllFormed with error code "INVALID_OBS" instead; with
+   * set_throw_obs_errors(false), hosts should check via this method rather
+   * than the checker directly.
+   */
+  mc::CheckResult Check(const mc::cats::Checker &checker) const {
+    if (!obs_error_.empty()) {
+      mc::CheckResult result;
+      result.verdict = mc::CheckResult::kIllFormed;
+      result.failed = "INVALID_OBS";
+      return result;
+    }
+
+    return checker.check();
+  }
+
+  /**
+   * Inserts (w, r) into rf, and notifies the streaming checker (if set).
+   */
+  void InsertRf(const mc::Event &w, const mc::Event &r,
+                bool assert_unique = false) {
+    ew_->rf.Insert(w, r, assert_unique);
+    if (streaming_ != nullptr) {
+      streaming_->InsertRf(w, r);
+    }
+  }
+
+  void EraseRf(const mc::Event &w, const mc::Event &r) {
+    ew_->rf.Erase(w, r);
+    if (streaming_ != nullptr) {
+      streaming_->EraseRf(w, r);
+    }
+  }
+
+  /**
+   * Inserts (w1, w2) into co, and notifies the streaming checker (if set).
+   */
+  void InsertCo(const mc::Event &w1, const mc::Event &w2,
+                bool assert_unique = false) {
+    ew_->co.Insert(w1, w2, assert_unique);
+    if (streaming_ != nullptr) {
+      streaming_->InsertCo(w1, w2);
+    }
+  }
+
+  void EraseCo(const mc::Event &w1, const mc::Event &w2) {
+    ew_->co.Erase(w1, w2);
+    if (streaming_ != nullptr) {
+      streaming_->EraseCo(w1, w2);
+    }
+  }
+
+  /**
+   * Sets the checker to be notified of each observation (may be nullptr), s.t.
+   * the host can stop an iteration as soon as an axiom is violated:
+   * Operation::UpdateObs is unaffected, and the host polls
+   * StreamingChecker::valid(). The checker must check ew() and arch(), and
+   * is reset by Reset().
+   */
+  void set_streaming(mc::cats::StreamingChecker *val) { streaming_ = val; }
+
+  mc::cats::StreamingChecker *streaming() const { return streaming_; }
+
   mc::cats::ExecWitness *ew() { return ew_; }
 
   const mc::cats::ExecWitness *ew() const { return ew_; }
@@ -259,8 +369,21 @@ class EvtStateCats {
   typedef std::unordered_map<types::WriteID, const mc::Event *>
       WriteID_EventPtr;
 
+  /**
+   * Inserts event into the execution witness, assigning it an index in
+   * ExecWitness::table.
+   *
+   * @return Pointer to event, valid until ExecWitness::Clear().
+   */
+  const mc::Event *InsertEvent(const mc::Event &event,
+                               bool assert_unique = false) {
+    ew_->events.Insert(event, assert_unique);
+    return &ew_->table.Get(ew_->table.Insert(event));
+  }
+
   mc::cats::ExecWitness *ew_;
   mc::cats::Architecture *arch_;
+  mc::cats::StreamingChecker *streaming_;
 
   WriteID_EventPtr writes_;
 
@@ -268,6 +391,9 @@ class EvtStateCats {
   types::Poi last_other_id;
 
   types::Addr addr_mask_;
+
+  bool throw_obs_errors_;
+  std::string obs_error_;
 };
 
 }  // namespace codegen
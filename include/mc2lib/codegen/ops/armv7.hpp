@@ -353,11 +353,11 @@ class Read : public MemOperation {
       // If from_ == from, we still need to continue to try to erase and
       // insert, in case the from-relation has been cleared.
 
-      evts->ew()->rf.Erase(*from_, *event_);
+      evts->EraseRf(*from_, *event_);
     }
 
     from_ = from;
-    evts->ew()->rf.Insert(*from_, *event_, true);
+    evts->InsertRf(*from_, *event_, true);
 
     return true;
   }
@@ -478,11 +478,11 @@ class Write : public MemOperation {
       // If from_ == from, we still need to continue to try to erase and
       // insert, in case the from-relation has been cleared.
 
-      evts->ew()->co.Erase(*from_, *event_);
+      evts->EraseCo(*from_, *event_);
     }
 
     from_ = from;
-    evts->ew()->co.Insert(*from_, *event_, true);
+    evts->InsertCo(*from_, *event_, true);
 
     return true;
   }
@@ -222,11 +222,11 @@ class Read : public MemOperation {
       // If from_ == from, we still need to continue to try to erase and
       // insert, in case the from-relation has been cleared.
 
-      EraseObsHelper(from_, event_, evts->ew());
+      EraseObsHelper(from_, event_, evts);
     }
 
     from_ = from;
-    InsertObsHelper(from_, event_, evts->ew());
+    InsertObsHelper(from_, event_, evts);
 
     return true;
   }
@@ -245,13 +245,13 @@ class Read : public MemOperation {
 
  protected:
   virtual void InsertObsHelper(const mc::Event *e1, const mc::Event *e2,
-                               mc::cats::ExecWitness *ew) {
-    ew->rf.Insert(*e1, *e2, true);
+                               EvtStateCats *evts) {
+    evts->InsertRf(*e1, *e2, true);
   }
 
   virtual void EraseObsHelper(const mc::Event *e1, const mc::Event *e2,
-                              mc::cats::ExecWitness *ew) {
-    ew->rf.Erase(*e1, *e2);
+                              EvtStateCats *evts) {
+    evts->EraseRf(*e1, *e2);
   }
 
   types::Addr addr_;
@@ -314,13 +314,13 @@ class Write : public Read {
 
  protected:
   void InsertObsHelper(const mc::Event *e1, const mc::Event *e2,
-                       mc::cats::ExecWitness *ew) override {
-    ew->co.Insert(*e1, *e2);
+                       EvtStateCats *evts) override {
+    evts->InsertCo(*e1, *e2);
   }
 
   void EraseObsHelper(const mc::Event *e1, const mc::Event *e2,
-                      mc::cats::ExecWitness *ew) override {
-    ew->co.Erase(*e1, *e2);
+                      EvtStateCats *evts) override {
+    evts->EraseCo(*e1, *e2);
   }
 
   types::WriteID write_id_;
@@ -384,7 +384,7 @@ class ReadModifyWrite : public MemOperation {
         evts->GetWrite(MakeEventPtrs(event_w_), addr_, from_id)[0];
 
     auto part_event = event_r_;
-    auto obs_rel = &evts->ew()->rf;
+    bool part_write = false;
 
     // TODO(melver): clean this up! Do we need ability to update squashed?
 
@@ -393,8 +393,8 @@ class ReadModifyWrite : public MemOperation {
 
       if (from_ != nullptr) {
         // Restart
-        evts->ew()->rf.Erase(*from_, *event_r_);
-        evts->ew()->co.Erase(*from_, *event_w_);
+        evts->EraseRf(*from_, *event_r_);
+        evts->EraseCo(*from_, *event_w_);
       }
     } else {
       // Second part: write
@@ -406,14 +406,19 @@ class ReadModifyWrite : public MemOperation {
         oss << "RMW NOT ATOMIC: expected <" << static_cast<std::string>(*from_)
             << ">, but overwriting <" << static_cast<std::string>(*from)
             << ">!";
-        throw mc::Error(oss.str());
+        evts->ObsError<mc::Error>(oss.str());
+        return false;
       }
 
       part_event = event_w_;
-      obs_rel = &evts->ew()->co;
+      part_write = true;
     }
 
-    obs_rel->Insert(*from, *part_event, true);
+    if (part_write) {
+      evts->InsertCo(*from, *part_event, true);
+    } else {
+      evts->InsertRf(*from, *part_event, true);
+    }
 
     from_ = from;
     last_part_ = part;
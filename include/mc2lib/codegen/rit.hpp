@@ -45,12 +45,19 @@
 namespace mc2lib {
 namespace codegen {
 
-template <class URNG, class OperationFactory>
+/**
+ * @brief Random instruction test.
+ *
+ * AddrTypes selects the containers used by AddrSet, e.g.
+ * sets::FlatTypes<types::Addr, std::hash<types::Addr>>.
+ */
+template <class URNG, class OperationFactory,
+          class AddrTypes = sets::Types<types::Addr, std::hash<types::Addr>>>
 class RandInstTest
     : public simplega::Genome<typename OperationFactory::ResultType::Ptr> {
  public:
   typedef typename OperationFactory::ResultType Operation;
-  typedef sets::Set<sets::Types<types::Addr, std::hash<types::Addr>>> AddrSet;
+  typedef sets::Set<AddrTypes> AddrSet;
 
   explicit RandInstTest(URNG& urng, const OperationFactory* factory,
                         std::size_t len)
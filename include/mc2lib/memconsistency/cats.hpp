@@ -34,8 +34,21 @@
 #ifndef MC2LIB_MEMCONSISTENCY_CATS_HPP_
 #define MC2LIB_MEMCONSISTENCY_CATS_HPP_
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
 #include <memory>
-
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../parallel.hpp"
 #include "eventsets.hpp"
 
 namespace mc2lib {
@@ -61,6 +74,11 @@ class ExecWitness {
  public:
   template <class FilterFunc>
   EventRel fr(FilterFunc filter_func) const {
+    const CoherenceOrder coherence_order(co);
+    if (coherence_order.valid()) {
+      return coherence_order.Fr(rf, filter_func);
+    }
+
     EventRel er;
 
     // Use of get() is justified, as we do not expect (according to wf_rf), the
@@ -80,77 +98,278 @@ class ExecWitness {
     return er;
   }
 
-  EventRel fr() const {
-    return fr([](const EventRel::Tuple& t1, const EventRel::Tuple& t2) {
-      return true;
+  /**
+   * Derived relations below are memoized against generation(): repeated
+   * calls are free until events, po, co or rf are modified. Returned
+   * references remain valid until the first call (to any of them) after a
+   * modification, or Clear(). Not thread-safe.
+   */
+  const EventRel& fr() const {
+    return Memo(kFr, [this](EventRel* out) {
+      *out = fr([](const EventRel::Tuple& t1, const EventRel::Tuple& t2) {
+        return true;
+      });
     });
   }
 
-  EventRel fri() const {
-    return fr([](const EventRel::Tuple& t1, const EventRel::Tuple& t2) {
-      return t1.second.iiid.pid == t2.second.iiid.pid;
-    });
+  const EventRel& fri() const {
+    MemoFrPartition();
+    return *memo_[kFri];
+  }
+
+  const EventRel& fre() const {
+    MemoFrPartition();
+    return *memo_[kFre];
   }
 
-  EventRel fre() const {
-    return fr([](const EventRel::Tuple& t1, const EventRel::Tuple& t2) {
-      return t1.second.iiid.pid != t2.second.iiid.pid;
+  /**
+   * Obtains both fri and fre in a single pass.
+   */
+  void FrPartition(EventRel* fri, EventRel* fre) const {
+    const CoherenceOrder coherence_order(co);
+    if (coherence_order.valid()) {
+      *fri = EventRel();
+      *fre = EventRel();
+      coherence_order.Fr(rf, fri, fre);
+    } else {
+      *fri = fr([](const EventRel::Tuple& t1, const EventRel::Tuple& t2) {
+        return t1.second.iiid.pid == t2.second.iiid.pid;
+      });
+      *fre = fr([](const EventRel::Tuple& t1, const EventRel::Tuple& t2) {
+        return t1.second.iiid.pid != t2.second.iiid.pid;
+      });
+    }
+  }
+
+  const EventRel& rfi() const {
+    return Memo(kRfi, [this](EventRel* out) {
+      *out = rf.Filter([](const Event& e1, const Event& e2) {
+        return e1.iiid.pid == e2.iiid.pid;
+      });
     });
   }
 
-  EventRel rfi() const {
-    return rf.Filter([](const Event& e1, const Event& e2) {
-      return e1.iiid.pid == e2.iiid.pid;
+  const EventRel& rfe() const {
+    return Memo(kRfe, [this](EventRel* out) {
+      *out = rf.Filter([](const Event& e1, const Event& e2) {
+        return e1.iiid.pid != e2.iiid.pid;
+      });
     });
   }
 
-  EventRel rfe() const {
-    return rf.Filter([](const Event& e1, const Event& e2) {
-      return e1.iiid.pid != e2.iiid.pid;
+  const EventRel& coi() const {
+    return Memo(kCoi, [this](EventRel* out) {
+      *out = co.Filter([](const Event& e1, const Event& e2) {
+        return e1.iiid.pid == e2.iiid.pid;
+      });
     });
   }
 
-  EventRel coi() const {
-    return co.Filter([](const Event& e1, const Event& e2) {
-      return e1.iiid.pid == e2.iiid.pid;
+  const EventRel& coe() const {
+    return Memo(kCoe, [this](EventRel* out) {
+      *out = co.Filter([](const Event& e1, const Event& e2) {
+        return e1.iiid.pid != e2.iiid.pid;
+      });
     });
   }
 
-  EventRel coe() const {
-    return co.Filter([](const Event& e1, const Event& e2) {
-      return e1.iiid.pid != e2.iiid.pid;
+  const EventRel& com() const {
+    return Memo(kCom, [this](EventRel* out) { *out = rf | co | fr(); });
+  }
+
+  /**
+   * @return po as ProgramOrder; not valid() if po is not a transitive
+   *         closure of chains (as set up by event producers), in which case
+   *         callers must fall back to using po.
+   */
+  ProgramOrder program_order() const {
+    if (!po.all_props(EventRel::kTransitiveClosure)) {
+      return ProgramOrder::Invalid();
+    }
+
+    return ProgramOrder(po);
+  }
+
+  const EventRel& po_loc() const {
+    return Memo(kPoLoc, [this](EventRel* out) {
+      const ProgramOrder program_order = this->program_order();
+      if (program_order.valid()) {
+        // Same relation, without materialising the closure of po.
+        *out = program_order.Partition([](const Event& e) { return e.addr; })
+                   .Chains();
+        return;
+      }
+
+      *out = po.Filter(
+          [](const Event& e1, const Event& e2) { return e1.addr == e2.addr; });
     });
   }
 
-  EventRel com() const { return rf | co | fr(); }
+  /**
+   * Canonical fingerprint of events, po, rf and co (see FingerprintBuilder),
+   * memoized like the derived relations. Executions with equal fingerprints
+   * are (with high probability) equal, irrespective of how their events and
+   * relations have been constructed.
+   */
+  const Fingerprint& fingerprint() const {
+    generation();
+
+    if (!has_fingerprint_) {
+      fingerprint_ =
+          FingerprintBuilder().Add(events).Add(po).Add(rf).Add(co).Get();
+      has_fingerprint_ = true;
+    }
 
-  EventRel po_loc() const {
-    return po.Filter(
-        [](const Event& e1, const Event& e2) { return e1.addr == e2.addr; });
+    return fingerprint_;
   }
 
+  /**
+   * Generation of the execution: changes iff any of events, po, co or rf has
+   * been modified since the last call (also see sets::GenerationStamp).
+   */
+  std::uint64_t generation() const {
+    const std::uint64_t generation = generation_.Get(
+        {{events.generation(), po.generation(), co.generation(),
+          rf.generation()}});
+    if (generation != memo_generation_) {
+      memo_generation_ = generation;
+      ResetMemo();
+    }
+
+    return generation;
+  }
+
+  /**
+   * Freezes the execution: computes its generation (including the stamps of
+   * events and relations) and all memoized derived relations, s.t. const
+   * methods no longer modify any state, and may be called concurrently until
+   * the execution is next modified.
+   */
+  void Freeze() const {
+    fr();
+    fri();
+    rfi();
+    rfe();
+    coi();
+    coe();
+    com();
+    po_loc();
+    fingerprint();
+  }
+
+  /**
+   * Clears all events and relations, and releases arena; any relations
+   * derived from this execution must no longer be used.
+   */
   void Clear() {
-    events.Clear();
-    po.Clear();
-    co.Clear();
-    rf.Clear();
+    // Reset rather than clear containers, as they may hold memory allocated
+    // from arena (e.g. bucket arrays).
+    events = EventSet();
+    po = EventRel();
+    co = EventRel();
+    rf = EventRel();
+    table.Clear();
+    ResetMemo();
+    arena.Release();
+  }
+
+ private:
+  enum MemoIndex {
+    kFr,
+    kFri,
+    kFre,
+    kRfi,
+    kRfe,
+    kCoi,
+    kCoe,
+    kCom,
+    kPoLoc,
+    kNumMemo
+  };
+
+  void ResetMemo() const {
+    for (auto& memo : memo_) {
+      memo.reset();
+    }
+
+    has_fingerprint_ = false;
+  }
+
+  template <class ComputeFunc>
+  const EventRel& Memo(MemoIndex idx, ComputeFunc compute) const {
+    generation();
+
+    if (memo_[idx] == nullptr) {
+      std::unique_ptr<EventRel> result(new EventRel());
+      compute(result.get());
+      memo_[idx] = std::move(result);
+    }
+
+    return *memo_[idx];
+  }
+
+  void MemoFrPartition() const {
+    generation();
+
+    if (memo_[kFri] == nullptr || memo_[kFre] == nullptr) {
+      std::unique_ptr<EventRel> fri(new EventRel());
+      std::unique_ptr<EventRel> fre(new EventRel());
+      FrPartition(fri.get(), fre.get());
+      memo_[kFri] = std::move(fri);
+      memo_[kFre] = std::move(fre);
+    }
   }
 
  public:
+  /**
+   * Arena for intermediate relations of checks (see Checker::valid_exec);
+   * released by Clear(). Declared first, as other members may hold memory
+   * allocated from it.
+   */
+  mutable sets::Arena arena;
+
   EventSet events;
   EventRel po;
   EventRel co;
   EventRel rf;
+
+  /**
+   * Dense indices of events; filled by the event producer (e.g.
+   * codegen::EvtStateCats), or by dense containers if current while the
+   * execution is built (see EventTableScope), and not necessarily complete
+   * otherwise.
+   */
+  EventTable table;
+
+ private:
+  sets::CompositeGeneration<4> generation_;
+  mutable std::uint64_t memo_generation_ = 0;
+  mutable std::shared_ptr<const EventRel> memo_[kNumMemo];
+  mutable Fingerprint fingerprint_;
+  mutable bool has_fingerprint_ = false;
 };
 
 class Checker;
 
+typedef std::shared_ptr<const EventRel> EventRelPtr;
+
 class Architecture {
  public:
-  Architecture() : proxy_(this) {}
+  Architecture() : proxy_(this) { generation_.Get(); }
+
+  /**
+   * Copies are not proxied, irrespective of the original.
+   */
+  Architecture(const Architecture& rhs)
+      : proxy_(this), generation_(rhs.generation_) {}
 
   virtual ~Architecture() { assert(proxy_ == this); }
 
+  Architecture& operator=(const Architecture& rhs) {
+    generation_ = rhs.generation_;
+    return *this;
+  }
+
   virtual void Clear() {}
 
   /**
@@ -164,7 +383,68 @@ class Architecture {
   virtual EventRel prop(const ExecWitness& ew) const = 0;
 
   virtual EventRel hb(const ExecWitness& ew) const {
-    return ew.rfe() | proxy_->ppo(ew) | proxy_->fences(ew);
+    return ew.rfe() | *proxy_->shared_ppo(ew) | *proxy_->shared_fences(ew);
+  }
+
+  /**
+   * @return true if hb is the default above, and ppo and fences are subsets
+   *         of po; lets StreamingChecker maintain hb from observations of rf,
+   *         rather than obtain it via shared_hb after each. Conservatively
+   *         false: architectures returning true should only do so for their
+   *         own type, not for subclasses (which may override hb).
+   */
+  virtual bool default_hb() const { return false; }
+
+  /**
+   * Shared and immutable variants of the above, which should be preferred to
+   * obtain relations via proxy_: computed afresh on every call, unless
+   * memoized (see ArchProxy).
+   */
+  virtual EventRelPtr shared_ppo(const ExecWitness& ew) const {
+    return std::make_shared<const EventRel>(ppo(ew));
+  }
+
+  virtual EventRelPtr shared_fences(const ExecWitness& ew) const {
+    return std::make_shared<const EventRel>(fences(ew));
+  }
+
+  virtual EventRelPtr shared_prop(const ExecWitness& ew) const {
+    return std::make_shared<const EventRel>(prop(ew));
+  }
+
+  virtual EventRelPtr shared_hb(const ExecWitness& ew) const {
+    return std::make_shared<const EventRel>(hb(ew));
+  }
+
+  /**
+   * Generation of any state other than the ExecWitness, which ppo, fences,
+   * prop or hb depend on (e.g. fence relations); used to key memoized
+   * relations. Architectures should override this, s.t. it changes whenever
+   * the state is modified (or is constant, if there is no state).
+   *
+   * The default is a stamp of this object, shared by copies: architectures
+   * relying on it must call InvalidateGeneration() whenever their state is
+   * modified (e.g. from their setters and Clear()).
+   */
+  virtual std::uint64_t generation() const { return generation_.Get(); }
+
+  /**
+   * Computes relations ahead of use, if memoized (see ArchProxy); otherwise
+   * does nothing.
+   */
+  virtual void Memoize(const ExecWitness& ew) const {}
+
+  /**
+   * Adds the contents of the state covered by generation() to fb; used to key
+   * cached verdicts (see VerdictCache), s.t. distinct architectures with
+   * equal state share verdicts. Architectures (including subclasses which
+   * add state) should override this along with generation().
+   *
+   * The default adds generation(), i.e. verdicts on architectures which do
+   * not override either are only shared by an architecture and its copies.
+   */
+  virtual void AddFingerprint(FingerprintBuilder* fb) const {
+    fb->Add(generation());
   }
 
   /**
@@ -183,18 +463,38 @@ class Architecture {
   }
 
  protected:
+  /**
+   * Draws a new default generation(); drawn eagerly, s.t. generation() may
+   * be called concurrently.
+   */
+  void InvalidateGeneration() {
+    generation_.Invalidate();
+    generation_.Get();
+  }
+
   const Architecture* proxy_;
+
+ private:
+  sets::GenerationStamp generation_;
 };
 
+/**
+ * @brief Memoizes the relations of ConcreteArch.
+ *
+ * Relations are computed lazily, once per generation of the ExecWitness and
+ * of the architecture (see Architecture::generation), and shared: as
+ * relations of ConcreteArch obtain each other via the proxy, dependencies
+ * (e.g. of hb and prop on ppo and fences) are also only computed once.
+ * Relations may be obtained concurrently, provided the ExecWitness is frozen
+ * (see ExecWitness::Freeze), and neither it nor the architecture is modified
+ * meanwhile; relations are computed without holding the lock, i.e.
+ * concurrent misses on the same relation may compute it redundantly (see
+ * Memoize to avoid this).
+ */
 template <class ConcreteArch>
 class ArchProxy : public Architecture {
  public:
-  explicit ArchProxy(ConcreteArch* arch)
-      : arch_(arch),
-        memoized_ppo_(false),
-        memoized_fences_(false),
-        memoized_prop_(false),
-        memoized_hb_(false) {
+  explicit ArchProxy(ConcreteArch* arch) : arch_(arch), key_() {
     arch_->set_proxy(this);
   }
 
@@ -202,10 +502,7 @@ class ArchProxy : public Architecture {
 
   void Clear() override {
     arch_->Clear();
-    memoized_ppo_ = false;
-    memoized_fences_ = false;
-    memoized_prop_ = false;
-    memoized_hb_ = false;
+    ResetMemo();
   }
 
   std::unique_ptr<Checker> MakeChecker(const Architecture* arch,
@@ -217,35 +514,51 @@ class ArchProxy : public Architecture {
     return MakeChecker(this, exec);
   }
 
-  void Memoize(const ExecWitness& ew) {
-    // fences and ppo are likely used by hb and prop
-    fences_ = arch_->fences(ew);
-    memoized_fences_ = true;
-
-    ppo_ = arch_->ppo(ew);
-    memoized_ppo_ = true;
-
-    hb_ = arch_->hb(ew);
-    memoized_hb_ = true;
-
-    prop_ = arch_->prop(ew);
-    memoized_prop_ = true;
+  /**
+   * Computes all relations ahead of use; optional, as relations are memoized
+   * on first use.
+   */
+  void Memoize(const ExecWitness& ew) const override {
+    shared_hb(ew);
+    shared_prop(ew);
   }
 
   EventRel ppo(const ExecWitness& ew) const override {
-    return memoized_ppo_ ? ppo_ : arch_->ppo(ew);
+    return *shared_ppo(ew);
   }
 
   EventRel fences(const ExecWitness& ew) const override {
-    return memoized_fences_ ? fences_ : arch_->fences(ew);
+    return *shared_fences(ew);
   }
 
   EventRel prop(const ExecWitness& ew) const override {
-    return memoized_prop_ ? prop_ : arch_->prop(ew);
+    return *shared_prop(ew);
+  }
+
+  EventRel hb(const ExecWitness& ew) const override { return *shared_hb(ew); }
+
+  bool default_hb() const override { return arch_->default_hb(); }
+
+  EventRelPtr shared_ppo(const ExecWitness& ew) const override {
+    return Memo(kPpo, ew, [this, &ew]() { return arch_->ppo(ew); });
+  }
+
+  EventRelPtr shared_fences(const ExecWitness& ew) const override {
+    return Memo(kFences, ew, [this, &ew]() { return arch_->fences(ew); });
   }
 
-  EventRel hb(const ExecWitness& ew) const override {
-    return memoized_hb_ ? hb_ : arch_->hb(ew);
+  EventRelPtr shared_prop(const ExecWitness& ew) const override {
+    return Memo(kProp, ew, [this, &ew]() { return arch_->prop(ew); });
+  }
+
+  EventRelPtr shared_hb(const ExecWitness& ew) const override {
+    return Memo(kHb, ew, [this, &ew]() { return arch_->hb(ew); });
+  }
+
+  std::uint64_t generation() const override { return arch_->generation(); }
+
+  void AddFingerprint(FingerprintBuilder* fb) const override {
+    arch_->AddFingerprint(fb);
   }
 
   Event::Type EventTypeRead() const override { return arch_->EventTypeRead(); }
@@ -255,49 +568,139 @@ class ArchProxy : public Architecture {
   }
 
  protected:
-  ConcreteArch* arch_;
+  enum MemoIndex { kPpo, kFences, kProp, kHb, kNumMemo };
 
-  bool memoized_ppo_;
-  bool memoized_fences_;
-  bool memoized_prop_;
-  bool memoized_hb_;
+  typedef std::array<std::uint64_t, 2> Key;
 
-  EventRel ppo_;
-  EventRel fences_;
-  EventRel prop_;
-  EventRel hb_;
+  void ResetMemo() const {
+    key_ = Key();
+    for (auto& memo : memo_) {
+      memo.reset();
+    }
+  }
+
+  /**
+   * Obtains ew.generation(), which updates memo state of ew unless it is
+   * frozen: unless all uses of ew (via this or any other proxy) are in the
+   * same thread, ew must have been frozen (see ExecWitness::Freeze).
+   */
+  template <class ComputeFunc>
+  EventRelPtr Memo(MemoIndex idx, const ExecWitness& ew,
+                   ComputeFunc compute) const {
+    Key key;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      key = {{ew.generation(), arch_->generation()}};
+      if (key != key_) {
+        ResetMemo();
+        key_ = key;
+      }
+
+      if (memo_[idx] != nullptr) {
+        return memo_[idx];
+      }
+    }
+
+    // Not holding the lock: computing a relation may obtain its
+    // dependencies, and relations may be computed concurrently.
+    EventRelPtr result = Share(compute());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (key != key_) {
+      return result;  // superseded
+    }
+
+    if (memo_[idx] == nullptr) {
+      memo_[idx] = std::move(result);
+    }
+
+    return memo_[idx];
+  }
+
+  static EventRelPtr Share(EventRel rel) {
+    if (sets::Arena::Current() != nullptr) {
+      // The memo may outlive the arena of the ExecWitness (released by
+      // ExecWitness::Clear): copy to the heap.
+      const sets::ArenaScope heap_scope(nullptr);
+      std::shared_ptr<EventRel> result =
+          std::make_shared<EventRel>(EventRel::Container(rel.get()));
+      result->set_props(rel.props());
+      return std::move(result);
+    }
+
+    return std::make_shared<const EventRel>(std::move(rel));
+  }
+
+  ConcreteArch* arch_;
+
+  mutable std::mutex mutex_;
+  mutable Key key_;
+  mutable EventRelPtr memo_[kNumMemo];
 };
 
 class Checker {
  public:
   Checker(const Architecture* arch, const ExecWitness* exec)
-      : arch_(arch), exec_(exec) {}
+      : arch_(arch), exec_(exec), pool_(nullptr) {}
 
   virtual ~Checker() {}
 
-  virtual void wf_rf() const {
+  /**
+   * Sets the pool on which independent parts of individual axioms are
+   * evaluated; nullptr (default) evaluates them in the calling thread. The
+   * pool must outlive any checks.
+   */
+  void set_pool(parallel::ThreadPool* pool) { pool_ = pool; }
+
+  parallel::ThreadPool* pool() const { return pool_; }
+
+  /**
+   * @return Error code of the first violated well-formedness condition of
+   *         rf, as thrown by wf_rf(); nullptr if well-formed.
+   */
+  virtual const char* wf_rf_error() const {
     EventSet reads;
 
     for (const auto& tuples : exec_->rf.get()) {
       if (!tuples.first.AnyType(arch_->EventTypeWrite())) {
-        throw Error("WF_RF_NOT_FROM_WRITE");
+        return "WF_RF_NOT_FROM_WRITE";
       }
 
       for (const auto& e : tuples.second.get()) {
         if (!e.AnyType(arch_->EventTypeRead()) || tuples.first.addr != e.addr) {
-          throw Error("WF_RF_NOT_SAME_LOC");
+          return "WF_RF_NOT_SAME_LOC";
         }
 
         // For every read, there exists only 1 source!
         if (reads.Contains(e)) {
-          throw Error("WF_RF_MULTI_SOURCE");
+          return "WF_RF_MULTI_SOURCE";
         }
         reads.Insert(e);
       }
     }
+
+    return nullptr;
   }
 
-  virtual void wf_co() const {
+  virtual void wf_rf() const { ThrowIfError(wf_rf_error()); }
+
+  /**
+   * @return Error code of the first violated well-formedness condition of
+   *         co, as thrown by wf_co(); nullptr if well-formed.
+   */
+  virtual const char* wf_co_error() const {
+    auto writes = exec_->events.Filter(
+        [&](const Event& e) { return e.AnyType(arch_->EventTypeWrite()); });
+
+    // Fast path: a per-address topological sort, in linear time; otherwise,
+    // the checks below determine the error.
+    if (CoherenceOrder(exec_->co).StrictTotalOrderPerAddr(writes)) {
+      return nullptr;
+    }
+
     std::unordered_set<types::Addr> addrs;
 
     // Assert writes ordered captured in ws are to the same location.
@@ -306,87 +709,736 @@ class Checker {
 
       for (const auto& e : tuples.second.get()) {
         if (tuples.first.addr != e.addr) {
-          throw Error("WF_CO_NOT_SAME_LOC");
+          return "WF_CO_NOT_SAME_LOC";
         }
       }
     }
 
-    auto writes = exec_->events.Filter(
-        [&](const Event& e) { return e.AnyType(arch_->EventTypeWrite()); });
     if (!exec_->co.StrictPartialOrder(writes)) {
-      throw Error("WF_CO_NOT_STRICT_PARTIAL_ORDER");
+      return "WF_CO_NOT_STRICT_PARTIAL_ORDER";
     }
 
     for (const auto& addr : addrs) {
       auto same_addr_writes =
           writes.Filter([&](const Event& e) { return e.addr == addr; });
       if (!exec_->co.ConnexOn(same_addr_writes)) {
-        throw Error("WF_CO_NOT_CONNEX");
+        return "WF_CO_NOT_CONNEX";
       }
     }
+
+    return nullptr;
   }
 
-  virtual void wf() const {
-    wf_rf();
-    wf_co();
+  virtual void wf_co() const { ThrowIfError(wf_co_error()); }
+
+  virtual const char* wf_error() const {
+    const char* error = wf_rf_error();
+    return error != nullptr ? error : wf_co_error();
   }
 
+  virtual void wf() const { ThrowIfError(wf_error()); }
+
+  /**
+   * All tuples of com and po_loc relate events of the same address; each
+   * address is therefore checked independently (see PerLocationAcyclic), on
+   * pool() if set.
+   */
   virtual bool sc_per_location(EventRel::Path* cyclic = nullptr) const {
-    return (exec_->com() | exec_->po_loc()).Acyclic(cyclic);
+    // Cycles do not depend on the closure of po_loc: avoid evaluating it.
+    EventRel po_loc = exec_->po_loc();
+    po_loc.unset_props(EventRel::kTransitiveClosure);
+    return PerLocationAcyclic(exec_->com() | po_loc, pool_, cyclic);
   }
 
   virtual bool no_thin_air(EventRel::Path* cyclic = nullptr) const {
-    return arch_->hb(*exec_).Acyclic(cyclic);
+    return arch_->shared_hb(*exec_)->Acyclic(cyclic);
   }
 
   virtual bool observation(EventRel::Path* cyclic = nullptr) const {
-    const EventRel prop = arch_->prop(*exec_);
-    const EventRel hbstar =
-        arch_->hb(*exec_).set_props(EventRel::kReflexiveTransitiveClosure);
-
-    // Not eval'ing hbstar causes performance to degrade substantially, as
-    // EventRelSeq recomputes reachability from nodes from prop to hbstar
-    // several times!
-    bool r = EventRelSeq({exec_->fre(), prop, hbstar.Eval()}).Irreflexive();
+    EventRel hbstar = *arch_->shared_hb(*exec_);
+    hbstar.set_props(EventRel::kReflexiveTransitiveClosure);
 
-    if (!r && cyclic != nullptr) {
-      // However, here we want hbstar unevald, as otherwise the graph is
-      // too collapsed.
-      EventRelSeq({exec_->fre(), prop, hbstar}).Irreflexive(cyclic);
-    }
-
-    return r;
+    // EventRelSeq evaluates hbstar only once, but constructs cycles from the
+    // unevaluated relations, so that they are not too collapsed.
+    return EventRelSeq({exec_->fre(), *arch_->shared_prop(*exec_), hbstar})
+        .Irreflexive(cyclic);
   }
 
   virtual bool propagation(EventRel::Path* cyclic = nullptr) const {
-    return (exec_->co | arch_->prop(*exec_)).Acyclic(cyclic);
+    return (exec_->co | *arch_->shared_prop(*exec_)).Acyclic(cyclic);
   }
 
-  virtual void valid_exec(EventRel::Path* cyclic = nullptr) const {
-    wf();
+  /**
+   * Sufficient condition for a well-formed execution to be valid: if
+   * po | rf | co | fr is acyclic, the execution is sequentially consistent,
+   * and therefore valid on any architecture (whose relations are included in
+   * the former's transitive closure). Linear time, and does not compute any
+   * architecture relations.
+   */
+  virtual bool sc_acyclic() const {
+    return ScAcyclic(exec_->po, exec_->rf, CoherenceOrder(exec_->co));
+  }
+
+  /**
+   * Checks the axioms of a well-formed execution, in order.
+   *
+   * @param cyclic Optional; if an axiom fails, its cycle.
+   * @return Error code of the first failed axiom, as thrown by valid_exec;
+   *         nullptr if the execution is valid.
+   */
+  virtual const char* failed_axiom(EventRel::Path* cyclic = nullptr) const {
+    // Fast path: most executions are sequentially consistent.
+    if (sc_acyclic()) {
+      return nullptr;
+    }
 
     if (!sc_per_location(cyclic)) {
-      throw Error("SC_PER_LOCATION");
+      return "SC_PER_LOCATION";
     }
 
     if (!no_thin_air(cyclic)) {
-      throw Error("NO_THIN_AIR");
+      return "NO_THIN_AIR";
     }
 
     if (!observation(cyclic)) {
-      throw Error("OBSERVATION");
+      return "OBSERVATION";
     }
 
     if (!propagation(cyclic)) {
-      throw Error("PROPAGATION");
+      return "PROPAGATION";
+    }
+
+    return nullptr;
+  }
+
+  virtual void valid_exec(EventRel::Path* cyclic = nullptr) const {
+    // Intermediate relations are allocated from the execution's arena, if
+    // EventRel's allocator supports it (see MC2LIB_ARENA_EVENTSETS).
+    const sets::ArenaScope arena_scope(&exec_->arena);
+
+    wf();
+    ThrowIfError(failed_axiom(cyclic));
+  }
+
+  /**
+   * As valid_exec, but returns the result instead of throwing; see
+   * CheckResult. Evaluates wf_error() and failed_axiom(), which subclasses
+   * overriding the throwing variants must override accordingly.
+   */
+  CheckResult check() const {
+    const sets::ArenaScope arena_scope(&exec_->arena);
+    CheckResult result;
+
+    result.failed = wf_error();
+    if (result.failed != nullptr) {
+      result.verdict = CheckResult::kIllFormed;
+      return result;
+    }
+
+    EventRel::Path cyclic;  // does not allocate unless an axiom fails
+    result.failed = failed_axiom(&cyclic);
+    if (result.failed != nullptr) {
+      result.verdict = CheckResult::kInvalid;
+      result.SetCycle(exec_->table, std::move(cyclic));
+    }
+
+    return result;
+  }
+
+  /**
+   * As valid_exec, but evaluates the axioms following wf concurrently on
+   * pool, against the frozen execution (see ExecWitness::Freeze); neither
+   * the execution nor the architecture may be modified until this returns.
+   *
+   * Axioms not yet started are skipped once a preceding one has failed,
+   * while those already in progress run to completion; the error and cycle
+   * reported are those of the first failing axiom in order, i.e. the same as
+   * reported by valid_exec.
+   *
+   * The calling thread evaluates axioms as well, and only waits for those in
+   * progress on other threads (see parallel::ForEach): this may be called
+   * from within a task of pool, e.g. of CheckBatch.
+   */
+  void valid_exec_parallel(parallel::ThreadPool* pool,
+                           EventRel::Path* cyclic = nullptr) const {
+    typedef bool (Checker::*Axiom)(EventRel::Path*) const;
+
+    static const struct {
+      Axiom axiom;
+      const char* error;
+    } kAxioms[] = {
+        {&Checker::sc_per_location, "SC_PER_LOCATION"},
+        {&Checker::no_thin_air, "NO_THIN_AIR"},
+        {&Checker::observation, "OBSERVATION"},
+        {&Checker::propagation, "PROPAGATION"},
+    };
+
+    const std::size_t num_axioms = sizeof(kAxioms) / sizeof(kAxioms[0]);
+
+    {
+      const sets::ArenaScope arena_scope(&exec_->arena);
+
+      wf();
+
+      if (sc_acyclic()) {
+        return;
+      }
+
+      exec_->Freeze();
+
+      // Shared by the axioms: compute once, rather than in every worker.
+      arch_->Memoize(*exec_);
+    }
+
+    // Workers do not use the arena, which is not thread-safe.
+    std::atomic<std::size_t> first_failed(num_axioms);
+    std::vector<EventRel::Path> cycles(num_axioms);
+    const auto table = EventTable::Current();
+
+    parallel::ForEach(pool, num_axioms, [&](std::size_t i) {
+      if (first_failed.load() < i) {
+        return;  // cancelled
+      }
+
+      const EventTableScope table_scope(table);
+      if (!(this->*kAxioms[i].axiom)(cyclic != nullptr ? &cycles[i]
+                                                        : nullptr)) {
+        std::size_t expected = first_failed.load();
+        while (i < expected &&
+               !first_failed.compare_exchange_weak(expected, i)) {
+        }
+      }
+    });
+
+    const std::size_t failed = first_failed.load();
+    if (failed < num_axioms) {
+      if (cyclic != nullptr) {
+        cyclic->insert(cyclic->end(), cycles[failed].begin(),
+                       cycles[failed].end());
+      }
+
+      throw Error(kAxioms[failed].error);
     }
   }
 
  protected:
   const Architecture* arch_;
   const ExecWitness* exec_;
+  parallel::ThreadPool* pool_;
 };
 
+/**
+ * @brief Checks an execution incrementally, as its rf and co tuples are
+ * observed (e.g. via codegen::EvtStateCats), and fails as soon as either
+ * SC_PER_LOCATION or NO_THIN_AIR is violated.
+ *
+ * On the first observation after Reset(), the relations not derived from
+ * observations are taken from the execution: po-loc, and, if the
+ * architecture's hb is the default (see Architecture::default_hb), ppo |
+ * fences as far as already determined; i.e. events, po and the
+ * architecture's state must be complete by then. Subsequently, com | po-loc
+ * and hb are kept up to date with online orders (see
+ * sets::Relation::set_online_order), s.t. each observation costs time
+ * proportional to the tuples it adds, and a cycle is detected with the tuple
+ * closing it. fr is represented by tuples from each read to the immediate
+ * coherence-successors of the write it reads from, which is sufficient for
+ * acyclicity. Otherwise, hb is obtained via Architecture::shared_hb and
+ * checked in full after each observation.
+ *
+ * Violations reported are real violations. However, architectures may derive
+ * further ppo tuples from observations (e.g. Arch_ARMv7), and the remaining
+ * axioms are only evaluated by Finish(): the execution is only known to be
+ * valid after Finish().
+ *
+ * Erasing an observation (e.g. when an operation is restarted) erases the
+ * tuples derived from it only. As ppo may have depended on the erased
+ * tuple, a subsequent violation of NO_THIN_AIR is confirmed by rebuilding
+ * the state from the execution; as is the state after erasing an
+ * observation once an axiom has been violated.
+ */
+class StreamingChecker {
+ public:
+  StreamingChecker(const Architecture* arch, const ExecWitness* exec)
+      : arch_(arch),
+        exec_(exec),
+        begun_(false),
+        dirty_(false),
+        default_hb_(false),
+        stale_(false) {}
+
+  /**
+   * Forgets all state, e.g. for the next iteration of the same execution
+   * witness.
+   */
+  void Reset() {
+    begun_ = false;
+    dirty_ = false;
+    stale_ = false;
+    failed_.Clear();
+    cycle_.clear();
+    po_loc_ = EventRel();
+    com_po_loc_ = EventRel();
+    hb_ = EventRel();
+  }
+
+  /**
+   * Updates the state after (w, r) has been inserted into rf.
+   *
+   * @return false if an axiom has been violated so far.
+   */
+  bool InsertRf(const Event& w, const Event& r) {
+    if (Begin()) {
+      InsertCom(w, r);
+      const auto co_succ = exec_->co.get().find(w);
+      if (co_succ != exec_->co.get().end()) {
+        for (const auto& w2 : co_succ->second.get()) {
+          InsertCom(r, w2);
+        }
+      }
+
+      if (default_hb_ && w.iiid.pid != r.iiid.pid) {
+        hb_.Insert(w, r);
+      }
+
+      Check();
+    }
+
+    return valid();
+  }
+
+  /**
+   * Updates the state after (w1, w2) has been inserted into co.
+   *
+   * @return false if an axiom has been violated so far.
+   */
+  bool InsertCo(const Event& w1, const Event& w2) {
+    if (Begin()) {
+      InsertCom(w1, w2);
+      const auto rf_succ = exec_->rf.get().find(w1);
+      if (rf_succ != exec_->rf.get().end()) {
+        for (const auto& r : rf_succ->second.get()) {
+          InsertCom(r, w2);
+        }
+      }
+
+      Check();
+    }
+
+    return valid();
+  }
+
+  /**
+   * Updates the state after (w, r) has been erased from rf.
+   */
+  void EraseRf(const Event& w, const Event& r) {
+    if (Begin() && !Invalidated()) {
+      EraseCom(w, r);
+      const auto co_succ = exec_->co.get().find(w);
+      if (co_succ != exec_->co.get().end()) {
+        for (const auto& w2 : co_succ->second.get()) {
+          EraseCom(r, w2);
+        }
+      }
+
+      if (default_hb_ && w.iiid.pid != r.iiid.pid) {
+        // Not in ppo | fences, which are subsets of po.
+        hb_.Erase(w, r);
+      }
+
+      stale_ = true;
+    }
+  }
+
+  /**
+   * Updates the state after (w1, w2) has been erased from co.
+   */
+  void EraseCo(const Event& w1, const Event& w2) {
+    if (Begin() && !Invalidated()) {
+      EraseCom(w1, w2);
+      const auto rf_succ = exec_->rf.get().find(w1);
+      if (rf_succ != exec_->rf.get().end()) {
+        for (const auto& r : rf_succ->second.get()) {
+          EraseCom(r, w2);
+        }
+      }
+
+      stale_ = true;
+    }
+  }
+
+  /**
+   * Updates the state after arbitrary tuples have been erased from rf or co:
+   * the state is rebuilt from the execution on the next use.
+   */
+  void Erase() { dirty_ = true; }
+
+  /**
+   * @return false if an axiom has been violated by the observations so far.
+   */
+  bool valid() {
+    if (dirty_) {
+      Rebuild();
+    }
+
+    return failed_.valid();
+  }
+
+  /**
+   * @return Result so far; the cycle is given as in CheckResult.
+   */
+  const CheckResult& result() {
+    valid();
+    return failed_;
+  }
+
+  /**
+   * @return Cycle of the violated axiom; empty if valid().
+   */
+  const EventRel::Path& cycle() {
+    valid();
+    return cycle_;
+  }
+
+  /**
+   * Completes the check once all observations have been made: unless an
+   * axiom has already been violated, checks the execution in full (see
+   * Checker::check).
+   */
+  CheckResult Finish() {
+    if (!valid()) {
+      return failed_;
+    }
+
+    return arch_->MakeChecker(arch_, exec_)->check();
+  }
+
+ private:
+  /**
+   * Initializes the state on first use.
+   *
+   * @return false if already initialized, but to be rebuilt.
+   */
+  bool Begin() {
+    if (!begun_) {
+      Rebuild();
+      return false;
+    }
+
+    return !dirty_;
+  }
+
+  /**
+   * Erasing a tuple may break the cycle of a violation already reported:
+   * rebuild the state on the next use instead.
+   *
+   * @return true if the state is to be rebuilt.
+   */
+  bool Invalidated() {
+    if (!failed_.valid()) {
+      dirty_ = true;
+    }
+
+    return dirty_;
+  }
+
+  void Rebuild() {
+    begun_ = true;
+    stale_ = false;
+    failed_.Clear();
+    cycle_.clear();
+
+    po_loc_ = exec_->po_loc();
+    // Cycles do not depend on the closure of po_loc: avoid evaluating it.
+    com_po_loc_ = po_loc_;
+    com_po_loc_.unset_props(EventRel::kTransitiveClosure);
+    com_po_loc_.set_online_order(true);
+
+    default_hb_ = arch_->default_hb();
+    if (default_hb_) {
+      // rfe is added below, from the current rf: a copy of hb would retain
+      // erased tuples.
+      hb_ = *arch_->shared_ppo(*exec_);
+      hb_ |= *arch_->shared_fences(*exec_);
+      hb_.unset_props(EventRel::kReflexiveTransitiveClosure);
+      hb_.set_online_order(true);
+    } else {
+      hb_ = EventRel();
+    }
+
+    for (const auto& tuples : exec_->co.get()) {
+      for (const auto& w2 : tuples.second.get()) {
+        InsertCom(tuples.first, w2);
+      }
+    }
+
+    for (const auto& tuples : exec_->rf.get()) {
+      const auto co_succ = exec_->co.get().find(tuples.first);
+      for (const auto& r : tuples.second.get()) {
+        InsertCom(tuples.first, r);
+        if (co_succ != exec_->co.get().end()) {
+          for (const auto& w2 : co_succ->second.get()) {
+            InsertCom(r, w2);
+          }
+        }
+
+        if (default_hb_ && tuples.first.iiid.pid != r.iiid.pid) {
+          hb_.Insert(tuples.first, r);
+        }
+      }
+    }
+
+    dirty_ = false;
+    Check();
+  }
+
+  void InsertCom(const Event& e1, const Event& e2) {
+    if (!com_po_loc_.R(e1, e2)) {
+      com_po_loc_.Insert(e1, e2);
+    }
+  }
+
+  /**
+   * Erases (e1, e2), unless it is still in com | po-loc of the execution.
+   */
+  void EraseCom(const Event& e1, const Event& e2) {
+    if (exec_->rf.R(e1, e2) || exec_->co.R(e1, e2) || po_loc_.R(e1, e2)) {
+      return;
+    }
+
+    // fr: e1 reads from a write coherence-ordered before e2.
+    for (const auto& tuples : exec_->rf.get()) {
+      if (tuples.second.Contains(e1) && exec_->co.R(tuples.first, e2)) {
+        return;
+      }
+    }
+
+    com_po_loc_.Erase(e1, e2);
+  }
+
+  bool HbAcyclic() {
+    if (default_hb_) {
+      return hb_.Acyclic(&cycle_);
+    }
+
+    return arch_->shared_hb(*exec_)->Acyclic(&cycle_);
+  }
+
+  void Check() {
+    if (!failed_.valid()) {
+      return;  // report the first violation only
+    }
+
+    if (!com_po_loc_.Acyclic(&cycle_)) {
+      failed_.failed = "SC_PER_LOCATION";
+    } else if (!HbAcyclic()) {
+      if (stale_) {
+        // ppo may include tuples derived from erased observations.
+        Rebuild();
+        return;
+      }
+
+      failed_.failed = "NO_THIN_AIR";
+    } else {
+      return;
+    }
+
+    failed_.verdict = CheckResult::kInvalid;
+    failed_.SetCycle(exec_->table, cycle_);
+  }
+
+  const Architecture* arch_;
+  const ExecWitness* exec_;
+  bool begun_;
+  bool dirty_;
+  bool default_hb_;
+  bool stale_;
+  CheckResult failed_;
+  EventRel::Path cycle_;
+  EventRel po_loc_;
+  EventRel com_po_loc_;
+  EventRel hb_;
+};
+
+/**
+ * @brief Bounded cache of verdicts, keyed on the fingerprint of an
+ * ExecWitness and the architecture.
+ *
+ * Architectures are identified by their dynamic type and the fingerprint of
+ * their state (see Architecture::AddFingerprint): verdicts are shared by
+ * distinct instances with equal state. When full, the least recently used
+ * verdict is evicted. Thread-safe; checks on a miss are performed without
+ * holding the lock, i.e. concurrent misses on the same key may check
+ * redundantly.
+ */
+class VerdictCache {
+ public:
+  struct Stats {
+    Stats() : hits(0), misses(0) {}
+
+    double hit_rate() const {
+      const std::size_t total = hits + misses;
+      return total != 0
+                 ? static_cast<double>(hits) / static_cast<double>(total)
+                 : 0.0;
+    }
+
+    std::size_t hits;
+    std::size_t misses;
+  };
+
+  explicit VerdictCache(std::size_t capacity = 4096) : capacity_(capacity) {
+    assert(capacity_ > 0);
+  }
+
+  /**
+   * @return Cached result for exec on arch, or else the result of
+   *         Checker::check() on exec, which is then cached. The cycle of a
+   *         cached result is given as indices into exec.table.
+   */
+  CheckResult Check(const Architecture& arch, const ExecWitness& exec) {
+    FingerprintBuilder arch_fingerprint;
+    arch.AddFingerprint(&arch_fingerprint);
+
+    const Key key{exec.fingerprint(), std::type_index(typeid(arch)),
+                  arch_fingerprint.Get()};
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      const auto it = index_.find(key);
+      if (it != index_.end()) {
+        ++stats_.hits;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        CheckResult result = it->second->second;
+        if (!result.cycle_path.empty()) {
+          // Indices are relative to the table of the execution checked.
+          result.SetCycle(exec.table, result.cycle_path);
+        }
+        return result;
+      }
+
+      ++stats_.misses;
+    }
+
+    CheckResult result = arch.MakeChecker(&arch, &exec)->check();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (index_.count(key) == 0) {
+      lru_.emplace_front(key, result);
+      index_.emplace(key, lru_.begin());
+
+      if (lru_.size() > capacity_) {
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+      }
+    }
+
+    return result;
+  }
+
+  Stats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+  }
+
+  std::size_t capacity() const { return capacity_; }
+
+  /**
+   * Clears cached verdicts and statistics.
+   */
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.clear();
+    lru_.clear();
+    stats_ = Stats();
+  }
+
+ private:
+  struct Key {
+    struct Hash {
+      std::size_t operator()(const Key& k) const {
+        return sets::HashCombine(
+            sets::HashCombine(Fingerprint::Hash()(k.fingerprint),
+                              k.arch_type.hash_code()),
+            Fingerprint::Hash()(k.arch_fingerprint));
+      }
+    };
+
+    bool operator==(const Key& rhs) const {
+      return fingerprint == rhs.fingerprint && arch_type == rhs.arch_type &&
+             arch_fingerprint == rhs.arch_fingerprint;
+    }
+
+    Fingerprint fingerprint;
+    std::type_index arch_type;
+    Fingerprint arch_fingerprint;
+  };
+
+  typedef std::list<std::pair<Key, CheckResult>> List;
+
+  std::size_t capacity_;
+  mutable std::mutex mutex_;
+  List lru_;
+  std::unordered_map<Key, List::iterator, Key::Hash> index_;
+  Stats stats_;
+};
+
+/**
+ * Creates an Architecture to check one ExecWitness with; as witnesses are
+ * checked concurrently, every call must return a separate instance (e.g. a
+ * copy of a common Architecture).
+ */
+typedef std::function<std::unique_ptr<Architecture>()> ArchFactory;
+
+/**
+ * Checks witnesses [first, last) concurrently on pool; an architecture is
+ * created per witness by make_arch. If cache is given, verdicts are looked
+ * up in and added to it.
+ *
+ * Witnesses must not be modified (nor checked otherwise) until this returns;
+ * distinct witnesses are checked concurrently, each using its own arena, and
+ * the caller's EventTable::Current(). The calling thread checks witnesses as
+ * well (see parallel::ForEach), s.t. this may be called from within a task
+ * of pool.
+ *
+ * @return Results, in the order of the witnesses.
+ */
+template <class InputIt>
+inline std::vector<CheckResult> CheckBatch(InputIt first, InputIt last,
+                                           const ArchFactory& make_arch,
+                                           parallel::ThreadPool* pool,
+                                           VerdictCache* cache = nullptr) {
+  std::vector<const ExecWitness*> execs;
+  for (; first != last; ++first) {
+    execs.push_back(&*first);
+  }
+
+  std::vector<CheckResult> result(execs.size());
+  const auto table = EventTable::Current();
+
+  parallel::ForEach(pool, execs.size(), [&](std::size_t i) {
+    const EventTableScope table_scope(table);
+    const std::unique_ptr<Architecture> arch = make_arch();
+    result[i] = cache != nullptr
+                    ? cache->Check(*arch, *execs[i])
+                    : arch->MakeChecker(arch.get(), execs[i])->check();
+  });
+
+  return result;
+}
+
+inline std::vector<CheckResult> CheckBatch(
+    const std::vector<ExecWitness>& execs, const ArchFactory& make_arch,
+    parallel::ThreadPool* pool, VerdictCache* cache = nullptr) {
+  return CheckBatch(execs.begin(), execs.end(), make_arch, pool, cache);
+}
+
 /*
 =============================
 Some common memory models.
@@ -400,36 +1452,119 @@ class Arch_SC : public Architecture {
     return std::unique_ptr<Checker>(new Checker(arch, exec));
   }
 
+  std::uint64_t generation() const override { return 0; }  // no state
+
   EventRel ppo(const ExecWitness& ew) const override {
     assert(ew.po.Transitive());
+
+    const ProgramOrder program_order = ew.program_order();
+    if (program_order.valid()) {
+      return program_order.Chains();
+    }
+
     return ew.po.Eval();
   }
 
   EventRel fences(const ExecWitness& ew) const override { return EventRel(); }
 
   EventRel prop(const ExecWitness& ew) const override {
-    return proxy_->ppo(ew) | proxy_->fences(ew) | ew.rf | ew.fr();
+    return *proxy_->shared_ppo(ew) | *proxy_->shared_fences(ew) | ew.rf |
+           ew.fr();
   }
 
+  bool default_hb() const override { return typeid(*this) == typeid(Arch_SC); }
+
   Event::Type EventTypeRead() const override { return Event::kRead; }
 
   Event::Type EventTypeWrite() const override { return Event::kWrite; }
 };
 
+/**
+ * @brief Checker specialised for Arch_TSO.
+ *
+ * On TSO, hb and fre are included in prop, s.t. PROPAGATION (acyclic co |
+ * prop) implies NO_THIN_AIR and OBSERVATION: an execution is valid iff
+ * SC_PER_LOCATION and PROPAGATION hold. Both are tested with a topological
+ * sort each (see ScAcyclic and TsoAcyclic), in time linear in the size of the
+ * execution, and without evaluating any architecture relations. Only if
+ * either test fails (or is inconclusive) are the axioms checked by Checker,
+ * to determine the failed axiom and its cycle; i.e. results are the same.
+ */
+class TsoChecker : public Checker {
+ public:
+  /**
+   * @param mfence Arch_TSO::mfence, which must outlive the checker.
+   */
+  TsoChecker(const Architecture* arch, const ExecWitness* exec,
+             const EventRel* mfence)
+      : Checker(arch, exec), mfence_(mfence) {}
+
+  /**
+   * Sufficient condition for a well-formed execution to be valid on TSO; see
+   * above.
+   */
+  bool tso_acyclic() const {
+    const ProgramOrder program_order = exec_->program_order();
+    if (!program_order.valid()) {
+      return false;
+    }
+
+    const CoherenceOrder coherence_order(exec_->co);
+    return ScAcyclic(
+               program_order.Partition([](const Event& e) { return e.addr; })
+                   .Chains(),
+               exec_->rf, coherence_order) &&
+           TsoAcyclic(program_order, exec_->rf, coherence_order, *mfence_);
+  }
+
+  const char* failed_axiom(EventRel::Path* cyclic = nullptr) const override {
+    if (tso_acyclic()) {
+      return nullptr;
+    }
+
+    return Checker::failed_axiom(cyclic);
+  }
+
+ private:
+  const EventRel* mfence_;
+};
+
 class Arch_TSO : public Architecture {
  public:
+  Arch_TSO() : linear_checker_(true) {}
+
   void Clear() override { mfence.Clear(); }
 
+  /**
+   * @return TsoChecker, unless disabled via set_linear_checker(false), or
+   *         this is a subclass: TsoChecker assumes this class' relations.
+   */
   std::unique_ptr<Checker> MakeChecker(const Architecture* arch,
                                        const ExecWitness* exec) const override {
+    if (linear_checker_ && typeid(*this) == typeid(Arch_TSO)) {
+      return std::unique_ptr<Checker>(new TsoChecker(arch, exec, &mfence));
+    }
+
     return std::unique_ptr<Checker>(new Checker(arch, exec));
   }
 
+  void set_linear_checker(bool val) { linear_checker_ = val; }
+
+  bool linear_checker() const { return linear_checker_; }
+
   EventRel ppo(const ExecWitness& ew) const override {
     assert(ew.po.Transitive());
-    return ew.po.Filter([](const Event& e1, const Event& e2) {
+
+    const auto not_wr = [](const Event& e1, const Event& e2) {
       return !e1.AllType(Event::kWrite) || !e2.AllType(Event::kRead);
-    });
+    };
+
+    const ProgramOrder program_order = ew.program_order();
+    if (program_order.valid()) {
+      return program_order.Filter(not_wr);
+    }
+
+    return ew.po.Filter(not_wr);
   }
 
   EventRel fences(const ExecWitness& ew) const override {
@@ -438,20 +1573,33 @@ class Arch_TSO : public Architecture {
     }
 
     // Filter postar by only those events which are possibly relevent.
-    const auto postar =
-        ew.po
-            .Filter([&](const Event& e1, const Event& e2) {
-              // Only include those where first event is write or second
-              // is a read, all other are included in po regardless.
-              return e1.AllType(Event::kWrite) || e2.AllType(Event::kRead);
-            })
-            .set_props(EventRel::kReflexiveClosure);
+    const auto relevant = [](const Event& e1, const Event& e2) {
+      // Only include those where first event is write or second is a read,
+      // all other are included in po regardless.
+      return e1.AllType(Event::kWrite) || e2.AllType(Event::kRead);
+    };
+
+    const ProgramOrder program_order = ew.program_order();
+    auto postar = program_order.valid() ? program_order.Filter(relevant)
+                                        : ew.po.Filter(relevant);
+    postar.set_props(EventRel::kReflexiveClosure);
 
     return EventRelSeq({postar, mfence, postar}).EvalClear();
   }
 
   EventRel prop(const ExecWitness& ew) const override {
-    return proxy_->ppo(ew) | proxy_->fences(ew) | ew.rfe() | ew.fr();
+    return *proxy_->shared_ppo(ew) | *proxy_->shared_fences(ew) | ew.rfe() |
+           ew.fr();
+  }
+
+  bool default_hb() const override {
+    return typeid(*this) == typeid(Arch_TSO);
+  }
+
+  std::uint64_t generation() const override { return mfence.generation(); }
+
+  void AddFingerprint(FingerprintBuilder* fb) const override {
+    fb->Add(mfence);
   }
 
   Event::Type EventTypeRead() const override { return Event::kRead; }
@@ -460,6 +1608,9 @@ class Arch_TSO : public Architecture {
 
  public:
   EventRel mfence;
+
+ private:
+  bool linear_checker_;
 };
 
 /**
@@ -478,6 +1629,16 @@ class Arch_ARMv7 : public Architecture {
     isb.Clear();
   }
 
+  std::uint64_t generation() const override {
+    return generation_.Get({{dd_reg.generation(), dsb.generation(),
+                             dmb.generation(), dsb_st.generation(),
+                             dmb_st.generation(), isb.generation()}});
+  }
+
+  void AddFingerprint(FingerprintBuilder* fb) const override {
+    fb->Add(dd_reg).Add(dsb).Add(dmb).Add(dsb_st).Add(dmb_st).Add(isb);
+  }
+
   std::unique_ptr<Checker> MakeChecker(const Architecture* arch,
                                        const ExecWitness* exec) const override {
     return std::unique_ptr<Checker>(new Checker(arch, exec));
@@ -511,17 +1672,23 @@ class Arch_ARMv7 : public Architecture {
           }
         });
 
-    EventRel ctrl = EventRelSeq({ctrl_part, ew.po}).EvalClear();
+    const ProgramOrder program_order = ew.program_order();
+    const auto po_seq = [&program_order, &ew](const EventRel& lhs) {
+      return program_order.valid() ? program_order.Seq(lhs)
+                                   : EventRelSeq({lhs, ew.po}).EvalClear();
+    };
+
+    EventRel ctrl = po_seq(ctrl_part);
     EventRel ctrl_cfence = EventRelSeq({ctrl_part, isb}).EvalClear();
 
     // 2. Compute helper relations
     //
-    const auto po_loc = ew.po_loc();
-    const auto rfe = ew.rfe();
+    const auto& po_loc = ew.po_loc();
+    const auto& rfe = ew.rfe();
     EventRel dd = addr | data;
     EventRel rdw = po_loc & EventRelSeq({ew.fre(), rfe}).EvalClear();
     EventRel detour = po_loc & EventRelSeq({ew.coe(), rfe}).EvalClear();
-    EventRel addrpo = EventRelSeq({addr, ew.po}).EvalClear();
+    EventRel addrpo = po_seq(addr);
 
     // 3. Compute ppo
     //
@@ -531,28 +1698,51 @@ class Arch_ARMv7 : public Architecture {
     EventRel cc = dd | ctrl | addrpo | po_loc;
     EventRel ic;
 
-    std::size_t total_size = ci.size() + ii.size() + cc.size() + ic.size();
-    std::size_t prev_total_size;
-
-    // Fix-point computation
-    do {
-      prev_total_size = total_size;
-
-      ci |=
-          EventRelSeq({ci, ii}).EvalClear() | EventRelSeq({cc, ci}).EvalClear();
-
-      ii |= ci | EventRelSeq({ic, ci}).EvalClear() |
-            EventRelSeq({ii, ii}).EvalClear();
-
-      cc |= ci | EventRelSeq({ci, ic}).EvalClear() |
-            EventRelSeq({cc, cc}).EvalClear();
-
-      ic |= ii | cc | EventRelSeq({ic, cc}).EvalClear() |
-            EventRelSeq({ii, ic}).EvalClear();
-
-      total_size = ci.size() + ii.size() + cc.size() + ic.size();
-      assert(prev_total_size <= total_size);
-    } while (total_size != prev_total_size);
+    // Fix-point computation, semi-naive: each round only composes the tuples
+    // derived in the previous round (deltas) with the full relations, as any
+    // newly derivable tuple must depend on at least one of them.
+    EventRel d_ci = ci;
+    EventRel d_ii = ii;
+    EventRel d_cc = cc;
+    EventRel d_ic = ic;
+
+    while (!d_ci.empty() || !d_ii.empty() || !d_cc.empty() || !d_ic.empty()) {
+      EventRel n_ci, n_ii, n_cc, n_ic;
+
+      SeqNew(d_ci, ii, ci, &n_ci);
+      SeqNew(ci, d_ii, ci, &n_ci);
+      SeqNew(d_cc, ci, ci, &n_ci);
+      SeqNew(cc, d_ci, ci, &n_ci);
+
+      UnionNew(d_ci, ii, &n_ii);
+      SeqNew(d_ic, ci, ii, &n_ii);
+      SeqNew(ic, d_ci, ii, &n_ii);
+      SeqNew(d_ii, ii, ii, &n_ii);
+      SeqNew(ii, d_ii, ii, &n_ii);
+
+      UnionNew(d_ci, cc, &n_cc);
+      SeqNew(d_ci, ic, cc, &n_cc);
+      SeqNew(ci, d_ic, cc, &n_cc);
+      SeqNew(d_cc, cc, cc, &n_cc);
+      SeqNew(cc, d_cc, cc, &n_cc);
+
+      UnionNew(d_ii, ic, &n_ic);
+      UnionNew(d_cc, ic, &n_ic);
+      SeqNew(d_ic, cc, ic, &n_ic);
+      SeqNew(ic, d_cc, ic, &n_ic);
+      SeqNew(d_ii, ic, ic, &n_ic);
+      SeqNew(ii, d_ic, ic, &n_ic);
+
+      ci |= n_ci;
+      ii |= n_ii;
+      cc |= n_cc;
+      ic |= n_ic;
+
+      d_ci = std::move(n_ci);
+      d_ii = std::move(n_ii);
+      d_cc = std::move(n_cc);
+      d_ic = std::move(n_ic);
+    }
 
     EventRel result = ic.Filter([this](const Event& e1, const Event& e2) {
       return e1.AnyType(EventTypeRead()) && e2.AnyType(EventTypeWrite());
@@ -566,7 +1756,10 @@ class Arch_ARMv7 : public Architecture {
 
   // Ensure fences is transitive
   EventRel fences(const ExecWitness& ew) const override {
-    const auto postar = ew.po.Eval().set_props(EventRel::kReflexiveClosure);
+    const ProgramOrder program_order = ew.program_order();
+    const auto postar =
+        (program_order.valid() ? program_order.Chains() : ew.po.Eval())
+            .set_props(EventRel::kReflexiveTransitiveClosure);
     const auto postar_WW = postar.Filter([&](const Event& e1, const Event& e2) {
       return e1.AllType(Event::kWrite) && e2.AllType(Event::kWrite);
     });
@@ -577,14 +1770,14 @@ class Arch_ARMv7 : public Architecture {
   }
 
   EventRel prop(const ExecWitness& ew) const override {
-    EventRel hbstar = proxy_->hb(ew)
-                          .set_props(EventRel::kReflexiveTransitiveClosure)
-                          .EvalInplace();
-    EventRel A_cumul = EventRelSeq({ew.rfe(), proxy_->fences(ew)}).EvalClear();
-    EventRel propbase =
-        EventRelSeq({(proxy_->fences(ew) | A_cumul), hbstar}).EvalClear();
+    const EventRelPtr fences = proxy_->shared_fences(ew);
+    EventRel hbstar = *proxy_->shared_hb(ew);
+    hbstar.set_props(EventRel::kReflexiveTransitiveClosure).EvalInplace();
+    EventRel A_cumul = EventRelSeq({ew.rfe(), *fences}).EvalClear();
+    EventRel propbase = EventRelSeq({(*fences | A_cumul), hbstar}).EvalClear();
 
-    EventRel comstar = ew.com().set_props(EventRel::kReflexiveClosure);
+    EventRel comstar = ew.com();
+    comstar.set_props(EventRel::kReflexiveClosure);
 
     EventRel result = propbase.Filter([this](const Event& e1, const Event& e2) {
       return e1.AnyType(EventTypeWrite()) && e2.AnyType(EventTypeWrite());
@@ -592,11 +1785,15 @@ class Arch_ARMv7 : public Architecture {
 
     propbase.set_props(EventRel::kReflexiveTransitiveClosure).EvalInplace();
     result |=
-        EventRelSeq({comstar, propbase /*star*/, proxy_->fences(ew), hbstar})
+        EventRelSeq({comstar, propbase /*star*/, *fences, hbstar})
             .EvalClear();
     return result;
   }
 
+  bool default_hb() const override {
+    return typeid(*this) == typeid(Arch_ARMv7);
+  }
+
   Event::Type EventTypeRead() const override { return Event::kRead; }
 
   Event::Type EventTypeWrite() const override { return Event::kWrite; }
@@ -608,6 +1805,62 @@ class Arch_ARMv7 : public Architecture {
   EventRel dsb_st;
   EventRel dmb_st;
   EventRel isb;
+
+ private:
+  /**
+   * @return true if (e1, e2) is in rel, which must not have properties.
+   */
+  static bool Contains(const EventRel& rel, const Event& e1, const Event& e2) {
+    const auto tuples = rel.get().find(e1);
+    return tuples != rel.get().end() && tuples->second.Contains(e2);
+  }
+
+  /**
+   * Adds the tuples of rel not in known to out; for relations without
+   * properties.
+   */
+  static void UnionNew(const EventRel& rel, const EventRel& known,
+                       EventRel* out) {
+    assert(!rel.props() && !known.props());
+
+    for (const auto& tuples : rel.get()) {
+      for (const auto& e : tuples.second.get()) {
+        if (!Contains(known, tuples.first, e)) {
+          out->Insert(tuples.first, e);
+        }
+      }
+    }
+  }
+
+  /**
+   * Adds the tuples of lhs;rhs not in known to out; for relations without
+   * properties.
+   */
+  static void SeqNew(const EventRel& lhs, const EventRel& rhs,
+                     const EventRel& known, EventRel* out) {
+    assert(!lhs.props() && !rhs.props() && !known.props());
+
+    if (lhs.empty() || rhs.empty()) {
+      return;
+    }
+
+    for (const auto& tuples : lhs.get()) {
+      for (const auto& e : tuples.second.get()) {
+        const auto rhs_tuples = rhs.get().find(e);
+        if (rhs_tuples == rhs.get().end()) {
+          continue;
+        }
+
+        for (const auto& e2 : rhs_tuples->second.get()) {
+          if (!Contains(known, tuples.first, e2)) {
+            out->Insert(tuples.first, e2);
+          }
+        }
+      }
+    }
+  }
+
+  sets::CompositeGeneration<6> generation_;
 };
 
 }  // namespace cats
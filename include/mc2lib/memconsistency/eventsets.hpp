@@ -34,11 +34,18 @@
 #ifndef MC2LIB_MEMCONSISTENCY_EVENTSETS_HPP_
 #define MC2LIB_MEMCONSISTENCY_EVENTSETS_HPP_
 
+#include <cstddef>
+#include <cstdint>
 #include <iomanip>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "../parallel.hpp"
 #include "../sets.hpp"
 #include "../types.hpp"
 
@@ -55,7 +62,8 @@ class Iiid {
   struct Hash {
     typedef std::hash<types::Poi>::result_type result_type;
     result_type operator()(const Iiid& k) const {
-      return std::hash<types::Poi>()(k.poi);
+      return sets::HashCombine(std::hash<types::Poi>()(k.poi),
+                               std::hash<types::Pid>()(k.pid));
     }
   };
 
@@ -104,7 +112,10 @@ class Event {
  public:
   struct Hash {
     Iiid::Hash::result_type operator()(const Event& k) const {
-      return Iiid::Hash()(k.iiid);
+      // Events of multi-byte operations share the same iiid, but differ in
+      // address.
+      return sets::HashCombine(Iiid::Hash()(k.iiid),
+                               std::hash<types::Addr>()(k.addr));
     }
   };
 
@@ -220,9 +231,1058 @@ class Event {
   Iiid iiid;
 };
 
-typedef sets::Set<sets::Types<Event>> EventSet;
-typedef sets::Relation<sets::Types<Event>> EventRel;
-typedef sets::RelationSeq<sets::Types<Event>> EventRelSeq;
+/**
+ * Dense index of an Event, as assigned by an EventTable.
+ */
+typedef std::uint32_t EventIdx;
+
+/**
+ * Container types used by EventSet, EventRel and EventRelSeq. Define
+ * MC2LIB_DENSE_EVENTSETS to use dense bit-matrix containers (see
+ * sets::DenseTypes), which index events via the current EventTable (see
+ * EventTableScope), MC2LIB_FLAT_EVENTSETS to use open-addressing hash tables
+ * (see sets::FlatTypes), or MC2LIB_SMALL_EVENTSETS to store small sets
+ * inline (see sets::SmallTypes), instead of node-based hash containers.
+ * Define MC2LIB_ARENA_EVENTSETS to allocate node-based hash containers from
+ * the current sets::Arena, as set up by the checkers.
+ */
+#if defined(MC2LIB_DENSE_EVENTSETS)
+typedef sets::DenseTypes<
+    Event, Event::Hash,
+    sets::InternIndexer<Event, Event::Hash,
+                        sets::Interner<Event, Event::Hash, EventIdx>>>
+    EventTypes;
+#elif defined(MC2LIB_FLAT_EVENTSETS)
+typedef sets::FlatTypes<Event> EventTypes;
+#elif defined(MC2LIB_SMALL_EVENTSETS)
+typedef sets::SmallTypes<Event> EventTypes;
+#elif defined(MC2LIB_ARENA_EVENTSETS)
+typedef sets::Types<Event, Event::Hash, sets::ArenaAllocator<Event>>
+    EventTypes;
+#else
+typedef sets::Types<Event> EventTypes;
+#endif
+
+typedef sets::Set<EventTypes> EventSet;
+typedef sets::Relation<EventTypes> EventRel;
+typedef sets::RelationSeq<EventTypes> EventRelSeq;
+
+/**
+ * Container types for sets and relations keyed on EventIdx: sets are bit
+ * vectors, relations are vectors of such rows.
+ */
+typedef sets::DenseTypes<EventIdx, std::hash<EventIdx>,
+                         sets::IdentityIndexer<EventIdx>>
+    EventIdxTypes;
+
+typedef sets::Set<EventIdxTypes> EventIdxSet;
+typedef sets::Relation<EventIdxTypes> EventIdxRel;
+typedef sets::RelationSeq<EventIdxTypes> EventIdxRelSeq;
+
+/**
+ * @brief Assigns every Event of an execution a dense index.
+ *
+ * Indices are assigned in order of insertion, starting at 0. References to
+ * Events in the table remain valid until Clear(), and can therefore be handed
+ * out as stable Event pointers.
+ */
+class EventTable : public sets::Interner<Event, Event::Hash, EventIdx> {
+ public:
+  /**
+   * Converts set of Events to set of indices; Events not yet in the table are
+   * inserted.
+   */
+  EventIdxSet ToIdx(const EventSet& es) {
+    EventIdxSet result;
+
+    for (const auto& e : es.get()) {
+      result.Insert(Insert(e));
+    }
+
+    return result;
+  }
+
+  /**
+   * Converts relation on Events to relation on indices; Events not yet in the
+   * table are inserted. Properties are preserved.
+   */
+  EventIdxRel ToIdx(const EventRel& er) {
+    EventIdxRel result;
+
+    for (const auto& tuples : er.get()) {
+      const EventIdx e1 = Insert(tuples.first);
+      for (const auto& e2 : tuples.second.get()) {
+        result.Insert(e1, Insert(e2));
+      }
+    }
+
+    result.set_props(er.props());
+    return result;
+  }
+
+  EventSet ToEvents(const EventIdxSet& es) const {
+    EventSet result;
+
+    for (const auto idx : es.get()) {
+      result.Insert(Get(idx));
+    }
+
+    return result;
+  }
+
+  EventRel ToEvents(const EventIdxRel& er) const {
+    EventRel result;
+
+    for (const auto& tuples : er.get()) {
+      const Event& e1 = Get(tuples.first);
+      for (const auto idx : tuples.second.get()) {
+        result.Insert(e1, Get(idx));
+      }
+    }
+
+    result.set_props(er.props());
+    return result;
+  }
+};
+
+/**
+ * @brief Sets the table via which dense EventSets and EventRels index events
+ * in the current thread (see MC2LIB_DENSE_EVENTSETS), e.g. the table of the
+ * ExecWitness being built and checked.
+ *
+ * Without a scope, events are interned in a process-wide table, and dense
+ * containers are sized according to all events ever used. Checkers
+ * evaluating parts of a check on other threads set the caller's table for
+ * them (see EventTable::Current()).
+ */
+typedef sets::InternScope<sets::Interner<Event, Event::Hash, EventIdx>>
+    EventTableScope;
+
+/**
+ * @brief Range of events in a vector, e.g. a chain of ProgramOrder.
+ */
+class EventRange {
+ public:
+  typedef std::vector<Event>::const_iterator const_iterator;
+
+  EventRange() {}
+
+  EventRange(const_iterator first, const_iterator last)
+      : begin_(first), end_(last) {}
+
+  const_iterator begin() const { return begin_; }
+
+  const_iterator end() const { return end_; }
+
+  std::size_t size() const { return end_ - begin_; }
+
+  bool empty() const { return begin_ == end_; }
+
+ private:
+  const_iterator begin_;
+  const_iterator end_;
+};
+
+/**
+ * @brief Implicit representation of the transitive closure of program order.
+ *
+ * Program order is a union of per-thread total orders, which event producers
+ * (e.g. codegen) construct as chains, i.e. by relating each event to its
+ * immediate successor only. ProgramOrder stores these chains, and answers
+ * queries about their transitive closure without materialising it: R() is a
+ * comparison of positions, and Reachable() is a range of a chain.
+ */
+class ProgramOrder {
+ public:
+  typedef std::vector<Event> Chain;
+  typedef EventRange Range;
+
+  ProgramOrder() : valid_(true) {}
+
+  /**
+   * @return Empty ProgramOrder, which is not valid(); for callers which must
+   *         fall back to the explicit relation.
+   */
+  static ProgramOrder Invalid() {
+    ProgramOrder result;
+    result.valid_ = false;
+    return result;
+  }
+
+  /**
+   * Extracts chains from the tuples of po (irrespective of po's properties,
+   * i.e. this represents the transitive closure of po's tuples).
+   *
+   * @param po Relation, in which every event must have at most one immediate
+   *           successor and predecessor, and which must be acyclic; otherwise
+   *           valid() is false, and this represents the empty relation.
+   */
+  explicit ProgramOrder(const EventRel& po) : valid_(true) {
+    EventTypes::MapContainer<bool> has_pred;
+    for (const auto& tuples : po.get()) {
+      if (tuples.second.size() > 1) {
+        valid_ = false;
+        return;
+      }
+
+      for (const auto& e : tuples.second.get()) {
+        if (has_pred.count(e) != 0) {
+          valid_ = false;
+          return;
+        }
+
+        has_pred[e] = true;
+      }
+    }
+
+    for (const auto& tuples : po.get()) {
+      if (has_pred.count(tuples.first) != 0) {
+        continue;
+      }
+
+      chains_.emplace_back();
+      for (Event e = tuples.first;;) {
+        position_[e] = Position{chains_.size() - 1, chains_.back().size()};
+        chains_.back().push_back(e);
+
+        const auto succ = po.get().find(e);
+        if (succ == po.get().end()) {
+          break;
+        }
+
+        e = *succ->second.get().begin();
+      }
+    }
+
+    // Every event either has a predecessor or starts a chain; events on a
+    // cycle are not reachable from any chain's start.
+    if (position_.size() != has_pred.size() + chains_.size()) {
+      Clear();
+      valid_ = false;
+    }
+  }
+
+  /**
+   * @return true if constructed from a relation consisting of chains.
+   */
+  bool valid() const { return valid_; }
+
+  const std::vector<Chain>& chains() const { return chains_; }
+
+  bool InOn(const Event& e) const { return position_.count(e) != 0; }
+
+  /**
+   * @return true if e1 is before e2 in the same chain.
+   */
+  bool R(const Event& e1, const Event& e2) const {
+    const auto p1 = position_.find(e1);
+    if (p1 == position_.end()) {
+      return false;
+    }
+
+    const auto p2 = position_.find(e2);
+    return p2 != position_.end() && p1->second.chain == p2->second.chain &&
+           p1->second.pos < p2->second.pos;
+  }
+
+  /**
+   * @return Events after e in its chain.
+   */
+  Range Reachable(const Event& e) const {
+    const auto p = position_.find(e);
+    if (p == position_.end()) {
+      return Range();
+    }
+
+    const Chain& chain = chains_[p->second.chain];
+    return Range(chain.begin() + p->second.pos + 1, chain.end());
+  }
+
+  /**
+   * @return Number of tuples in the transitive closure.
+   */
+  std::size_t size() const {
+    std::size_t result = 0;
+    for (const auto& chain : chains_) {
+      result += chain.size() * (chain.size() - 1) / 2;
+    }
+    return result;
+  }
+
+  bool empty() const { return chains_.empty(); }
+
+  void Clear() {
+    chains_.clear();
+    position_.clear();
+  }
+
+  /**
+   * Splits every chain into subsequences of events with the same key; e.g.
+   * with the event's address as key, this obtains po-loc.
+   *
+   * @param key Function mapping an event to its key.
+   */
+  template <class KeyFunc>
+  ProgramOrder Partition(KeyFunc key) const {
+    ProgramOrder result;
+    result.valid_ = valid_;
+
+    for (const auto& chain : chains_) {
+      std::unordered_map<decltype(key(chain.front())), std::size_t> chain_of;
+
+      for (const auto& e : chain) {
+        const auto it = chain_of.emplace(key(e), result.chains_.size()).first;
+        if (it->second == result.chains_.size()) {
+          result.chains_.emplace_back();
+        }
+
+        Chain& sub = result.chains_[it->second];
+        result.position_[e] = Position{it->second, sub.size()};
+        sub.push_back(e);
+      }
+    }
+
+    return result;
+  }
+
+  /**
+   * @return The immediate successor tuples, with properties set to props;
+   *         with the default (transitive closure), this is the same relation
+   *         as represented by this ProgramOrder.
+   */
+  EventRel Chains(
+      EventRel::Properties props = EventRel::kTransitiveClosure) const {
+    EventRel result;
+
+    for (const auto& chain : chains_) {
+      for (std::size_t i = 1; i < chain.size(); ++i) {
+        result.Insert(chain[i - 1], chain[i]);
+      }
+    }
+
+    result.set_props(props);
+    return result;
+  }
+
+  /**
+   * @return Materialised transitive closure.
+   */
+  EventRel Eval() const {
+    return Filter([](const Event&, const Event&) { return true; });
+  }
+
+  template <class FilterFunc>
+  EventRel Filter(FilterFunc filterFunc) const {
+    EventRel result;
+
+    for (const auto& chain : chains_) {
+      for (auto e1 = chain.begin(); e1 != chain.end(); ++e1) {
+        for (auto e2 = e1 + 1; e2 != chain.end(); ++e2) {
+          if (filterFunc(*e1, *e2)) {
+            result.Insert(*e1, *e2);
+          }
+        }
+      }
+    }
+
+    return result;
+  }
+
+  /**
+   * @return Sequential composition lhs ; po, i.e. equivalent to
+   *         EventRelSeq({lhs, po}).EvalClear().
+   */
+  EventRel Seq(const EventRel& lhs) const {
+    EventRel result;
+
+    lhs.for_each([this, &result](const Event& e1, const Event& e2) {
+      for (const auto& e : Reachable(e2)) {
+        result.Insert(e1, e);
+      }
+    });
+
+    return result;
+  }
+
+ private:
+  struct Position {
+    std::size_t chain;
+    std::size_t pos;
+  };
+
+  std::vector<Chain> chains_;
+  EventTypes::MapContainer<Position> position_;
+  bool valid_;
+};
+
+/**
+ * @brief Coherence order (or write serialization), as one vector of writes
+ * per address.
+ *
+ * Coherence order is a total order of writes per address (see wf_co), and fr
+ * relates a read to all writes coherence-after the write it reads from;
+ * with writes in order, these are a suffix of the address' vector, s.t. fr
+ * is derived in time linear in its size.
+ */
+class CoherenceOrder {
+ public:
+  typedef std::vector<Event> Writes;
+
+  CoherenceOrder() : valid_(true) {}
+
+  /**
+   * @param co Relation, which is a strict total order on the writes of each
+   *           address, and does not relate writes of different addresses;
+   *           otherwise (or if co is not transitive), valid() is false, and
+   *           this represents the empty relation.
+   */
+  explicit CoherenceOrder(const EventRel& co) : valid_(true) {
+    if (co.any_props(EventRel::kReflexiveClosure)) {
+      valid_ = false;
+      return;
+    }
+
+    // Topological sort per address; the order is total iff at each step
+    // there is only one candidate per address.
+    EventTypes::MapContainer<std::size_t> in_degree;
+    std::unordered_map<types::Addr, std::size_t> addr_idx;
+    std::size_t num_tuples = 0;
+
+    for (const auto& tuples : co.get()) {
+      in_degree[tuples.first];
+      addr_idx.emplace(tuples.first.addr, addr_idx.size());
+
+      for (const auto& e : tuples.second.get()) {
+        if (e.addr != tuples.first.addr) {
+          valid_ = false;
+          return;
+        }
+
+        ++in_degree[e];
+        ++num_tuples;
+      }
+    }
+
+    writes_.resize(addr_idx.size());
+    std::vector<Event> ready;
+    std::vector<std::size_t> num_ready(addr_idx.size(), 0);
+
+    for (const auto& deg : in_degree) {
+      if (deg.second == 0) {
+        ready.push_back(deg.first);
+        if (++num_ready[addr_idx[deg.first.addr]] > 1) {
+          valid_ = false;
+          return;
+        }
+      }
+    }
+
+    while (!ready.empty()) {
+      const Event w = ready.back();
+      ready.pop_back();
+
+      const std::size_t idx = addr_idx[w.addr];
+      --num_ready[idx];
+      position_[w] = Position{idx, writes_[idx].size()};
+      writes_[idx].push_back(w);
+
+      const auto succ = co.get().find(w);
+      if (succ == co.get().end()) {
+        continue;
+      }
+
+      for (const auto& e : succ->second.get()) {
+        if (--in_degree[e] == 0) {
+          ready.push_back(e);
+          if (++num_ready[idx] > 1) {
+            Clear();
+            valid_ = false;
+            return;
+          }
+        }
+      }
+    }
+
+    std::size_t closure_size = 0;
+    for (const auto& writes : writes_) {
+      closure_size += writes.size() * (writes.size() - 1) / 2;
+    }
+
+    if (position_.size() != in_degree.size() ||
+        (!co.all_props(EventRel::kTransitiveClosure) &&
+         num_tuples != closure_size)) {
+      // Cyclic, or co's tuples are not transitive themselves.
+      Clear();
+      valid_ = false;
+    }
+  }
+
+  /**
+   * @return true if constructed from a relation consisting of per-address
+   *         strict total orders.
+   */
+  bool valid() const { return valid_; }
+
+  void Clear() {
+    writes_.clear();
+    position_.clear();
+  }
+
+  /**
+   * Tests, in time linear in the size of on, if the relation this was
+   * constructed from is a strict total order on the events of on, per
+   * address it orders; i.e. the ordered writes are in on, and all events of
+   * on to an address are ordered, if any to the same address are.
+   *
+   * @return true if valid() and the above holds.
+   */
+  bool StrictTotalOrderPerAddr(const EventSet& on) const {
+    if (!valid_) {
+      return false;
+    }
+
+    std::unordered_set<types::Addr> addrs;
+    for (const auto& writes : writes_) {
+      addrs.insert(writes.front().addr);
+    }
+
+    std::size_t num_ordered = 0;
+    for (const auto& e : on.get()) {
+      if (addrs.count(e.addr) != 0) {
+        if (position_.find(e) == position_.end()) {
+          return false;
+        }
+
+        ++num_ordered;
+      }
+    }
+
+    return num_ordered == position_.size();
+  }
+
+  /**
+   * @return Writes per address, in coherence order.
+   */
+  const std::vector<Writes>& writes() const { return writes_; }
+
+  /**
+   * @return true if w1 is coherence-before w2.
+   */
+  bool R(const Event& w1, const Event& w2) const {
+    const auto p1 = position_.find(w1);
+    if (p1 == position_.end()) {
+      return false;
+    }
+
+    const auto p2 = position_.find(w2);
+    return p2 != position_.end() && p1->second.addr == p2->second.addr &&
+           p1->second.pos < p2->second.pos;
+  }
+
+  /**
+   * @return Writes coherence-after w.
+   */
+  EventRange Reachable(const Event& w) const {
+    const auto p = position_.find(w);
+    if (p == position_.end()) {
+      return EventRange();
+    }
+
+    const Writes& writes = writes_[p->second.addr];
+    return EventRange(writes.begin() + p->second.pos + 1, writes.end());
+  }
+
+  /**
+   * @return fr = rf^-1 ; co, with tuples filtered as in
+   *         cats::ExecWitness::fr().
+   */
+  template <class FilterFunc>
+  EventRel Fr(const EventRel& rf, FilterFunc filter_func) const {
+    EventRel er;
+
+    for (const auto& rf_tuples : rf.get()) {
+      for (const auto& co_w : Reachable(rf_tuples.first)) {
+        for (const auto& rf_r : rf_tuples.second.get()) {
+          if (filter_func(std::make_pair(rf_tuples.first, rf_r),
+                          std::make_pair(rf_tuples.first, co_w))) {
+            er.Insert(rf_r, co_w);
+          }
+        }
+      }
+    }
+
+    return er;
+  }
+
+  /**
+   * Derives fr = rf^-1 ; co, split into internal (same thread) and external
+   * tuples in a single pass.
+   */
+  void Fr(const EventRel& rf, EventRel* fri, EventRel* fre) const {
+    for (const auto& rf_tuples : rf.get()) {
+      for (const auto& co_w : Reachable(rf_tuples.first)) {
+        for (const auto& rf_r : rf_tuples.second.get()) {
+          (rf_r.iiid.pid == co_w.iiid.pid ? fri : fre)->Insert(rf_r, co_w);
+        }
+      }
+    }
+  }
+
+ private:
+  struct Position {
+    std::size_t addr;  // index into writes_
+    std::size_t pos;
+  };
+
+  std::vector<Writes> writes_;
+  EventTypes::MapContainer<Position> position_;
+  bool valid_;
+};
+
+/**
+ * Tests if a graph is acyclic, with a topological sort in time linear in the
+ * number of nodes and edges.
+ *
+ * @param num_nodes Nodes are numbered [0, num_nodes).
+ * @param edges Edges (n1, n2) from node n1 to n2.
+ */
+template <class Idx>
+inline bool EdgesAcyclic(std::size_t num_nodes,
+                         const std::vector<std::pair<Idx, Idx>>& edges) {
+  // Adjacency in compressed form: successors of node n are
+  // succs[offsets[n]..offsets[n+1]).
+  std::vector<std::size_t> offsets(num_nodes + 1, 0);
+  std::vector<std::size_t> in_degree(num_nodes, 0);
+  for (const auto& edge : edges) {
+    ++offsets[edge.first + 1];
+    ++in_degree[edge.second];
+  }
+
+  for (std::size_t n = 0; n < num_nodes; ++n) {
+    offsets[n + 1] += offsets[n];
+  }
+
+  std::vector<Idx> succs(edges.size());
+  std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+  for (const auto& edge : edges) {
+    succs[fill[edge.first]++] = edge.second;
+  }
+
+  std::vector<Idx> ready;
+  for (std::size_t n = 0; n < num_nodes; ++n) {
+    if (in_degree[n] == 0) {
+      ready.push_back(static_cast<Idx>(n));
+    }
+  }
+
+  std::size_t num_sorted = 0;
+  while (!ready.empty()) {
+    const Idx n = ready.back();
+    ready.pop_back();
+    ++num_sorted;
+
+    for (std::size_t i = offsets[n]; i < offsets[n + 1]; ++i) {
+      if (--in_degree[succs[i]] == 0) {
+        ready.push_back(succs[i]);
+      }
+    }
+  }
+
+  return num_sorted == num_nodes;
+}
+
+/**
+ * Tests if po ∪ rf ∪ co ∪ fr is acyclic, i.e. if the execution is
+ * sequentially consistent, with a single topological sort in time linear in
+ * the number of tuples of po and rf, and the number of writes in co. fr is
+ * represented by edges from each read to the immediate coherence-successor
+ * of the write it reads from only, as the remaining tuples of fr follow by
+ * transitivity of co.
+ *
+ * @param po Program order; only its tuples are considered, which does not
+ *           change acyclicity of the transitive closure.
+ * @param co Coherence order; if not valid(), the test is inconclusive.
+ * @return true if acyclic; false if cyclic, or the test is inconclusive.
+ */
+inline bool ScAcyclic(const EventRel& po, const EventRel& rf,
+                      const CoherenceOrder& co) {
+  if (!co.valid() || po.any_props(EventRel::kReflexiveClosure) ||
+      rf.any_props(EventRel::kReflexiveClosure)) {
+    return false;
+  }
+
+  sets::Interner<Event, Event::Hash, EventIdx> index;
+  std::vector<std::pair<EventIdx, EventIdx>> edges;
+  const auto add_edge = [&index, &edges](const Event& e1, const Event& e2) {
+    edges.emplace_back(index.Insert(e1), index.Insert(e2));
+  };
+
+  for (const auto& tuples : po.get()) {
+    for (const auto& e : tuples.second.get()) {
+      add_edge(tuples.first, e);
+    }
+  }
+
+  for (const auto& tuples : rf.get()) {
+    const auto co_succ = co.Reachable(tuples.first);
+    for (const auto& r : tuples.second.get()) {
+      add_edge(tuples.first, r);
+
+      if (!co_succ.empty()) {
+        add_edge(r, *co_succ.begin());
+      }
+    }
+  }
+
+  for (const auto& writes : co.writes()) {
+    for (std::size_t i = 1; i < writes.size(); ++i) {
+      add_edge(writes[i - 1], writes[i]);
+    }
+  }
+
+  return EdgesAcyclic(index.size(), edges);
+}
+
+/**
+ * Tests if ppo | fences | rfe | co | fr of TSO is acyclic, where ppo is po
+ * without write-read tuples, and fences is postar ; mfence ; postar as in
+ * cats::Arch_TSO (and ab of model12::Arch_TSO).
+ *
+ * Rather than materialising ppo and fences (quadratic in the length of each
+ * chain of po), each position i of a chain gets auxiliary nodes: A_i and B_i
+ * lead to all later events, and to all later events which are not reads,
+ * respectively; if mfence is not empty, E_i leads to all later reads, and
+ * C_i and D_i are reached from all earlier events, and all earlier writes,
+ * respectively. A write at position i then leads to B_i, any other event to
+ * A_i; each tuple of mfence gets a node, which is reached from the tuple's
+ * first event and its applicable C or D node, and which leads to the tuple's
+ * second event and its applicable A or E node. Events are related in this
+ * graph iff they are in the relation, s.t. a single topological sort in time
+ * linear in the number of events of po, and the tuples of rf and mfence,
+ * suffices. co and fr are represented as in ScAcyclic.
+ *
+ * @param po Program order; if not valid(), the test is inconclusive.
+ * @param co Coherence order; if not valid(), the test is inconclusive.
+ * @param mfence Tuples of events separated by a full fence; if it has any
+ *               properties, the test is inconclusive.
+ * @return true if acyclic; false if cyclic, or the test is inconclusive.
+ */
+inline bool TsoAcyclic(const ProgramOrder& po, const EventRel& rf,
+                       const CoherenceOrder& co, const EventRel& mfence) {
+  if (!po.valid() || !co.valid() ||
+      rf.any_props(EventRel::kReflexiveClosure) ||
+      mfence.props() != EventRel::kNone) {
+    return false;
+  }
+
+  const auto is_read = [](const Event& e) { return e.AllType(Event::kRead); };
+  const auto is_write = [](const Event& e) {
+    return e.AllType(Event::kWrite);
+  };
+
+  // Index all events first, s.t. auxiliary nodes can be numbered after them.
+  sets::Interner<Event, Event::Hash, EventIdx> index;
+  for (const auto& chain : po.chains()) {
+    for (const auto& e : chain) {
+      index.Insert(e);
+    }
+  }
+
+  mfence.for_each([&index](const Event& e1, const Event& e2) {
+    index.Insert(e1);
+    index.Insert(e2);
+  });
+
+  rf.for_each([&index](const Event& e1, const Event& e2) {
+    index.Insert(e1);
+    index.Insert(e2);
+  });
+
+  for (const auto& writes : co.writes()) {
+    for (const auto& w : writes) {
+      index.Insert(w);
+    }
+  }
+
+  // Auxiliary nodes of position i are aux_of[e_i] + {0: A, 1: B, 2: C, 3: D,
+  // 4: E}.
+  const std::size_t kNoAux = static_cast<std::size_t>(-1);
+  const std::size_t stride = mfence.empty() ? 2 : 5;
+  std::vector<std::size_t> aux_of(index.size(), kNoAux);
+  std::size_t num_nodes = index.size();
+  std::vector<std::pair<std::size_t, std::size_t>> edges;
+
+  for (const auto& chain : po.chains()) {
+    for (std::size_t i = 0; i < chain.size(); ++i) {
+      const std::size_t n = index.Find(chain[i]);
+      const std::size_t aux = num_nodes;
+      aux_of[n] = aux;
+      num_nodes += stride;
+
+      edges.emplace_back(n, is_write(chain[i]) ? aux + 1 : aux);
+
+      if (i + 1 == chain.size()) {
+        break;
+      }
+
+      const std::size_t next = index.Find(chain[i + 1]);
+      const std::size_t next_aux = aux + stride;
+
+      edges.emplace_back(aux, next);
+      edges.emplace_back(aux, next_aux);
+      if (!is_read(chain[i + 1])) {
+        edges.emplace_back(aux + 1, next);
+      }
+      edges.emplace_back(aux + 1, next_aux + 1);
+
+      if (stride > 2) {
+        edges.emplace_back(n, next_aux + 2);
+        edges.emplace_back(aux + 2, next_aux + 2);
+        if (is_write(chain[i])) {
+          edges.emplace_back(n, next_aux + 3);
+        }
+        edges.emplace_back(aux + 3, next_aux + 3);
+        if (is_read(chain[i + 1])) {
+          edges.emplace_back(aux + 4, next);
+        }
+        edges.emplace_back(aux + 4, next_aux + 4);
+      }
+    }
+  }
+
+  mfence.for_each([&](const Event& e1, const Event& e2) {
+    const std::size_t m1 = index.Find(e1);
+    const std::size_t m2 = index.Find(e2);
+    const std::size_t fence = num_nodes++;
+
+    edges.emplace_back(m1, fence);
+    if (aux_of[m1] != kNoAux) {
+      edges.emplace_back(aux_of[m1] + (is_read(e1) ? 2 : 3), fence);
+    }
+
+    edges.emplace_back(fence, m2);
+    if (aux_of[m2] != kNoAux) {
+      edges.emplace_back(fence, aux_of[m2] + (is_write(e2) ? 0 : 4));
+    }
+  });
+
+  for (const auto& tuples : rf.get()) {
+    const std::size_t w = index.Find(tuples.first);
+    const auto co_succ = co.Reachable(tuples.first);
+    for (const auto& r : tuples.second.get()) {
+      if (tuples.first.iiid.pid != r.iiid.pid) {
+        edges.emplace_back(w, index.Find(r));
+      }
+
+      if (!co_succ.empty()) {
+        edges.emplace_back(index.Find(r), index.Find(*co_succ.begin()));
+      }
+    }
+  }
+
+  for (const auto& writes : co.writes()) {
+    for (std::size_t i = 1; i < writes.size(); ++i) {
+      edges.emplace_back(index.Find(writes[i - 1]), index.Find(writes[i]));
+    }
+  }
+
+  return EdgesAcyclic(num_nodes, edges);
+}
+
+/**
+ * Partitions the tuples of er by address.
+ *
+ * @param parts Output; one relation per address, with the properties of er,
+ *              in order of first occurrence in er.
+ * @return true if every tuple relates events of the same address; false
+ *         otherwise, in which case parts is unspecified.
+ */
+inline bool PartitionByAddr(const EventRel& er, std::vector<EventRel>* parts) {
+  std::unordered_map<types::Addr, std::size_t> part_of;
+
+  for (const auto& tuples : er.get()) {
+    const types::Addr addr = tuples.first.addr;
+    auto part = part_of.find(addr);
+    if (part == part_of.end()) {
+      part = part_of.emplace(addr, parts->size()).first;
+      parts->emplace_back();
+      parts->back().set_props(er.props());
+    }
+
+    for (const auto& e : tuples.second.get()) {
+      if (e.addr != addr) {
+        return false;
+      }
+
+      (*parts)[part->second].Insert(tuples.first, e);
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Tests if er is acyclic, where er relates events of the same address only
+ * (e.g. com | po-loc): the relation is partitioned by address, and each
+ * partition is tested independently, optionally in parallel. Falls back to
+ * testing er as a whole if any of its tuples crosses addresses.
+ *
+ * @param pool Optional; if provided, partitions are tested concurrently.
+ * @param cyclic Optional; if result is false, a cycle [e, ..., e], of the
+ *               first cyclic partition.
+ * @return true if acyclic, false otherwise.
+ */
+inline bool PerLocationAcyclic(const EventRel& er,
+                               parallel::ThreadPool* pool = nullptr,
+                               EventRel::Path* cyclic = nullptr) {
+  std::vector<EventRel> parts;
+  if (!PartitionByAddr(er, &parts)) {
+    return er.Acyclic(cyclic);
+  }
+
+  if (pool == nullptr || parts.size() < 2) {
+    for (const auto& part : parts) {
+      if (!part.Acyclic(cyclic)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // Partitions are not modified while tested, but Acyclic may populate
+  // their caches: each partition is only accessed by one thread.
+  std::vector<char> acyclic(parts.size(), 1);
+  std::vector<EventRel::Path> cycles(cyclic != nullptr ? parts.size() : 0);
+  const auto table = EventTable::Current();
+  parallel::ForEach(pool, parts.size(), [&](std::size_t i) {
+    const EventTableScope table_scope(table);
+    acyclic[i] = parts[i].Acyclic(cyclic != nullptr ? &cycles[i] : nullptr);
+  });
+
+  for (std::size_t i = 0; i < parts.size(); ++i) {
+    if (!acyclic[i]) {
+      if (cyclic != nullptr) {
+        cyclic->insert(cyclic->end(), cycles[i].begin(), cycles[i].end());
+      }
+
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief 128-bit fingerprint, e.g. of an execution.
+ */
+struct Fingerprint {
+  struct Hash {
+    std::size_t operator()(const Fingerprint& k) const {
+      return static_cast<std::size_t>(k.lo ^ (k.hi * 0x9e3779b97f4a7c15ULL));
+    }
+  };
+
+  Fingerprint() : hi(0), lo(0) {}
+
+  Fingerprint(std::uint64_t hi_, std::uint64_t lo_) : hi(hi_), lo(lo_) {}
+
+  bool operator==(const Fingerprint& rhs) const {
+    return hi == rhs.hi && lo == rhs.lo;
+  }
+
+  bool operator!=(const Fingerprint& rhs) const { return !(*this == rhs); }
+
+  std::uint64_t hi;
+  std::uint64_t lo;
+};
+
+/**
+ * @brief Computes canonical Fingerprints of sequences of event sets and
+ * relations.
+ *
+ * A set or relation is fingerprinted as the sum of two independent 64-bit
+ * hashes of each of its elements or tuples; sums are commutative, s.t. the
+ * fingerprint does not depend on the order in which containers are iterated.
+ * The fingerprints of successive components are combined in order.
+ */
+class FingerprintBuilder {
+ public:
+  FingerprintBuilder() : hi_(kSeedHi), lo_(kSeedLo) {}
+
+  FingerprintBuilder& Add(const EventSet& es) {
+    std::uint64_t hi = 0;
+    std::uint64_t lo = 0;
+
+    for (const auto& e : es.get()) {
+      const std::uint64_t h = Hash(e);
+      hi += Mix(h ^ kSeedHi);
+      lo += Mix(h ^ kSeedLo);
+    }
+
+    return Combine(hi, lo, es.size());
+  }
+
+  /**
+   * Adds the tuples of er as given, and its properties; i.e. a relation and
+   * its explicit closure have different fingerprints.
+   */
+  FingerprintBuilder& Add(const EventRel& er) {
+    std::uint64_t hi = 0;
+    std::uint64_t lo = 0;
+    std::size_t size = 0;
+
+    for (const auto& tuples : er.get()) {
+      const std::uint64_t h1 = Hash(tuples.first);
+      for (const auto& e2 : tuples.second.get()) {
+        const std::uint64_t h = Mix(h1 ^ Mix(Hash(e2) + kSeedTuple));
+        hi += Mix(h ^ kSeedHi);
+        lo += Mix(h ^ kSeedLo);
+        ++size;
+      }
+    }
+
+    Combine(hi, lo, size);
+    return Combine(er.props(), 0, 0);
+  }
+
+  FingerprintBuilder& Add(std::uint64_t val) {
+    return Combine(Mix(val ^ kSeedHi), Mix(val ^ kSeedLo), 0);
+  }
+
+  Fingerprint Get() const { return Fingerprint(hi_, lo_); }
+
+ private:
+  static constexpr std::uint64_t kSeedHi = 0x243f6a8885a308d3ULL;
+  static constexpr std::uint64_t kSeedLo = 0x13198a2e03707344ULL;
+  static constexpr std::uint64_t kSeedTuple = 0xa4093822299f31d0ULL;
+
+  /**
+   * Finalizer of SplitMix64.
+   */
+  static std::uint64_t Mix(std::uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  static std::uint64_t Hash(const Event& e) {
+    std::uint64_t h = Mix(static_cast<std::uint64_t>(e.addr));
+    h = Mix(h ^ static_cast<std::uint64_t>(e.type));
+    h = Mix(h ^ static_cast<std::uint64_t>(e.iiid.pid));
+    return Mix(h ^ static_cast<std::uint64_t>(e.iiid.poi));
+  }
+
+  FingerprintBuilder& Combine(std::uint64_t hi, std::uint64_t lo,
+                              std::size_t size) {
+    hi_ = Mix(hi_ ^ hi) + size;
+    lo_ = Mix(lo_ ^ lo ^ hi_);
+    return *this;
+  }
+
+  std::uint64_t hi_;
+  std::uint64_t lo_;
+};
 
 class Error : public std::logic_error {
  public:
@@ -236,6 +1296,75 @@ class Error : public std::logic_error {
 #endif
 };
 
+/**
+ * Throws Error(error), unless error is nullptr.
+ */
+inline void ThrowIfError(const char* error) {
+  if (error != nullptr) {
+    throw Error(error);
+  }
+}
+
+/**
+ * @brief Result of checking an execution, as an alternative to Error.
+ *
+ * Error codes are static strings, and the cycle is empty unless an axiom
+ * failed: a valid result does not allocate.
+ */
+struct CheckResult {
+  enum Verdict {
+    kValid,
+    kIllFormed,  // a well-formedness condition failed
+    kInvalid     // an axiom failed
+  };
+
+  CheckResult() : verdict(kValid), failed(nullptr) {}
+
+  bool valid() const { return verdict == kValid; }
+
+  void Clear() {
+    verdict = kValid;
+    failed = nullptr;
+    cycle.clear();
+    cycle_path.clear();
+  }
+
+  /**
+   * Sets cycle_path to path, and cycle to its indices into table; events of
+   * path which are not in table are represented by EventTable::kInvalid.
+   */
+  void SetCycle(const EventTable& table, EventRel::Path path) {
+    cycle.clear();
+    cycle.reserve(path.size());
+    for (const auto& e : path) {
+      cycle.push_back(table.Find(e));
+    }
+
+    cycle_path = std::move(path);
+  }
+
+  Verdict verdict;
+
+  /**
+   * Error code of the failed well-formedness condition or axiom, as would be
+   * thrown as Error; nullptr if valid.
+   */
+  const char* failed;
+
+  /**
+   * Cycle [e, ..., e] of the failed axiom, if any, as indices into the
+   * execution's EventTable.
+   */
+  std::vector<EventIdx> cycle;
+
+  /**
+   * The same cycle as events; complete also where the execution's EventTable
+   * is not (e.g. model12::ExecWitness, or executions not constructed via
+   * codegen).
+   */
+  EventRel::Path cycle_path;
+};
+
 }  // namespace memconsistency
 }  // namespace mc2lib
 
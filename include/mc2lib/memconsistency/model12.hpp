@@ -35,7 +35,10 @@
 #define MC2LIB_MEMCONSISTENCY_MODEL12_HPP_
 
 #include <memory>
+#include <typeinfo>
+#include <utility>
 
+#include "../parallel.hpp"
 #include "eventsets.hpp"
 
 namespace mc2lib {
@@ -57,6 +60,11 @@ class ExecWitness {
  public:
   template <class FilterFunc>
   EventRel fr(FilterFunc filter_func) const {
+    const CoherenceOrder coherence_order(ws);
+    if (coherence_order.valid()) {
+      return coherence_order.Fr(rf, filter_func);
+    }
+
     EventRel er;
 
     for (const auto& rf_tuples : rf.get()) {
@@ -92,6 +100,21 @@ class ExecWitness {
     });
   }
 
+  /**
+   * Obtains both fri and fre in a single pass.
+   */
+  void FrPartition(EventRel* fri, EventRel* fre) const {
+    const CoherenceOrder coherence_order(ws);
+    if (coherence_order.valid()) {
+      *fri = EventRel();
+      *fre = EventRel();
+      coherence_order.Fr(rf, fri, fre);
+    } else {
+      *fri = this->fri();
+      *fre = this->fre();
+    }
+  }
+
   EventRel rfi() const {
     return rf.Filter([](const Event& e1, const Event& e2) {
       return e1.iiid.pid == e2.iiid.pid;
@@ -118,25 +141,66 @@ class ExecWitness {
 
   EventRel com() const { return rf | ws | fr(); }
 
+  /**
+   * @return po as ProgramOrder; not valid() if po is not a transitive
+   *         closure of chains (as set up by event producers), in which case
+   *         callers must fall back to using po.
+   */
+  ProgramOrder program_order() const {
+    if (!po.all_props(EventRel::kTransitiveClosure)) {
+      return ProgramOrder::Invalid();
+    }
+
+    return ProgramOrder(po);
+  }
+
   EventRel po_loc() const {
+    const ProgramOrder program_order = this->program_order();
+    if (program_order.valid()) {
+      // Same relation, without materialising the closure of po.
+      return program_order.Partition([](const Event& e) { return e.addr; })
+          .Chains();
+    }
+
     return po.Filter(
         [](const Event& e1, const Event& e2) { return e1.addr == e2.addr; });
   }
 
+  /**
+   * Clears all events and relations, and releases arena; any relations
+   * derived from this execution must no longer be used.
+   */
   void Clear() {
-    events.Clear();
-    po.Clear();
-    dp.Clear();
-    rf.Clear();
-    ws.Clear();
+    // Reset rather than clear containers, as they may hold memory allocated
+    // from arena (e.g. bucket arrays).
+    events = EventSet();
+    po = EventRel();
+    dp = EventRel();
+    rf = EventRel();
+    ws = EventRel();
+    table.Clear();
+    arena.Release();
   }
 
  public:
+  /**
+   * Arena for intermediate relations of checks (see Checker::valid_exec);
+   * released by Clear(). Declared first, as other members may hold memory
+   * allocated from it.
+   */
+  mutable sets::Arena arena;
+
   EventSet events;
   EventRel po;
   EventRel dp;
   EventRel rf;
   EventRel ws;
+
+  /**
+   * Dense indices of events; filled by the event producer (e.g.
+   * codegen::EvtStateCats), and not necessarily complete otherwise.
+   */
+  EventTable table;
 };
 
 class Checker;
@@ -175,33 +239,63 @@ class Architecture {
 class Checker {
  public:
   Checker(const Architecture* arch, const ExecWitness* exec)
-      : arch_(arch), exec_(exec) {}
+      : arch_(arch), exec_(exec), pool_(nullptr) {}
 
   virtual ~Checker() {}
 
-  virtual void wf_rf() const {
+  /**
+   * Sets the pool on which independent parts of individual axioms are
+   * evaluated; nullptr (default) evaluates them in the calling thread. The
+   * pool must outlive any checks.
+   */
+  void set_pool(parallel::ThreadPool* pool) { pool_ = pool; }
+
+  parallel::ThreadPool* pool() const { return pool_; }
+
+  /**
+   * @return Error code of the first violated well-formedness condition of
+   *         rf, as thrown by wf_rf(); nullptr if well-formed.
+   */
+  virtual const char* wf_rf_error() const {
     EventSet reads;
 
     for (const auto& tuples : exec_->rf.get()) {
       if (!tuples.first.AnyType(arch_->EventTypeWrite())) {
-        throw Error("WF_RF_NOT_FROM_WRITE");
+        return "WF_RF_NOT_FROM_WRITE";
       }
 
       for (const auto& e : tuples.second.get()) {
         if (!e.AnyType(arch_->EventTypeRead()) || tuples.first.addr != e.addr) {
-          throw Error("WF_RF_NOT_SAME_LOC");
+          return "WF_RF_NOT_SAME_LOC";
         }
 
         // For every read, there exists only 1 source!
         if (reads.Contains(e)) {
-          throw Error("WF_RF_MULTI_SOURCE");
+          return "WF_RF_MULTI_SOURCE";
         }
         reads.Insert(e);
       }
     }
+
+    return nullptr;
   }
 
-  virtual void wf_ws() const {
+  virtual void wf_rf() const { ThrowIfError(wf_rf_error()); }
+
+  /**
+   * @return Error code of the first violated well-formedness condition of
+   *         ws, as thrown by wf_ws(); nullptr if well-formed.
+   */
+  virtual const char* wf_ws_error() const {
+    auto writes = exec_->events.Filter(
+        [&](const Event& e) { return e.AnyType(arch_->EventTypeWrite()); });
+
+    // Fast path: a per-address topological sort, in linear time; otherwise,
+    // the checks below determine the error.
+    if (CoherenceOrder(exec_->ws).StrictTotalOrderPerAddr(writes)) {
+      return nullptr;
+    }
+
     std::unordered_set<types::Addr> addrs;
 
     // Assert writes ordered captured in ws are to the same location.
@@ -210,33 +304,45 @@ class Checker {
 
       for (const auto& e : tuples.second.get()) {
         if (tuples.first.addr != e.addr) {
-          throw Error("WF_WS_NOT_SAME_LOC");
+          return "WF_WS_NOT_SAME_LOC";
         }
       }
     }
 
-    auto writes = exec_->events.Filter(
-        [&](const Event& e) { return e.AnyType(arch_->EventTypeWrite()); });
     if (!exec_->ws.StrictPartialOrder(writes)) {
-      throw Error("WF_WS_NOT_STRICT_PARTIAL_ORDER");
+      return "WF_WS_NOT_STRICT_PARTIAL_ORDER";
     }
 
     for (const auto& addr : addrs) {
       auto same_addr_writes =
           writes.Filter([&](const Event& e) { return e.addr == addr; });
       if (!exec_->ws.ConnexOn(same_addr_writes)) {
-        throw Error("WF_WS_NOT_CONNEX");
+        return "WF_WS_NOT_CONNEX";
       }
     }
+
+    return nullptr;
   }
 
-  virtual void wf() const {
-    wf_rf();
-    wf_ws();
+  virtual void wf_ws() const { ThrowIfError(wf_ws_error()); }
+
+  virtual const char* wf_error() const {
+    const char* error = wf_rf_error();
+    return error != nullptr ? error : wf_ws_error();
   }
 
+  virtual void wf() const { ThrowIfError(wf_error()); }
+
+  /**
+   * All tuples of com and po_loc relate events of the same address; each
+   * address is therefore checked independently (see PerLocationAcyclic), on
+   * pool() if set.
+   */
   virtual bool uniproc(EventRel::Path* cyclic = nullptr) const {
-    return (exec_->com() | exec_->po_loc()).Acyclic(cyclic);
+    // Cycles do not depend on the closure of po_loc: avoid evaluating it.
+    EventRel po_loc = exec_->po_loc();
+    po_loc.unset_props(EventRel::kTransitiveClosure);
+    return PerLocationAcyclic(exec_->com() | po_loc, pool_, cyclic);
   }
 
   virtual bool thin(EventRel::Path* cyclic = nullptr) const {
@@ -247,25 +353,83 @@ class Checker {
     return arch_->ghb(*exec_).Acyclic(cyclic);
   }
 
-  virtual void valid_exec(EventRel::Path* cyclic = nullptr) const {
-    wf();
+  /**
+   * Sufficient condition for a well-formed execution to be valid: if
+   * po | rf | ws | fr is acyclic, the execution is sequentially consistent,
+   * and therefore valid on any architecture (whose relations are included in
+   * the former's transitive closure). Linear time, and does not compute any
+   * architecture relations.
+   */
+  virtual bool sc_acyclic() const {
+    return ScAcyclic(exec_->po, exec_->rf, CoherenceOrder(exec_->ws));
+  }
+
+  /**
+   * Checks the axioms of a well-formed execution, in order.
+   *
+   * @param cyclic Optional; if an axiom fails, its cycle.
+   * @return Error code of the first failed axiom, as thrown by valid_exec;
+   *         nullptr if the execution is valid.
+   */
+  virtual const char* failed_axiom(EventRel::Path* cyclic = nullptr) const {
+    // Fast path: most executions are sequentially consistent.
+    if (sc_acyclic()) {
+      return nullptr;
+    }
 
     if (!uniproc(cyclic)) {
-      throw Error("UNIPROC");
+      return "UNIPROC";
     }
 
     if (!thin(cyclic)) {
-      throw Error("THIN");
+      return "THIN";
     }
 
     if (!check_exec(cyclic)) {
-      throw Error("CHECK_EXEC");
+      return "CHECK_EXEC";
+    }
+
+    return nullptr;
+  }
+
+  virtual void valid_exec(EventRel::Path* cyclic = nullptr) const {
+    // Intermediate relations are allocated from the execution's arena, if
+    // EventRel's allocator supports it (see MC2LIB_ARENA_EVENTSETS).
+    const sets::ArenaScope arena_scope(&exec_->arena);
+
+    wf();
+    ThrowIfError(failed_axiom(cyclic));
+  }
+
+  /**
+   * As valid_exec, but returns the result instead of throwing; see
+   * CheckResult. Evaluates wf_error() and failed_axiom(), which subclasses
+   * overriding the throwing variants must override accordingly.
+   */
+  CheckResult check() const {
+    const sets::ArenaScope arena_scope(&exec_->arena);
+    CheckResult result;
+
+    result.failed = wf_error();
+    if (result.failed != nullptr) {
+      result.verdict = CheckResult::kIllFormed;
+      return result;
     }
+
+    EventRel::Path cyclic;  // does not allocate unless an axiom fails
+    result.failed = failed_axiom(&cyclic);
+    if (result.failed != nullptr) {
+      result.verdict = CheckResult::kInvalid;
+      result.SetCycle(exec_->table, std::move(cyclic));
+    }
+
+    return result;
   }
 
  protected:
   const Architecture* arch_;
   const ExecWitness* exec_;
+  parallel::ThreadPool* pool_;
 };
 
 /*
@@ -283,6 +447,12 @@ class Arch_SC : public Architecture {
 
   EventRel ppo(const ExecWitness& ew) const override {
     assert(ew.po.Transitive());
+
+    const ProgramOrder program_order = ew.program_order();
+    if (program_order.valid()) {
+      return program_order.Chains();
+    }
+
     return ew.po.Eval();
   }
 
@@ -295,20 +465,91 @@ class Arch_SC : public Architecture {
   Event::Type EventTypeWrite() const override { return Event::kWrite; }
 };
 
+/**
+ * @brief Checker specialised for Arch_TSO.
+ *
+ * UNIPROC (acyclic com | po-loc) and CHECK_EXEC (acyclic ghb) are tested with
+ * a topological sort each (see ScAcyclic and TsoAcyclic), in time linear in
+ * the size of the execution, and without evaluating any architecture
+ * relations. Only if either test (or THIN) fails, or a test is inconclusive,
+ * are the axioms checked by Checker, to determine the failed axiom and its
+ * cycle; i.e. results are the same.
+ */
+class TsoChecker : public Checker {
+ public:
+  /**
+   * @param mfence Arch_TSO::mfence, which must outlive the checker.
+   */
+  TsoChecker(const Architecture* arch, const ExecWitness* exec,
+             const EventRel* mfence)
+      : Checker(arch, exec), mfence_(mfence) {}
+
+  /**
+   * Sufficient condition for a well-formed execution to satisfy UNIPROC and
+   * CHECK_EXEC on TSO.
+   */
+  bool tso_acyclic() const {
+    const ProgramOrder program_order = exec_->program_order();
+    if (!program_order.valid()) {
+      return false;
+    }
+
+    const CoherenceOrder coherence_order(exec_->ws);
+    return ScAcyclic(
+               program_order.Partition([](const Event& e) { return e.addr; })
+                   .Chains(),
+               exec_->rf, coherence_order) &&
+           TsoAcyclic(program_order, exec_->rf, coherence_order, *mfence_);
+  }
+
+  const char* failed_axiom(EventRel::Path* cyclic = nullptr) const override {
+    if (thin() && tso_acyclic()) {
+      return nullptr;
+    }
+
+    return Checker::failed_axiom(cyclic);
+  }
+
+ private:
+  const EventRel* mfence_;
+};
+
 class Arch_TSO : public Architecture {
  public:
+  Arch_TSO() : linear_checker_(true) {}
+
   void Clear() override { mfence.Clear(); }
 
+  /**
+   * @return TsoChecker, unless disabled via set_linear_checker(false), or
+   *         this is a subclass: TsoChecker assumes this class' relations.
+   */
   std::unique_ptr<Checker> MakeChecker(const Architecture* arch,
                                        const ExecWitness* exec) const override {
+    if (linear_checker_ && typeid(*this) == typeid(Arch_TSO)) {
+      return std::unique_ptr<Checker>(new TsoChecker(arch, exec, &mfence));
+    }
+
     return std::unique_ptr<Checker>(new Checker(arch, exec));
   }
 
+  void set_linear_checker(bool val) { linear_checker_ = val; }
+
+  bool linear_checker() const { return linear_checker_; }
+
   EventRel ppo(const ExecWitness& ew) const override {
     assert(ew.po.Transitive());
-    return ew.po.Filter([](const Event& e1, const Event& e2) {
+
+    const auto not_wr = [](const Event& e1, const Event& e2) {
       return !e1.AllType(Event::kWrite) || !e2.AllType(Event::kRead);
-    });
+    };
+
+    const ProgramOrder program_order = ew.program_order();
+    if (program_order.valid()) {
+      return program_order.Filter(not_wr);
+    }
+
+    return ew.po.Filter(not_wr);
   }
 
   EventRel grf(const ExecWitness& ew) const override { return ew.rfe(); }
@@ -319,14 +560,16 @@ class Arch_TSO : public Architecture {
     }
 
     // Filter postar by only those events which are possibly relevent.
-    const auto postar =
-        ew.po
-            .Filter([&](const Event& e1, const Event& e2) {
-              // Only include those where first event is write or second
-              // is a read, all other are included in po regardless.
-              return e1.AllType(Event::kWrite) || e2.AllType(Event::kRead);
-            })
-            .set_props(EventRel::kReflexiveClosure);
+    const auto relevant = [](const Event& e1, const Event& e2) {
+      // Only include those where first event is write or second is a read,
+      // all other are included in po regardless.
+      return e1.AllType(Event::kWrite) || e2.AllType(Event::kRead);
+    };
+
+    const ProgramOrder program_order = ew.program_order();
+    auto postar = program_order.valid() ? program_order.Filter(relevant)
+                                        : ew.po.Filter(relevant);
+    postar.set_props(EventRel::kReflexiveClosure);
 
     return EventRelSeq({postar, mfence, postar}).EvalClear();
   }
@@ -337,6 +580,9 @@ class Arch_TSO : public Architecture {
 
  public:
   EventRel mfence;
+
+ private:
+  bool linear_checker_;
 };
 
 }  // namespace model12
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2014-2016, Marco Elver
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the
+ *    distribution.
+ *
+ *  * Neither the name of the software nor the names of its contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MC2LIB_PARALLEL_HPP_
+#define MC2LIB_PARALLEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifndef MC2LIB_THREAD_LOCAL
+// See sets.hpp.
+#if defined(__GNUC__) && !defined(__clang__) && \
+    (__GNUC__ < 4 || (__GNUC__ == 4 && __GNUC_MINOR__ < 8))
+#define MC2LIB_THREAD_LOCAL __thread
+#else
+#define MC2LIB_THREAD_LOCAL thread_local
+#endif
+#endif
+
+namespace mc2lib {
+
+/**
+ * @namespace mc2lib::parallel
+ * @brief Helpers for concurrent evaluation.
+ */
+namespace parallel {
+
+/**
+ * @brief Fixed-size pool of worker threads, with work stealing.
+ *
+ * Every worker has its own queue of tasks. Tasks submitted by a worker are
+ * added to its own queue, other tasks are distributed round-robin. Workers
+ * take tasks from the back of their own queue first (most recently
+ * submitted, as their data is likely still cached), and otherwise steal from
+ * the front of the other workers' queues, s.t. uneven work is balanced.
+ *
+ * The destructor waits for all submitted tasks to complete. Tasks must not
+ * block waiting for other tasks of the same pool, as all workers may be
+ * waiting.
+ */
+class ThreadPool {
+ public:
+  /**
+   * @param num_threads Number of worker threads; at least 1.
+   */
+  explicit ThreadPool(std::size_t num_threads = DefaultSize())
+      : pending_(0), stop_(false), next_queue_(0) {
+    if (num_threads == 0) {
+      num_threads = 1;
+    }
+
+    queues_.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; ++i) {
+      queues_.emplace_back(new Queue());
+    }
+
+    workers_.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; ++i) {
+      workers_.emplace_back([this, i]() { Run(i); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+
+    cv_.notify_all();
+
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * @return Number of hardware threads, or 2 if unknown.
+   */
+  static std::size_t DefaultSize() {
+    const std::size_t result = std::thread::hardware_concurrency();
+    return result != 0 ? result : 2;
+  }
+
+  std::size_t size() const { return workers_.size(); }
+
+  /**
+   * Submits func for execution by a worker.
+   *
+   * @return Future of func's result; exceptions thrown by func are stored
+   *         in the future.
+   */
+  template <class Func>
+  std::future<typename std::result_of<Func()>::type> Submit(Func func) {
+    typedef typename std::result_of<Func()>::type Result;
+
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+    std::future<Result> result = task->get_future();
+
+    const Worker& worker = CurrentWorker();
+    Queue& queue = *queues_[worker.pool == this
+                                ? worker.idx
+                                : next_queue_.fetch_add(1) % queues_.size()];
+    {
+      // Count the task while it is published: workers decrement pending_
+      // (under mutex_) only after taking a task, i.e. never before this.
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::lock_guard<std::mutex> queue_lock(queue.mutex);
+      queue.tasks.emplace_back([task]() { (*task)(); });
+      ++pending_;
+    }
+
+    cv_.notify_one();
+    return result;
+  }
+
+ private:
+  typedef std::function<void()> Task;
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  struct Worker {
+    const ThreadPool* pool;
+    std::size_t idx;
+  };
+
+  static Worker& CurrentWorker() {
+    static MC2LIB_THREAD_LOCAL Worker worker = {nullptr, 0};
+    return worker;
+  }
+
+  /**
+   * Takes a task from the back of queue idx, or else steals one from the
+   * front of another queue.
+   */
+  bool Take(std::size_t idx, Task* task) {
+    for (std::size_t i = 0; i < queues_.size(); ++i) {
+      Queue& queue = *queues_[(idx + i) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+
+      if (!queue.tasks.empty()) {
+        if (i == 0) {
+          *task = std::move(queue.tasks.back());
+          queue.tasks.pop_back();
+        } else {
+          *task = std::move(queue.tasks.front());
+          queue.tasks.pop_front();
+        }
+
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void Run(std::size_t idx) {
+    CurrentWorker() = Worker{this, idx};
+
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stop_ || pending_ != 0; });
+
+        if (pending_ == 0) {
+          return;  // stop_
+        }
+      }
+
+      Task task;
+      if (!Take(idx, &task)) {
+        continue;  // taken by another worker
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --pending_;
+      }
+
+      task();
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::size_t pending_;  // tasks in queues_
+  bool stop_;
+  std::atomic<std::size_t> next_queue_;
+  std::vector<std::thread> workers_;
+};
+
+/**
+ * Calls func(i) for each i in [0, n), concurrently on pool and the calling
+ * thread. Indices are claimed one at a time, s.t. calls of uneven cost are
+ * balanced.
+ *
+ * The caller takes part in the work, and only waits for calls which are
+ * already in progress on other threads; unlike waiting for futures, this is
+ * therefore safe from within a task of pool.
+ *
+ * If any call throws, the first exception caught is rethrown, after all
+ * calls have completed.
+ */
+template <class Func>
+void ForEach(ThreadPool* pool, std::size_t n, Func func) {
+  struct State {
+    State(std::size_t n_, Func func_)
+        : n(n_), func(std::move(func_)), next(0), done(0) {}
+
+    void Run() {
+      for (std::size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+        try {
+          func(i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+
+        if (done.fetch_add(1) + 1 == n) {
+          std::lock_guard<std::mutex> lock(mutex);
+          cv.notify_all();
+        }
+      }
+    }
+
+    const std::size_t n;
+    Func func;
+    std::atomic<std::size_t> next;
+    std::atomic<std::size_t> done;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::exception_ptr error;
+  };
+
+  if (n == 0) {
+    return;
+  }
+
+  // Helper tasks may still start after this returns; they then find no
+  // indices left, and do not call func, which may refer to the caller's stack.
+  auto state = std::make_shared<State>(n, std::move(func));
+
+  const std::size_t num_helpers = std::min(pool->size(), n - 1);
+  for (std::size_t i = 0; i < num_helpers; ++i) {
+    pool->Submit([state]() { state->Run(); });
+  }
+
+  state->Run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cv.wait(lock, [&state]() { return state->done.load() == state->n; });
+
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+}
+
+}  // namespace parallel
+}  // namespace mc2lib
+
+#endif /* MC2LIB_PARALLEL_HPP_ */
+
+/* vim: set ts=2 sts=2 sw=2 et : */
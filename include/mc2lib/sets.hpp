@@ -34,13 +34,41 @@
 #ifndef MC2LIB_SETS_HPP_
 #define MC2LIB_SETS_HPP_
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+// thread_local is only supported from GCC 4.8; GCC 4.7 provides __thread,
+// which suffices for POD types.
+#if defined(__GNUC__) && !defined(__clang__) && \
+    (__GNUC__ < 4 || (__GNUC__ == 4 && __GNUC_MINOR__ < 8))
+#ifndef MC2LIB_THREAD_LOCAL_POD_ONLY
+#define MC2LIB_THREAD_LOCAL_POD_ONLY
+#endif
+#endif
+
+#ifndef MC2LIB_THREAD_LOCAL
+#ifdef MC2LIB_THREAD_LOCAL_POD_ONLY
+#define MC2LIB_THREAD_LOCAL __thread
+#else
+#define MC2LIB_THREAD_LOCAL thread_local
+#endif
+#endif
+
 namespace mc2lib {
 
 /**
@@ -49,6 +77,17 @@ namespace mc2lib {
  */
 namespace sets {
 
+/**
+ * Combines hash value v into seed.
+ *
+ * @param seed Hash value to combine into.
+ * @param v Hash value to combine.
+ * @return Combined hash value.
+ */
+inline std::size_t HashCombine(std::size_t seed, std::size_t v) {
+  return seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
 /**
  * Checks that a bit mask has all given bits set.
  *
@@ -75,6 +114,128 @@ inline bool AnyBitmask(T mask, T any) {
   return (mask & any) != 0;
 }
 
+/**
+ * Bulk operations on set containers, as used by Set. Containers which can do
+ * better than element-wise iteration (e.g. DenseSetContainer) provide
+ * overloads found via ADL.
+ */
+template <class C>
+inline void ContainerUnion(C* lhs, const C& rhs) {
+  lhs->insert(rhs.begin(), rhs.end());
+}
+
+template <class C>
+inline void ContainerDifference(C* lhs, const C& rhs) {
+  // Cannot use erase with iterator, as rhs may contain elements that do not
+  // exist in lhs. In such a case, the erase implementation of current GCC
+  // segfaults.
+  for (const auto& e : rhs) {
+    lhs->erase(e);
+  }
+}
+
+template <class C>
+inline void ContainerIntersection(C* lhs, const C& rhs) {
+  for (auto it = lhs->begin(); it != lhs->end();) {
+    if (rhs.find(*it) == rhs.end()) {
+      it = lhs->erase(it);
+      continue;
+    }
+
+    it++;
+  }
+}
+
+template <class C>
+inline bool ContainerSubsetEq(const C& lhs, const C& rhs) {
+  if (lhs.size() > rhs.size()) return false;
+
+  for (const auto& e : lhs) {
+    if (rhs.find(e) == rhs.end()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Lazily assigned stamp identifying the contents of a Set or Relation.
+ *
+ * Modifications invalidate the stamp; a new stamp is only drawn (from a
+ * process-wide counter) when queried, s.t. modifications remain cheap.
+ * Copies share the stamp, as they share the contents; moved-from objects
+ * are invalidated. Stamps therefore identify the version of the contents,
+ * and can be used to key caches of derived data.
+ */
+class GenerationStamp {
+ public:
+  GenerationStamp() : value_(0) {}
+
+  GenerationStamp(const GenerationStamp&) = default;
+
+  GenerationStamp(GenerationStamp&& rhs) : value_(rhs.value_) {
+    rhs.value_ = 0;
+  }
+
+  GenerationStamp& operator=(const GenerationStamp&) = default;
+
+  GenerationStamp& operator=(GenerationStamp&& rhs) {
+    const std::uint64_t value = rhs.value_;
+    rhs.value_ = 0;
+    value_ = value;
+    return *this;
+  }
+
+  void Invalidate() { value_ = 0; }
+
+  /**
+   * Not thread-safe if the stamp is invalid: only call concurrently on
+   * objects whose stamps have been obtained before.
+   *
+   * @return Non-zero stamp.
+   */
+  std::uint64_t Get() const {
+    if (value_ == 0) {
+      static std::atomic<std::uint64_t> next(1);
+      value_ = next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return value_;
+  }
+
+ private:
+  mutable std::uint64_t value_;
+};
+
+/**
+ * @brief Generation of a group of N objects with a GenerationStamp each.
+ *
+ * The generation changes iff any of the stamps passed to Get() differs from
+ * those of the previous call; like GenerationStamp, generations are unique
+ * across all objects.
+ */
+template <std::size_t N>
+class CompositeGeneration {
+ public:
+  typedef std::array<std::uint64_t, N> Stamps;
+
+  CompositeGeneration() : stamps_() {}
+
+  std::uint64_t Get(const Stamps& stamps) const {
+    if (stamps != stamps_) {
+      stamps_ = stamps;
+      stamp_.Invalidate();
+    }
+
+    return stamp_.Get();
+  }
+
+ private:
+  mutable Stamps stamps_;
+  mutable GenerationStamp stamp_;
+};
+
 /**
  * @brief Abstracts over container library's set implementation.
  *
@@ -87,6 +248,12 @@ class Set {
   typedef typename Ts::Element Element;
   typedef typename Ts::SetContainer Container;
 
+  // const Element& for containers that store elements; may be Element for
+  // containers which compute elements on access (e.g. DenseTypes with
+  // IdentityIndexer).
+  typedef typename std::iterator_traits<
+      typename Container::const_iterator>::reference ConstReference;
+
   Set() {}
 
   explicit Set(Container s) : set_(std::move(s)) {}
@@ -109,7 +276,8 @@ class Set {
    * @param assert_unique Assert that element does not exist in container.
    * @return Reference to inserted Element.
    */
-  const Element& Insert(const Element& e, bool assert_unique = false) {
+  ConstReference Insert(const Element& e, bool assert_unique = false) {
+    generation_.Invalidate();
     auto result = set_.insert(e);
     assert(!assert_unique || result.second);
     return *result.first;
@@ -122,7 +290,8 @@ class Set {
    * @param assert_unique Assert that element does not exist in container.
    * @return Reference to inserted Element.
    */
-  const Element& Insert(Element&& e, bool assert_unique = false) {
+  ConstReference Insert(Element&& e, bool assert_unique = false) {
+    generation_.Invalidate();
     auto result = set_.emplace(std::move(e));
     assert(!assert_unique || result.second);
     return *result.first;
@@ -135,6 +304,7 @@ class Set {
    * @param assert_exists Assert that element exists.
    */
   bool Erase(const Element& e, bool assert_exists = false) {
+    generation_.Invalidate();
     auto result = set_.erase(e);
     assert(!assert_exists || result != 0);
     return result != 0;
@@ -153,7 +323,10 @@ class Set {
     return res;
   }
 
-  void Clear() { set_.clear(); }
+  void Clear() {
+    generation_.Invalidate();
+    set_.clear();
+  }
 
   bool Contains(const Element& e) const { return set_.find(e) != set_.end(); }
 
@@ -162,17 +335,21 @@ class Set {
    */
   Set& operator|=(const Set& rhs) {
     if (this != &rhs) {
-      set_.insert(rhs.set_.begin(), rhs.set_.end());
+      generation_.Invalidate();
+      ContainerUnion(&set_, rhs.set_);
     }
 
     return *this;
   }
 
   Set& operator|=(Set&& rhs) {
+    generation_.Invalidate();
+
     if (empty()) {
       set_ = std::move(rhs.set_);
+      rhs.generation_.Invalidate();
     } else {
-      set_.insert(rhs.set_.begin(), rhs.set_.end());
+      ContainerUnion(&set_, rhs.set_);
     }
 
     return *this;
@@ -185,12 +362,8 @@ class Set {
     if (this == &rhs) {
       Clear();
     } else {
-      // Cannot use set_.erase with iterator, as rhs may contain elements
-      // that do not exist in this set. In such a case, the erase
-      // implementation of current GCC segfaults.
-      for (const auto& e : rhs.get()) {
-        Erase(e);
-      }
+      generation_.Invalidate();
+      ContainerDifference(&set_, rhs.set_);
     }
 
     return *this;
@@ -201,14 +374,8 @@ class Set {
    */
   Set& operator&=(const Set& rhs) {
     if (this != &rhs) {
-      for (auto it = set_.begin(); it != set_.end();) {
-        if (!rhs.Contains(*it)) {
-          it = set_.erase(it);
-          continue;
-        }
-
-        it++;
-      }
+      generation_.Invalidate();
+      ContainerIntersection(&set_, rhs.set_);
     }
 
     return *this;
@@ -218,22 +385,18 @@ class Set {
 
   bool empty() const { return set_.empty(); }
 
-  bool SubsetEq(const Set& s) const {
-    if (size() > s.size()) return false;
-
-    for (const auto& e : set_) {
-      if (!s.Contains(e)) {
-        return false;
-      }
-    }
-
-    return true;
-  }
+  bool SubsetEq(const Set& s) const { return ContainerSubsetEq(set_, s.set_); }
 
   bool Subset(const Set& s) const { return size() < s.size() && SubsetEq(s); }
 
+  /**
+   * @return Stamp identifying the current contents (see GenerationStamp).
+   */
+  std::uint64_t generation() const { return generation_.Get(); }
+
  protected:
   Container set_;
+  GenerationStamp generation_;
 };
 
 template <class Ts>
@@ -315,6 +478,114 @@ inline Set<Ts> operator&(Set<Ts>&& lhs, Set<Ts>&& rhs) {
   return std::move(lhs);
 }
 
+/**
+ * @brief Monotonic memory arena.
+ *
+ * Memory is handed out from large chunks, and individual deallocations are
+ * no-ops; all memory is released at once by Release(). Not thread-safe.
+ * Containers use an arena via ArenaAllocator.
+ */
+class Arena {
+ public:
+  static constexpr std::size_t kAlign = 16;
+
+  explicit Arena(std::size_t chunk_size = 64 * 1024)
+      : chunk_size_(chunk_size), offset_(0), allocated_(0) {
+    assert(chunk_size % kAlign == 0);
+  }
+
+  /**
+   * Copies do not share memory: the result is an empty arena.
+   */
+  Arena(const Arena& rhs) : Arena(rhs.chunk_size_) {}
+
+  Arena& operator=(const Arena&) { return *this; }
+
+  /**
+   * The arena used by ArenaAllocator in the current thread; nullptr if none
+   * (see ArenaScope).
+   */
+  static Arena*& Current() {
+    static MC2LIB_THREAD_LOCAL Arena* current = nullptr;
+    return current;
+  }
+
+  void* Allocate(std::size_t size) {
+    size = (size + kAlign - 1) & ~(kAlign - 1);
+
+    if (size > chunk_size_) {
+      // Dedicated chunk, keeping the current chunk for later allocations.
+      chunks_.emplace(chunks_.begin(), new char[size]);
+      if (chunks_.size() == 1) {
+        offset_ = chunk_size_;  // no current chunk
+      }
+
+      allocated_ += size;
+      return chunks_.front().get();
+    }
+
+    if (chunks_.empty() || offset_ + size > chunk_size_) {
+      chunks_.emplace_back(new char[chunk_size_]);
+      offset_ = 0;
+    }
+
+    void* result = chunks_.back().get() + offset_;
+    offset_ += size;
+    allocated_ += size;
+    return result;
+  }
+
+  /**
+   * Releases all memory allocated from this arena.
+   */
+  void Release() {
+    chunks_.clear();
+    offset_ = 0;
+    allocated_ = 0;
+  }
+
+  /**
+   * @return Number of bytes allocated since last Release().
+   */
+  std::size_t allocated() const { return allocated_; }
+
+ private:
+  std::size_t chunk_size_;
+
+  // Allocated via operator new[], and thus suitably aligned.
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  std::size_t offset_;  // into last chunk
+  std::size_t allocated_;
+};
+
+/**
+ * @brief Sets Arena::Current() for the lifetime of this object.
+ */
+class ArenaScope {
+ public:
+  explicit ArenaScope(Arena* arena) : prev_(Arena::Current()) {
+    Arena::Current() = arena;
+  }
+
+  ~ArenaScope() { Arena::Current() = prev_; }
+
+  ArenaScope(const ArenaScope&) = delete;
+
+  ArenaScope& operator=(const ArenaScope&) = delete;
+
+ private:
+  Arena* prev_;
+};
+
+template <class Ts>
+class SccDecomposition;
+
+template <class Ts>
+class TransitiveClosure;
+
+template <class Ts>
+class OnlineOrder;
+
 template <class Ts>
 class Relation {
  public:
@@ -344,9 +615,80 @@ class Relation {
 
   // }}}
 
-  Relation() : props_(kNone) {}
+  /**
+   * Hit and miss counters of the reachability cache (see
+   * set_reachable_cache).
+   */
+  struct ReachableCacheStats {
+    ReachableCacheStats() : hits(0), misses(0) {}
+
+    std::size_t hits;
+    std::size_t misses;
+  };
+
+  /**
+   * @brief Reusable state for graph searches (see R and Reachable).
+   *
+   * Visited marks are stamped with an epoch, s.t. starting a new search only
+   * increments the epoch, and neither clears nor reallocates marks or the
+   * search stack. Reusing one SearchState across many queries on the same
+   * (or a similar) relation therefore avoids allocation after warm-up.
+   *
+   * A SearchState must not be shared between concurrent searches. The
+   * overloads of R and Reachable without a SearchState reuse one per thread.
+   */
+  class SearchState {
+   public:
+    SearchState() : epoch_(0), in_use_(false), reachable_generation_(0) {}
+
+    /**
+     * @return Counters of the reachability cache, for queries using this
+     *         state.
+     */
+    const ReachableCacheStats& reachable_cache_stats() const {
+      return reachable_stats_;
+    }
+
+   private:
+    friend class Relation;
+
+    struct Mark {
+      Mark() : visited(0) {}
+
+      std::size_t visited;
+    };
+
+    struct Frame {
+      Element e;
+      typename Ts::SetContainer::const_iterator it;
+      typename Ts::SetContainer::const_iterator end;
+    };
+
+    void NewEpoch() {
+      if (++epoch_ == 0) {
+        marks_.clear();
+        epoch_ = 1;
+      }
+
+      stack_.clear();
+    }
 
-  explicit Relation(Container r) : props_(kNone), rel_(std::move(r)) {}
+    typename Ts::template MapContainer<Mark> marks_;
+    std::vector<Frame> stack_;
+    std::size_t epoch_;
+    bool in_use_;
+
+    // Reachability cache, valid for the relation of generation
+    // reachable_generation_.
+    typename Ts::template MapContainer<Set<Ts>> reachable_;
+    std::uint64_t reachable_generation_;
+    ReachableCacheStats reachable_stats_;
+  };
+
+  Relation() : props_(kNone), reachable_cache_(false) {}
+
+  explicit Relation(Container r)
+      : props_(kNone), rel_(std::move(r)), reachable_cache_(false) {}
 
   /**
    * Avoid accessing underlying container directly if possible! Uses of get()
@@ -356,17 +698,27 @@ class Relation {
 
   Properties props() const { return props_; }
 
+  /**
+   * Every modification, including of properties, yields a new stamp.
+   *
+   * @return Stamp identifying the current contents (see GenerationStamp).
+   */
+  std::uint64_t generation() const { return generation_.Get(); }
+
   Relation& set_props(Properties props) {
+    InvalidateGeneration();
     props_ = props;
     return *this;
   }
 
   Relation& add_props(Properties props) {
+    InvalidateGeneration();
     props_ |= props;
     return *this;
   }
 
   Relation& unset_props(Properties props) {
+    InvalidateGeneration();
     props_ &= ~props;
     return *this;
   }
@@ -376,39 +728,131 @@ class Relation {
   bool any_props(Properties any) const { return AnyBitmask(props_, any); }
 
   Properties clear_props() {
+    InvalidateGeneration();
     const auto props = props_;
     props_ = kNone;
     return props;
   }
 
+  /**
+   * Enables or disables the reachability cache: with the transitive closure
+   * property, Reachable() memoizes the set of reachable elements per start
+   * element in the SearchState used (for the overload without one, the
+   * current thread's). Cached sets belong to the generation() they were
+   * computed for, i.e. any modification of the relation (including its
+   * properties) invalidates them.
+   *
+   * Worthwhile where reachability from the same elements is queried
+   * repeatedly, e.g. the last relation of a RelationSeq. As the cache is
+   * held by the search state, the relation may be queried concurrently with
+   * separate states; a state caches the sets of one relation at a time.
+   */
+  Relation& set_reachable_cache(bool enable) {
+    reachable_cache_ = enable;
+    InvalidateGeneration();
+    return *this;
+  }
+
+  bool reachable_cache() const { return reachable_cache_; }
+
+  /**
+   * Enables or disables the online order: a topological order of the
+   * relation (as a graph, i.e. without properties) maintained incrementally
+   * on every Insert of a single tuple, using the algorithm by Pearce and
+   * Kelly [1]. As soon as an inserted tuple closes a cycle, Acyclic()
+   * reports it in O(1); while the order is valid, Acyclic() is O(1) as well.
+   *
+   * Single-tuple Erase keeps the order; bulk operations (e.g. |=, -=, &=,
+   * EvalInplace) invalidate it, and it is then rebuilt on the next Insert.
+   * While invalid, Acyclic() falls back to the full check.
+   *
+   * The order is shared between copies of a relation until either is
+   * modified.
+   *
+   * [1] <a href="http://dx.doi.org/10.1145/1187436.1210590">
+   *      David J. Pearce, Paul H. J. Kelly, "A dynamic topological sort
+   *      algorithm for directed acyclic graphs", 2007.</a>
+   */
+  Relation& set_online_order(bool enable) {
+    if (!enable) {
+      order_.reset();
+    } else if (order_ == nullptr) {
+      order_ = std::make_shared<OnlineOrder<Ts>>();
+      order_->Rebuild(*this);
+    }
+
+    return *this;
+  }
+
+  /**
+   * @return Online order if enabled, nullptr otherwise.
+   */
+  const OnlineOrder<Ts>* online_order() const { return order_.get(); }
+
   void Insert(const Element& e1, const Element& e2,
               bool assert_unique = false) {
+    InvalidateGeneration();
+
+    if (order_ != nullptr) {
+      InsertOrdered(e1, e2, assert_unique);
+      return;
+    }
+
     rel_[e1].Insert(e2, assert_unique);
   }
 
   void Insert(const Element& e1, Element&& e2, bool assert_unique = false) {
+    InvalidateGeneration();
+
+    if (order_ != nullptr) {
+      InsertOrdered(e1, e2, assert_unique);
+      return;
+    }
+
     rel_[e1].Insert(std::move(e2), assert_unique);
   }
 
   void Insert(const Element& e1, const Set<Ts>& e2s) {
     if (e2s.empty()) return;
+    InvalidateGeneration();
+
+    if (order_ != nullptr) {
+      for (const auto& e2 : e2s.get()) {
+        InsertOrdered(e1, e2, false);
+      }
+
+      return;
+    }
+
     rel_[e1] |= e2s;
   }
 
   void Insert(const Element& e1, Set<Ts>&& e2s) {
     if (e2s.empty()) return;
+    InvalidateGeneration();
+
+    if (order_ != nullptr) {
+      Insert(e1, static_cast<const Set<Ts>&>(e2s));
+      return;
+    }
+
     rel_[e1] |= std::move(e2s);
   }
 
   bool Erase(const Element& e1, const Element& e2, bool assert_exists = false) {
     // May not work as expect if kReflexiveClosure is set.
     if (Contains__(e1)) {
+      InvalidateGeneration();
       bool result = rel_[e1].Erase(e2, assert_exists);
 
       if (rel_[e1].empty()) {
         rel_.erase(e1);
       }
 
+      if (result && order_ != nullptr) {
+        MutableOrder()->EraseEdge(e1, e2);
+      }
+
       return result;
     }
 
@@ -416,7 +860,16 @@ class Relation {
   }
 
   void Erase(const Element& e1, const Set<Ts>& e2s) {
+    if (order_ != nullptr) {
+      for (const auto& e2 : e2s.get()) {
+        Erase(e1, e2);
+      }
+
+      return;
+    }
+
     if (Contains__(e1)) {
+      InvalidateGeneration();
       rel_[e1] -= e2s;
 
       if (rel_[e1].empty()) {
@@ -434,10 +887,13 @@ class Relation {
   std::size_t size() const {
     std::size_t total = 0;
 
-    if (props()) {
+    if (all_props(kTransitiveClosure)) {
+      total = TransitiveClosure<Ts>(*this).size();
+    } else if (props()) {
+      SearchState state;
       const auto dom = Domain();
       for (const auto& e : dom.get()) {
-        total += Reachable(e).size();
+        total += Reachable(e, &state).size();
       }
     } else {
       for (const auto& tuples : rel_) {
@@ -455,10 +911,16 @@ class Relation {
    */
   template <class Func>
   Func for_each(Func func) const {
+    if (all_props(kTransitiveClosure)) {
+      TransitiveClosure<Ts>(*this).for_each(func);
+      return std::move(func);
+    }
+
+    SearchState state;
     const auto dom = Domain();
 
     for (const auto& e1 : dom.get()) {
-      const auto reach = Reachable(e1);
+      const auto reach = Reachable(e1, &state);
       for (const auto& e2 : reach.get()) {
         func(e1, e2);
       }
@@ -504,6 +966,7 @@ class Relation {
 
     clear_props();
     rel_ = std::move(result.rel_);
+    InvalidateOrder();
     return *this;
   }
 
@@ -540,9 +1003,10 @@ class Relation {
     EvalInplace();
 
     if (rhs.props()) {
+      SearchState state;
       const auto rhs_domain = rhs.Domain();
       for (const auto& e : rhs_domain.get()) {
-        rel_[e] |= rhs.Reachable(e);
+        rel_[e] |= rhs.Reachable(e, &state);
       }
     } else {
       for (const auto& tuples : rhs.get()) {
@@ -550,6 +1014,8 @@ class Relation {
       }
     }
 
+    InvalidateGeneration();
+    InvalidateOrder();
     return *this;
   }
 
@@ -560,9 +1026,10 @@ class Relation {
     EvalInplace();
 
     if (rhs.props()) {
+      SearchState state;
       const auto rhs_domain = rhs.Domain();
       for (const auto& e : rhs_domain.get()) {
-        Erase(e, rhs.Reachable(e));
+        Erase(e, rhs.Reachable(e, &state));
       }
     } else {
       for (const auto& tuples : rhs.get()) {
@@ -579,8 +1046,9 @@ class Relation {
   Relation& operator&=(const Relation& rhs) {
     EvalInplace();
 
+    SearchState state;
     for (auto it = rel_.begin(); it != rel_.end();) {
-      it->second &= rhs.Reachable(it->first);
+      it->second &= rhs.Reachable(it->first, &state);
 
       if (it->second.empty()) {
         it = rel_.erase(it);
@@ -590,10 +1058,16 @@ class Relation {
       it++;
     }
 
+    InvalidateGeneration();
+    InvalidateOrder();
     return *this;
   }
 
-  void Clear() { rel_.clear(); }
+  void Clear() {
+    rel_.clear();
+    InvalidateGeneration();
+    InvalidateOrder();
+  }
 
   bool empty() const {
     // Upon erasure, we ensure that an element is not related to an empty
@@ -618,6 +1092,17 @@ class Relation {
    * @return true if (e1, e2) is in the relation.
    */
   bool R(const Element& e1, const Element& e2, Path* path = nullptr) const {
+    DefaultSearchState state;
+    return R(e1, e2, path, state.get());
+  }
+
+  /**
+   * Check if (e1, e2) is in the relation; see above.
+   *
+   * @param state Search state, reusable across queries.
+   */
+  bool R(const Element& e1, const Element& e2, Path* path,
+         SearchState* state) const {
     if (e1 == e2 && all_props(kReflexiveClosure)) {
       if (InOn(e1)) {
         if (path != nullptr) {
@@ -629,20 +1114,22 @@ class Relation {
       }
     }
 
-    Set<Ts> visited;
-
-    if (path != nullptr) {
-      FlagSet visiting;
+    if (!all_props(kTransitiveClosure)) {
+      const auto tuples = rel_.find(e1);
+      if (tuples == rel_.end() || !tuples->second.Contains(e2)) {
+        return false;
+      }
 
-      bool result = R_search(e1, &e2, &visited, &visiting);
-      if (result) {
-        GetPath(path, &e1, &e2, &visiting);
+      if (path != nullptr) {
+        path->push_back(e1);
+        path->push_back(e2);
       }
 
-      return result;
+      return true;
     }
 
-    return R_search(e1, &e2, &visited);
+    state->NewEpoch();
+    return Dfs(e1, e2, SearchMode::kRelated, state, nullptr, path);
   }
 
   /**
@@ -654,29 +1141,35 @@ class Relation {
    * @return Set of reachable elements.
    */
   Set<Ts> Reachable(const Element& e) const {
-    Set<Ts> visited;
+    DefaultSearchState state;
+    return Reachable(e, state.get());
+  }
 
-    if (all_props(kReflexiveClosure) && InOn(e)) {
-      visited.Insert(e);
+  /**
+   * Returns all rechable elements from a start element; see above.
+   *
+   * @param state Search state, reusable across queries.
+   */
+  Set<Ts> Reachable(const Element& e, SearchState* state) const {
+    if (!reachable_cache_ || !all_props(kTransitiveClosure)) {
+      return Reachable__(e, state);
     }
 
-    if (!all_props(kTransitiveClosure)) {
-      const auto tuples = rel_.find(e);
-      if (tuples != rel_.end()) {
-        visited |= tuples->second;
-      }
-
-      return visited;
+    if (state->reachable_generation_ != generation()) {
+      state->reachable_.clear();
+      state->reachable_generation_ = generation();
     }
 
-    if (!R_search(e, &e, &visited, nullptr, kNone,
-                  SearchMode::kRelatedVisitAll)) {
-      if (!all_props(kReflexiveClosure)) {
-        visited.Erase(e);
-      }
+    const auto cached = state->reachable_.find(e);
+    if (cached != state->reachable_.end()) {
+      ++state->reachable_stats_.hits;
+      return cached->second;
     }
 
-    return visited;
+    ++state->reachable_stats_.misses;
+    Set<Ts> result = Reachable__(e, state);
+    state->reachable_[e] = result;
+    return result;
   }
 
   bool Irreflexive(Path* cyclic = nullptr) const {
@@ -687,6 +1180,39 @@ class Relation {
     return Irreflexive(kTransitiveClosure, cyclic);
   }
 
+  /**
+   * Check that relation is acyclic, via its strongly connected components.
+   *
+   * @param cyclic Optional; if result is false, a cycle [e, ..., e].
+   * @param sccs Optional; the strongly connected components of the relation
+   *             (as a graph, i.e. without properties), for reuse by caller.
+   * @return true if acyclic, false otherwise.
+   */
+  bool Acyclic(Path* cyclic, SccDecomposition<Ts>* sccs) const {
+    SccDecomposition<Ts> local_sccs;
+    if (sccs == nullptr) {
+      sccs = &local_sccs;
+    }
+
+    sccs->Compute(*this);
+
+    if (all_props(kReflexiveClosure) && !empty()) {
+      if (cyclic != nullptr) {
+        // Pick arbitrary.
+        cyclic->push_back(rel_.begin()->first);
+        cyclic->push_back(rel_.begin()->first);
+      }
+
+      return false;
+    }
+
+    if (cyclic != nullptr) {
+      return !sccs->FindCycle(cyclic);
+    }
+
+    return sccs->acyclic();
+  }
+
   /**
    * x→y ∧ y→z ⇒ x→z
    */
@@ -695,12 +1221,13 @@ class Relation {
       return true;
     }
 
+    SearchState state;
     for (const auto& tuples1 : rel_) {
       for (const auto& e1 : tuples1.second.get()) {
         const auto tuples2 = rel_.find(e1);
         if (tuples2 != rel_.end()) {
           for (const auto& e2 : tuples2->second.get()) {
-            if (!R(tuples1.first, e2)) {
+            if (!R(tuples1.first, e2, nullptr, &state)) {
               return false;
             }
           }
@@ -715,9 +1242,10 @@ class Relation {
    * ∀(x,y) ∈ on×on, x→y ∨ y→x
    */
   bool TotalOn(const Set<Ts>& on) const {
+    SearchState state;
     for (const auto& e1 : on.get()) {
       for (const auto& e2 : on.get()) {
-        if (!R(e1, e2) && !R(e2, e1)) {
+        if (!R(e1, e2, nullptr, &state) && !R(e2, e1, nullptr, &state)) {
           return false;
         }
       }
@@ -730,9 +1258,11 @@ class Relation {
    * ∀(x,y) ∈ on×on, x→y ∨ y→x ∨ x=y
    */
   bool ConnexOn(const Set<Ts>& on) const {
+    SearchState state;
     for (const auto& e1 : on.get()) {
       for (const auto& e2 : on.get()) {
-        if (e1 != e2 && !R(e1, e2) && !R(e2, e1)) {
+        if (e1 != e2 && !R(e1, e2, nullptr, &state) &&
+            !R(e2, e1, nullptr, &state)) {
           return false;
         }
       }
@@ -798,8 +1328,9 @@ class Relation {
       return InOn(e);
     }
 
+    SearchState state;
     for (const auto& tuples : rel_) {
-      if (Reachable(tuples.first).Contains(e)) {
+      if (Reachable(tuples.first, &state).Contains(e)) {
         return true;
       }
     }
@@ -839,9 +1370,10 @@ class Relation {
       return On();
     }
 
+    SearchState state;
     Set<Ts> res;
     for (const auto& tuples : rel_) {
-      res |= Reachable(tuples.first);
+      res |= Reachable(tuples.first, &state);
     }
 
     return res;
@@ -857,12 +1389,52 @@ class Relation {
   }
 
  protected:
-  typedef typename Ts::template MapContainer<bool> FlagSet;
+  typedef typename SearchState::Mark Mark;
+  typedef typename SearchState::Frame Frame;
 
   /**
-   * Search mode.
+   * Search state of the overloads of R and Reachable without one: the
+   * current thread's, which is reused across queries; or a fresh one if it
+   * is already in use, not available (see MC2LIB_THREAD_LOCAL_POD_ONLY), or
+   * if memory is allocated from an Arena, which it must not outlive.
    */
-  enum class SearchMode {
+  class DefaultSearchState {
+   public:
+    DefaultSearchState() : state_(ThreadState()) {
+      if (state_ == nullptr || state_->in_use_ ||
+          Arena::Current() != nullptr) {
+        state_ = &local_;
+      }
+
+      state_->in_use_ = true;
+    }
+
+    ~DefaultSearchState() { state_->in_use_ = false; }
+
+    DefaultSearchState(const DefaultSearchState&) = delete;
+
+    DefaultSearchState& operator=(const DefaultSearchState&) = delete;
+
+    SearchState* get() const { return state_; }
+
+   private:
+    static SearchState* ThreadState() {
+#ifdef MC2LIB_THREAD_LOCAL_POD_ONLY
+      return nullptr;
+#else
+      static MC2LIB_THREAD_LOCAL SearchState state;
+      return &state;
+#endif
+    }
+
+    SearchState local_;
+    SearchState* state_;
+  };
+
+  /**
+   * Search mode.
+   */
+  enum class SearchMode {
     /**
      * Check if two elements are related.
      */
@@ -871,67 +1443,41 @@ class Relation {
     /**
      * Check if two elements are related, but visit all elements.
      */
-    kRelatedVisitAll,
-
-    /**
-     * Only find a cycle from a given element (node).
-     */
-    kFindCycle
+    kRelatedVisitAll
   };
 
   /**
-   * @return true if e in rel_.
-   */
-  bool Contains__(const Element& e) const { return rel_.find(e) != rel_.end(); }
-
-  /**
-   * Get path from start to end.
+   * Uncached Reachable.
    */
-  void GetPath(Path* out, const Element* start, const Element* end,
-               FlagSet* visiting,
-               SearchMode mode = SearchMode::kRelated) const {
-    assert(out != nullptr && start != nullptr && visiting != nullptr);
-
-    out->push_back(*start);
-    (*visiting)[*start] = false;
-
-    while (start != nullptr) {
-      const Set<Ts>& next = rel_.find(*start)->second;
-      start = nullptr;
+  Set<Ts> Reachable__(const Element& e, SearchState* state) const {
+    Set<Ts> visited;
 
-      for (const auto& e : next.get()) {
-        const auto se = visiting->find(e);
-        if (se != visiting->end() && se->second) {
-          out->push_back(e);
-          se->second = false;
-          start = &e;
-          break;
-        }
-      }
+    if (all_props(kReflexiveClosure) && InOn(e)) {
+      visited.Insert(e);
     }
 
-    const Set<Ts>& next = rel_.find(out->back())->second;
-    if (mode == SearchMode::kFindCycle) {
-      assert(end == nullptr);
-
-      for (const auto& e : *out) {
-        if (next.Contains(e)) {
-          // Final edge
-          out->push_back(e);
-          break;
-        }
+    if (!all_props(kTransitiveClosure)) {
+      const auto tuples = rel_.find(e);
+      if (tuples != rel_.end()) {
+        visited |= tuples->second;
       }
-    } else {
-      assert(end != nullptr);
 
-      // This function should only be called if search established there
-      // is a path between start->end.
-      assert(next.Contains(*end));
+      return visited;
+    }
 
-      out->push_back(*end);
+    state->NewEpoch();
+    if (Dfs(e, e, SearchMode::kRelatedVisitAll, state, &visited, nullptr)) {
+      visited.Insert(e);
     }
+
+    return visited;
   }
 
+  /**
+   * @return true if e in rel_.
+   */
+  bool Contains__(const Element& e) const { return rel_.find(e) != rel_.end(); }
+
   /**
    * Check that relation is irreflexive.
    *
@@ -953,564 +1499,2808 @@ class Relation {
       return false;
     }
 
-    Set<Ts> visited;
-    FlagSet visiting;
+    if (!AllBitmask(local_props, kTransitiveClosure)) {
+      for (const auto& tuples : rel_) {
+        if (tuples.second.Contains(tuples.first)) {
+          if (cyclic != nullptr) {
+            cyclic->push_back(tuples.first);
+            cyclic->push_back(tuples.first);
+          }
 
-    for (const auto& tuples : rel_) {
-      if (R_search(tuples.first, nullptr, &visited, &visiting, local_props,
-                   SearchMode::kFindCycle)) {
-        if (cyclic != nullptr) {
-          GetPath(cyclic, &tuples.first, nullptr, &visiting,
-                  SearchMode::kFindCycle);
+          return false;
         }
+      }
 
-        return false;
+      return true;
+    }
+
+    if (order_ != nullptr && !order_->dirty()) {
+      if (order_->acyclic()) {
+        return true;
       }
+
+      if (cyclic != nullptr) {
+        cyclic->insert(cyclic->end(), order_->cycle().begin(),
+                       order_->cycle().end());
+      }
+
+      return false;
     }
 
-    return true;
+    // Irreflexivity of the transitive closure is acyclicity.
+    return Acyclic(cyclic, nullptr);
   }
 
   /**
-   * Check if two elements are related, i.e. there exists an edge or path from
-   * e1 to e2. This is implemented as a directed graph search.
+   * Iterative depth-first search from start, following the transitive
+   * closure of the relation.
    *
-   * @param e1 First element.
-   * @param e2 Second element.
-   * @param visited Visited element (node) set.
-   * @param visiting Currently visiting elements (nodes).
-   * @param local_props Call specific properties.
+   * With SearchMode::kRelated, the search stops as soon as target is found;
+   * with SearchMode::kRelatedVisitAll all elements reachable from start are
+   * visited.
+   *
+   * @param start Start element.
+   * @param target Element to search for.
    * @param mode Search mode.
+   * @param state Search state, with the current epoch already started.
+   * @param reached Optional; visited elements other than start are
+   *                inserted.
+   * @param path Optional; upon success, the path from start to target.
    *
-   * @return true if there exists an edge or path, false otherwise.
+   * @return true if target is reachable from start.
    */
-  bool R_search(const Element& e1, const Element* e2, Set<Ts>* visited,
-                FlagSet* visiting = nullptr, Properties local_props = kNone,
-                SearchMode mode = SearchMode::kRelated) const {
-    // We always require visited to be set.
-    assert(visited != nullptr);
-
-    // Merge call-specific props with global props.
-    local_props |= props_;
-
-    const bool is_tran_cl = AllBitmask(local_props, kTransitiveClosure);
+  bool Dfs(const Element& start, const Element& target, SearchMode mode,
+           SearchState* state, Set<Ts>* reached, Path* path) const {
+    auto tuples = rel_.find(start);
+    if (tuples == rel_.end()) {
+      return false;
+    }
 
-    R_impl search(this, visited, visiting, is_tran_cl, mode);
+    state->marks_[start].visited = state->epoch_;
 
-    if (e2 == nullptr) {
-      // For the purpose of cycle detection, we are looking for e1->*e1.
-      // In addition, if the transitive property is set, we require that
-      // visiting is provided, as we cannot make assumptions on if visited
-      // is reset before every call -- and for performance reasons, this
-      // usage is discouraged.
+    auto& stack = state->stack_;
+    stack.clear();
+    stack.push_back(
+        Frame{start, tuples->second.get().begin(), tuples->second.get().end()});
 
-      assert(mode == SearchMode::kFindCycle);
+    bool result = false;
 
-      e2 = &e1;
+    while (!stack.empty()) {
+      Frame& top = stack.back();
 
-      if (is_tran_cl) {
-        assert(visiting != nullptr);
-        return search.DfsRecFindCycle(e1);
+      if (top.it == top.end) {
+        stack.pop_back();
+        continue;
       }
-    } else {
-      assert(mode != SearchMode::kFindCycle);
-    }
 
-    return search.DfsRec(e1, *e2);
-  }
+      const Element e = *top.it;
+      ++top.it;
 
-  /**
-   * Helper class to check if two elements are related.
-   */
-  class R_impl {
-   public:
-    R_impl(const Relation* src, Set<Ts>* visited, FlagSet* visiting,
-           bool is_tran_cl, SearchMode mode)
-        : src_(src),
-          visited_(visited),
-          visiting_(visiting),
-          is_tran_cl_(is_tran_cl),
-          mode_(mode) {}
+      if (e == target) {
+        if (mode == SearchMode::kRelated) {
+          if (path != nullptr) {
+            PathFromStack(*state, e, path);
+          }
 
-    /**
-     * Recursive DFS implementation, searching if there exists a path from e1
-     * to e2.
-     */
-    bool DfsRec(const Element& e1, const Element& e2) const {
-      const auto tuples = src_->get().find(e1);
+          return true;
+        }
 
-      if (tuples == src_->get().end()) {
-        return false;
+        result = true;
       }
 
-      if (visiting_ != nullptr) {
-        (*visiting_)[e1] = true;
+      Mark& mark = state->marks_[e];
+      if (mark.visited == state->epoch_) {
+        continue;
       }
 
-      bool result = false;
-      visited_->Insert(e1);
-
-      for (const auto& e : tuples->second.get()) {
-        if (e == e2) {
-          if (mode_ == SearchMode::kRelatedVisitAll) {
-            result = true;
-          } else {
-            return true;
-          }
-        }
-
-        if (is_tran_cl_) {
-          if (!visited_->Contains(e)) {
-            if (DfsRec(e, e2)) {
-              if (mode_ == SearchMode::kRelatedVisitAll) {
-                result = true;
-              } else {
-                return true;
-              }
-            }
+      mark.visited = state->epoch_;
 
-            // There might not be an edge e -> e2, but we must update
-            // the visited set regardless -- this is only relevant, as
-            // the caller might expect the complete set of visited
-            // nodes if mode == RelatedVisitAll.
-            visited_->Insert(e);
-          } else {
-            // assert(mode_ != SearchMode::kFindCycle);
-          }
-        }
+      if (reached != nullptr) {
+        reached->Insert(e);
       }
 
-      if (visiting_ != nullptr) {
-        (*visiting_)[e1] = false;
+      tuples = rel_.find(e);
+      if (tuples != rel_.end()) {
+        // Invalidates top.
+        stack.push_back(
+            Frame{e, tuples->second.get().begin(), tuples->second.get().end()});
       }
+    }
 
-      return result;
+    return result;
+  }
+
+  void InsertOrdered(const Element& e1, const Element& e2,
+                     bool assert_unique) {
+    Set<Ts>& row = rel_[e1];
+    const bool inserted = !row.Contains(e2);
+    assert(!assert_unique || inserted);
+
+    if (inserted) {
+      row.Insert(e2);
     }
 
-    /**
-     * DFS optimized to just find a cycle; elides some branches that are not
-     * needed compared to DfsRec.
-     */
-    bool DfsRecFindCycle(const Element& start) const {
-      // assert(is_tran_cl_);
-      // assert(mode_ == SearchMode::kFindCycle);
-      // assert(visiting_ != nullptr);
+    if (order_->dirty()) {
+      MutableOrder()->Rebuild(*this);
+    } else if (inserted) {
+      MutableOrder()->InsertEdge(e1, e2);
+    }
+  }
 
-      const auto tuples = src_->get().find(start);
+  /**
+   * @return Online order, unshared from any copies.
+   */
+  OnlineOrder<Ts>* MutableOrder() {
+    if (order_.use_count() > 1) {
+      order_ = std::make_shared<OnlineOrder<Ts>>(*order_);
+    }
 
-      if (tuples == src_->get().end()) {
-        return false;
-      }
+    return order_.get();
+  }
 
-      (*visiting_)[start] = true;
-      visited_->Insert(start);
+  void InvalidateGeneration() {
+    generation_.Invalidate();
 
-      for (const auto& e : tuples->second.get()) {
-        if (!visited_->Contains(e)) {
-          if (DfsRecFindCycle(e)) {
-            return true;
-          }
-        } else {
-          const auto se = visiting_->find(e);
-          if (se != visiting_->end() && se->second) {
-            // Found a backedge --> cycle!
-            return true;
-          }
-        }
-      }
+    if (reachable_cache_) {
+      // Draw the stamp now: concurrent queries of the cache only read it.
+      generation_.Get();
+    }
+  }
 
-      (*visiting_)[start] = false;
-      return false;
+  void InvalidateOrder() {
+    if (order_ != nullptr && !order_->dirty()) {
+      MutableOrder()->Invalidate();
     }
+  }
 
-   private:
-    const Relation* src_;
-    Set<Ts>* visited_;
-    FlagSet* visiting_;
-    bool is_tran_cl_;
-    SearchMode mode_;
-  };
+  /**
+   * Get path along the current search stack, followed by last.
+   */
+  static void PathFromStack(const SearchState& state, const Element& last,
+                            Path* out) {
+    for (const auto& frame : state.stack_) {
+      out->push_back(frame.e);
+    }
+
+    out->push_back(last);
+  }
 
  protected:
   Properties props_;
   Container rel_;
+  std::shared_ptr<OnlineOrder<Ts>> order_;
+  GenerationStamp generation_;
+  bool reachable_cache_;
 };
 
+/**
+ * @brief Strongly connected components of a Relation.
+ *
+ * The relation is viewed as a directed graph, ignoring properties (neither
+ * closure changes the components, and with the transitive closure, the
+ * relation is acyclic iff every component is acyclic). Components are
+ * computed with an iterative variant of Tarjan's algorithm, on a local
+ * compact copy of the graph: elements are numbered 0..num_nodes()-1.
+ *
+ * Components are numbered in reverse topological order of the condensation:
+ * if there is an edge from a node in component c1 to a node in a different
+ * component c2, then c1 > c2.
+ */
 template <class Ts>
-inline Relation<Ts> operator*(const Set<Ts>& lhs, const Set<Ts>& rhs) {
-  Relation<Ts> res;
-
-  for (const auto& e1 : lhs.get()) {
-    for (const auto& e2 : rhs.get()) {
-      res.Insert(e1, e2);
-    }
-  }
-
-  return res;
-}
+class SccDecomposition {
+ public:
+  typedef typename Ts::Element Element;
+  typedef typename Relation<Ts>::Path Path;
 
-template <class Ts>
-inline Relation<Ts> operator|(const Relation<Ts>& lhs,
-                              const Relation<Ts>& rhs) {
-  Relation<Ts> res = lhs;
-  return res |= rhs;
-}
+  static constexpr std::size_t kInvalid =
+      std::numeric_limits<std::size_t>::max();
 
-template <class Ts>
-inline Relation<Ts> operator|(Relation<Ts>&& lhs, const Relation<Ts>& rhs) {
-  lhs |= rhs;
-  return std::move(lhs);
-}
+  /**
+   * Iterable range of node indices.
+   */
+  class NodeRange {
+   public:
+    NodeRange(const std::size_t* first, const std::size_t* last)
+        : first_(first), last_(last) {}
 
-template <class Ts>
-inline Relation<Ts> operator|(const Relation<Ts>& lhs, Relation<Ts>&& rhs) {
-  rhs |= lhs;
-  return std::move(rhs);
-}
+    const std::size_t* begin() const { return first_; }
 
-template <class Ts>
-inline Relation<Ts> operator|(Relation<Ts>&& lhs, Relation<Ts>&& rhs) {
-  lhs |= rhs;
-  return std::move(lhs);
-}
+    const std::size_t* end() const { return last_; }
 
-template <class Ts>
-inline Relation<Ts> operator-(const Relation<Ts>& lhs,
-                              const Relation<Ts>& rhs) {
-  Relation<Ts> res = lhs;
-  return res -= rhs;
-}
+    std::size_t size() const { return last_ - first_; }
 
-template <class Ts>
-inline Relation<Ts> operator-(Relation<Ts>&& lhs, const Relation<Ts>& rhs) {
-  lhs -= rhs;
-  return std::move(lhs);
-}
+   private:
+    const std::size_t* first_;
+    const std::size_t* last_;
+  };
 
-template <class Ts>
-inline Relation<Ts> operator-(const Relation<Ts>& lhs, Relation<Ts>&& rhs) {
-  Relation<Ts> res = lhs;
-  return res -= rhs;
-}
+  SccDecomposition() : first_cyclic_(kInvalid) {}
 
-template <class Ts>
-inline Relation<Ts> operator-(Relation<Ts>&& lhs, Relation<Ts>&& rhs) {
-  lhs -= rhs;
-  return std::move(lhs);
-}
+  explicit SccDecomposition(const Relation<Ts>& rel)
+      : first_cyclic_(kInvalid) {
+    Compute(rel);
+  }
 
-template <class Ts>
-inline Relation<Ts> operator&(const Relation<Ts>& lhs,
-                              const Relation<Ts>& rhs) {
-  Relation<Ts> res;
+  /**
+   * (Re)computes the components of rel.
+   */
+  void Compute(const Relation<Ts>& rel) {
+    Clear();
+    BuildGraph(rel);
+    Tarjan();
+  }
 
-  const auto lhs_domain = lhs.Domain();
-  for (const auto& e : lhs_domain.get()) {
-    Set<Ts> intersect = lhs.Reachable(e) & rhs.Reachable(e);
-    // insert checks if empty or not
-    res.Insert(e, std::move(intersect));
+  void Clear() {
+    nodes_.clear();
+    index_.clear();
+    succ_offsets_.clear();
+    succ_.clear();
+    self_loop_.clear();
+    comp_of_.clear();
+    comp_offsets_.clear();
+    comp_nodes_.clear();
+    first_cyclic_ = kInvalid;
   }
 
-  return res;
-}
+  std::size_t num_nodes() const { return nodes_.size(); }
 
-template <class Ts>
-inline Relation<Ts> operator&(Relation<Ts>&& lhs, const Relation<Ts>& rhs) {
-  lhs &= rhs;
-  return std::move(lhs);
-}
+  const Element& node(std::size_t n) const { return nodes_[n]; }
 
-template <class Ts>
-inline Relation<Ts> operator&(const Relation<Ts>& lhs, Relation<Ts>&& rhs) {
-  rhs &= lhs;
-  return std::move(rhs);
-}
+  /**
+   * @return Node index of e; kInvalid if e is not in the relation.
+   */
+  std::size_t NodeOf(const Element& e) const {
+    const auto it = index_.find(e);
+    return it != index_.end() ? it->second : kInvalid;
+  }
 
-template <class Ts>
-inline Relation<Ts> operator&(Relation<Ts>&& lhs, Relation<Ts>&& rhs) {
-  lhs &= rhs;
-  return std::move(lhs);
-}
+  NodeRange Successors(std::size_t n) const {
+    return NodeRange(succ_.data() + succ_offsets_[n],
+                     succ_.data() + succ_offsets_[n + 1]);
+  }
 
-/**
- * Relation operator base class.
- * No derived class shall define a destructor!
- */
-template <class Ts>
-class RelationOp {
- public:
-  RelationOp() {}
+  std::size_t num_components() const {
+    return comp_offsets_.empty() ? 0 : comp_offsets_.size() - 1;
+  }
 
-  explicit RelationOp(std::vector<Relation<Ts>> rels)
-      : rels_(std::move(rels)) {}
+  std::size_t component(std::size_t n) const { return comp_of_[n]; }
 
-  /*//virtual ~RelationOp()
-   *
-   * No destructor, so compiler can implicitly create move constructor and
-   * assignment operators.
-  */
+  /**
+   * @return Component of e; kInvalid if e is not in the relation.
+   */
+  std::size_t ComponentOf(const Element& e) const {
+    const std::size_t n = NodeOf(e);
+    return n != kInvalid ? comp_of_[n] : kInvalid;
+  }
 
   /**
-   * Evaluate in-place, where postcondition is rels_.size() <= 1. This avoids
-   * some of the copying overhead of Eval(), and can therefore be more
-   * efficient.
-   *
-   * @return Reference to this object.
+   * @return Nodes in component c.
    */
-  virtual RelationOp& EvalInplace() = 0;
+  NodeRange Component(std::size_t c) const {
+    return NodeRange(comp_nodes_.data() + comp_offsets_[c],
+                     comp_nodes_.data() + comp_offsets_[c + 1]);
+  }
 
   /**
-   * Evaluate operator, computing the result of the opertor.
-   *
-   * @return Relation representing view of operator.
+   * @return true if component c contains a cycle.
    */
-  virtual Relation<Ts> Eval() const = 0;
+  bool Cyclic(std::size_t c) const {
+    const NodeRange nodes = Component(c);
+    return nodes.size() > 1 || self_loop_[*nodes.begin()];
+  }
 
-  void Clear() { rels_.clear(); }
+  /**
+   * @return true if no component contains a cycle.
+   */
+  bool acyclic() const { return first_cyclic_ == kInvalid; }
 
   /**
-   * Evaluate operator in-place, and clearing it, returning the evaluated
-   * Relation. Optimized for move, and should be used where the operator is
-   * used as a temporary.
+   * Finds a shortest cycle through the first node of the first cyclic
+   * component.
    *
-   * @return Relation representing view of operator before call.
+   * @param cycle Output; cycle [e, ..., e] is appended.
+   * @return true if a cycle exists, false otherwise.
    */
-  Relation<Ts> EvalClear() {
-    if (rels_.empty()) {
-      // Already cleared
-      return Relation<Ts>();
+  bool FindCycle(Path* cycle) const {
+    if (acyclic()) {
+      return false;
     }
 
-    EvalInplace();
-    assert(rels_.size() == 1);
+    const std::size_t c = first_cyclic_;
+    const std::size_t root = *Component(c).begin();
 
-    Relation<Ts> result = std::move(rels_.back());
-    rels_.clear();
-    return result;  // NRVO
+    if (self_loop_[root]) {
+      cycle->push_back(nodes_[root]);
+      cycle->push_back(nodes_[root]);
+      return true;
+    }
+
+    // BFS within the component, until an edge back to root is found.
+    std::vector<std::size_t> parent(num_nodes(), kInvalid);
+    std::vector<std::size_t> queue;
+    queue.push_back(root);
+    parent[root] = root;
+
+    for (std::size_t i = 0; i < queue.size(); ++i) {
+      const std::size_t n = queue[i];
+
+      for (const std::size_t succ : Successors(n)) {
+        if (succ == root) {
+          const std::size_t first = cycle->size();
+          for (std::size_t m = n; m != root; m = parent[m]) {
+            cycle->push_back(nodes_[m]);
+          }
+
+          cycle->push_back(nodes_[root]);
+          std::reverse(cycle->begin() + first, cycle->end());
+          cycle->push_back(nodes_[root]);
+          return true;
+        }
+
+        if (comp_of_[succ] == c && parent[succ] == kInvalid) {
+          parent[succ] = n;
+          queue.push_back(succ);
+        }
+      }
+    }
+
+    // Root is in a cyclic component.
+    assert(false);
+    return false;
   }
 
  protected:
-  void Add(const Relation<Ts>& er) { rels_.push_back(er); }
+  std::size_t Intern(const Element& e) {
+    const auto it = index_.find(e);
+    if (it != index_.end()) {
+      return it->second;
+    }
 
-  void Add(Relation<Ts>&& er) { rels_.push_back(std::move(er)); }
+    index_[e] = nodes_.size();
+    nodes_.push_back(e);
+    return nodes_.size() - 1;
+  }
 
-  void Add(const std::vector<Relation<Ts>>& rels) {
-    rels_.reserve(rels_.size() + rels.size());
-    rels_.insert(rels_.end(), rels.begin(), rels.end());
+  void BuildGraph(const Relation<Ts>& rel) {
+    // Number the domain first, in iteration order, s.t. rows (visited in the
+    // same order below) can be appended to succ_ directly.
+    for (const auto& tuples : rel.get()) {
+      Intern(tuples.first);
+    }
+
+    const std::size_t num_domain = nodes_.size();
+    std::size_t n = 0;
+
+    for (const auto& tuples : rel.get()) {
+      succ_offsets_.push_back(succ_.size());
+      for (const auto& e : tuples.second.get()) {
+        succ_.push_back(Intern(e));
+      }
+      ++n;
+    }
+
+    assert(n == num_domain);
+
+    // Nodes only in the range have no successors.
+    succ_offsets_.resize(nodes_.size() + 1, succ_.size());
+
+    self_loop_.assign(nodes_.size(), false);
+    for (n = 0; n < num_domain; ++n) {
+      for (const std::size_t succ : Successors(n)) {
+        if (succ == n) {
+          self_loop_[n] = true;
+        }
+      }
+    }
   }
 
- protected:
-  std::vector<Relation<Ts>> rels_;
+  void Tarjan() {
+    const std::size_t num = nodes_.size();
+
+    std::vector<std::size_t> order(num, kInvalid);
+    std::vector<std::size_t> low(num);
+    std::vector<std::size_t> stack;
+    std::vector<std::pair<std::size_t, std::size_t>> calls;  // (node, edge)
+    std::size_t counter = 0;
+
+    comp_of_.assign(num, kInvalid);
+    comp_offsets_.push_back(0);
+
+    for (std::size_t root = 0; root < num; ++root) {
+      if (order[root] != kInvalid) {
+        continue;
+      }
+
+      order[root] = low[root] = counter++;
+      stack.push_back(root);
+      calls.emplace_back(root, succ_offsets_[root]);
+
+      while (!calls.empty()) {
+        const std::size_t n = calls.back().first;
+        std::size_t& edge = calls.back().second;
+
+        if (edge < succ_offsets_[n + 1]) {
+          const std::size_t succ = succ_[edge++];
+
+          if (order[succ] == kInvalid) {
+            order[succ] = low[succ] = counter++;
+            stack.push_back(succ);
+            // Invalidates edge.
+            calls.emplace_back(succ, succ_offsets_[succ]);
+          } else if (comp_of_[succ] == kInvalid) {
+            // On stack.
+            low[n] = std::min(low[n], order[succ]);
+          }
+
+          continue;
+        }
+
+        calls.pop_back();
+
+        if (low[n] == order[n]) {
+          const std::size_t c = comp_offsets_.size() - 1;
+          std::size_t m;
+
+          do {
+            m = stack.back();
+            stack.pop_back();
+            comp_of_[m] = c;
+            comp_nodes_.push_back(m);
+          } while (m != n);
+
+          comp_offsets_.push_back(comp_nodes_.size());
+
+          if (first_cyclic_ == kInvalid && Cyclic(c)) {
+            first_cyclic_ = c;
+          }
+        }
+
+        if (!calls.empty()) {
+          const std::size_t parent = calls.back().first;
+          low[parent] = std::min(low[parent], low[n]);
+        }
+      }
+    }
+  }
+
+  std::vector<Element> nodes_;
+  typename Ts::template MapContainer<std::size_t> index_;
+
+  std::vector<std::size_t> succ_offsets_;
+  std::vector<std::size_t> succ_;
+  std::vector<bool> self_loop_;
+
+  std::vector<std::size_t> comp_of_;
+  std::vector<std::size_t> comp_offsets_;
+  std::vector<std::size_t> comp_nodes_;
+  std::size_t first_cyclic_;
 };
 
+template <class Ts>
+constexpr std::size_t SccDecomposition<Ts>::kInvalid;
+
 /**
- * Operator ";".
+ * @brief Evaluated transitive closure of a Relation.
+ *
+ * Computes the strongly connected components of the relation, and then, in
+ * reverse topological order of the condensation, a bit vector per component
+ * of all nodes reachable from it: for a component C, this is the union over
+ * all edges (u, v) with u in C of {v} and, if v is in a different component
+ * C', the bit vector of C'. The cost is O(V + E * V/64) rather than the
+ * O(V * (V + E)) of searching from every node.
+ *
+ * Also evaluates the reflexive closure, if the relation has that property.
  */
 template <class Ts>
-class RelationSeq : public RelationOp<Ts> {
+class TransitiveClosure {
  public:
   typedef typename Ts::Element Element;
 
-  RelationSeq() {}
+  explicit TransitiveClosure(const Relation<Ts>& rel)
+      : sccs_(rel),
+        reflexive_(rel.all_props(Relation<Ts>::kReflexiveClosure)) {
+    Compute();
+  }
 
-  explicit RelationSeq(std::vector<Relation<Ts>> v)
-      : RelationOp<Ts>(std::move(v)) {}
+  const SccDecomposition<Ts>& sccs() const { return sccs_; }
 
-  RelationSeq& operator+=(const Relation<Ts>& rhs) {
-    this->Add(rhs);
-    return *this;
+  /**
+   * @return true if node n2 is reachable from node n1 (as numbered by
+   *         sccs()).
+   */
+  bool R(std::size_t n1, std::size_t n2) const {
+    return (reflexive_ && n1 == n2) || Test(Row(n1), n2);
   }
 
-  RelationSeq& operator+=(Relation<Ts>&& rhs) {
-    this->Add(std::move(rhs));
-    return *this;
+  /**
+   * Iterates over each tuple in the closure.
+   *
+   * @param func A function taking two parameters of type Element.
+   */
+  template <class Func>
+  void for_each(Func& func) const {
+    for (std::size_t n = 0; n < sccs_.num_nodes(); ++n) {
+      const Element& e1 = sccs_.node(n);
+      const std::uint64_t* row = Row(n);
+
+      if (reflexive_ && !Test(row, n)) {
+        func(e1, e1);
+      }
+
+      for (std::size_t i = 0; i < words_; ++i) {
+        for (std::uint64_t w = row[i]; w != 0; w &= w - 1) {
+          func(e1, sccs_.node(i * 64 + __builtin_ctzll(w)));
+        }
+      }
+    }
   }
 
-  RelationSeq& operator+=(const RelationSeq& rhs) {
-    this->Add(rhs.rels_);
-    return *this;
+  /**
+   * @return Number of tuples in the closure.
+   */
+  std::size_t size() const {
+    std::size_t total = 0;
+
+    for (std::size_t n = 0; n < sccs_.num_nodes(); ++n) {
+      const std::uint64_t* row = Row(n);
+
+      if (reflexive_ && !Test(row, n)) {
+        ++total;
+      }
+
+      for (std::size_t i = 0; i < words_; ++i) {
+        total += __builtin_popcountll(row[i]);
+      }
+    }
+
+    return total;
   }
 
-  RelationOp<Ts>& EvalInplace() override {
-    while (this->rels_.size() > 1) {
-      std::size_t from_idx = this->rels_.size() - 2;
-      const auto& first = this->rels_[from_idx];
-      const auto& last = this->rels_.back();
+ protected:
+  void Compute() {
+    const std::size_t num_comps = sccs_.num_components();
+    words_ = (sccs_.num_nodes() + 63) / 64;
+    reach_.assign(num_comps * words_, 0);
+
+    // Component merged last into each component's row, to avoid merging the
+    // same component repeatedly.
+    std::vector<std::size_t> merged(num_comps, SccDecomposition<Ts>::kInvalid);
+
+    // Components of successors are numbered lower, and are thus complete.
+    for (std::size_t c = 0; c < num_comps; ++c) {
+      std::uint64_t* row = &reach_[c * words_];
+
+      for (const std::size_t n : sccs_.Component(c)) {
+        for (const std::size_t succ : sccs_.Successors(n)) {
+          row[succ / 64] |= static_cast<std::uint64_t>(1) << (succ % 64);
+
+          const std::size_t succ_c = sccs_.component(succ);
+          if (succ_c != c && merged[succ_c] != c) {
+            merged[succ_c] = c;
+
+            const std::uint64_t* succ_row = &reach_[succ_c * words_];
+            for (std::size_t i = 0; i < words_; ++i) {
+              row[i] |= succ_row[i];
+            }
+          }
+        }
+      }
+    }
+  }
 
-      Relation<Ts> er;
+  const std::uint64_t* Row(std::size_t n) const {
+    return &reach_[sccs_.component(n) * words_];
+  }
 
-      first.for_each([&er, &last](const Element& e1, const Element& e2) {
-        if (last.InDomain(e2)) {
-          er.Insert(e1, last.Reachable(e2));
+  static bool Test(const std::uint64_t* row, std::size_t n) {
+    return (row[n / 64] & (static_cast<std::uint64_t>(1) << (n % 64))) != 0;
+  }
+
+  SccDecomposition<Ts> sccs_;
+  bool reflexive_;
+  std::size_t words_;
+  std::vector<std::uint64_t> reach_;
+};
+
+/**
+ * @brief Incrementally maintained topological order of a Relation.
+ *
+ * See Relation::set_online_order. Keeps its own compact copy of the graph
+ * (successors and predecessors per node), as the dynamic algorithm searches
+ * in both directions.
+ */
+template <class Ts>
+class OnlineOrder {
+ public:
+  typedef typename Ts::Element Element;
+  typedef typename Relation<Ts>::Path Path;
+
+  static constexpr std::size_t kInvalid =
+      std::numeric_limits<std::size_t>::max();
+
+  OnlineOrder() : dirty_(true), next_ord_(0), epoch_(0) {}
+
+  /**
+   * @return true if the order must be rebuilt before use.
+   */
+  bool dirty() const { return dirty_; }
+
+  /**
+   * @return true if no cycle was found; only meaningful if !dirty().
+   */
+  bool acyclic() const { return cycle_.empty(); }
+
+  /**
+   * @return The cycle [e, ..., e] closed by the first inserted edge that
+   *         closed a cycle; empty if acyclic().
+   */
+  const Path& cycle() const { return cycle_; }
+
+  /**
+   * @return Position of e in the order, s.t. if (e1, e2) is in the
+   *         (acyclic) relation, Position(e1) < Position(e2); kInvalid if e is
+   *         not in the relation.
+   */
+  std::size_t Position(const Element& e) const {
+    const auto it = index_.find(e);
+    return it != index_.end() ? ord_[it->second] : kInvalid;
+  }
+
+  void Invalidate() {
+    dirty_ = true;
+    cycle_.clear();
+  }
+
+  /**
+   * Rebuilds the graph and order from rel.
+   */
+  void Rebuild(const Relation<Ts>& rel) {
+    nodes_.clear();
+    index_.clear();
+    succ_.clear();
+    pred_.clear();
+    ord_.clear();
+    next_ord_ = 0;
+    mark_.clear();
+    parent_.clear();
+    cycle_.clear();
+
+    for (const auto& tuples : rel.get()) {
+      const std::size_t n1 = Node(tuples.first);
+      for (const auto& e2 : tuples.second.get()) {
+        const std::size_t n2 = Node(e2);
+        succ_[n1].push_back(n2);
+        pred_[n2].push_back(n1);
+      }
+    }
+
+    // Kahn's algorithm.
+    std::vector<std::size_t> in_degree(nodes_.size());
+    std::vector<std::size_t> ready;
+    for (std::size_t n = 0; n < nodes_.size(); ++n) {
+      in_degree[n] = pred_[n].size();
+      if (in_degree[n] == 0) {
+        ready.push_back(n);
+      }
+    }
+
+    std::size_t next_ord = 0;
+    while (!ready.empty()) {
+      const std::size_t n = ready.back();
+      ready.pop_back();
+      ord_[n] = next_ord++;
+
+      for (const std::size_t succ : succ_[n]) {
+        if (--in_degree[succ] == 0) {
+          ready.push_back(succ);
         }
-      });
+      }
+    }
 
-      this->rels_.erase(this->rels_.end() - 2, this->rels_.end());
-      this->rels_.push_back(std::move(er));
+    if (next_ord != nodes_.size()) {
+      // Nodes on or behind cycles keep their initial (arbitrary) positions;
+      // the order is not maintained while cyclic.
+      SccDecomposition<Ts>(rel).FindCycle(&cycle_);
+      assert(!cycle_.empty());
     }
 
-    return *this;
+    dirty_ = false;
   }
 
-  Relation<Ts> Eval() const override {
-    Relation<Ts> er;
+  /**
+   * Updates the order after insertion of new edge (e1, e2).
+   */
+  void InsertEdge(const Element& e1, const Element& e2) {
+    assert(!dirty_);
 
-    if (this->rels_.empty()) {
-      return Relation<Ts>();
-    } else if (this->rels_.size() == 1) {
-      return this->rels_.back();
+    const std::size_t n1 = Node(e1);
+    const std::size_t n2 = Node(e2);
+    succ_[n1].push_back(n2);
+    pred_[n2].push_back(n1);
+
+    if (!cycle_.empty()) {
+      // Order no longer maintained.
+      return;
     }
 
-    const auto potential_domain = this->rels_.front().Domain();
-    const auto potential_range = this->rels_.back().Range();
+    if (n1 == n2) {
+      cycle_.push_back(e1);
+      cycle_.push_back(e1);
+      return;
+    }
 
-    for (const auto& e1 : potential_domain.get()) {
-      for (const auto& e2 : potential_range.get()) {
-        if (R(e1, e2)) {
-          er.Insert(e1, e2);
-        }
+    if (ord_[n1] < ord_[n2]) {
+      return;
+    }
+
+    // Affected region is [ord_[n2], ord_[n1]]: search forward from n2 and
+    // backward from n1 within it.
+    const std::size_t lower = ord_[n2];
+    const std::size_t upper = ord_[n1];
+
+    NewEpoch();
+    if (SearchForward(n2, n1, upper)) {
+      // Cycle: e1 -> e2 ->* e1
+      cycle_.push_back(e1);
+      for (std::size_t n = n1; n != n2; n = parent_[n]) {
+        cycle_.push_back(nodes_[n]);
       }
+      cycle_.push_back(e2);
+      std::reverse(cycle_.begin() + 1, cycle_.end());
+      return;
     }
 
-    return er;
+    SearchBackward(n1, lower);
+    Reorder();
   }
 
   /**
-   * Check if (e1, e2) is in the relation. This effectively does a search if
-   * there is an edge from e1 to e2.
-   *
-   * @param e1 First element.
-   * @param e2 Second element.
-   * @param path Optional; return path from e1 to e2.
-   * @return true if related, false otherwise.
+   * Updates the graph after erasure of edge (e1, e2); the order remains
+   * valid.
    */
-  bool R(const Element& e1, const Element& e2,
-         typename Relation<Ts>::Path* path = nullptr,
-         std::size_t seq = 0) const {
-    if (this->rels_.empty()) {
-      return false;
+  void EraseEdge(const Element& e1, const Element& e2) {
+    if (dirty_) {
+      return;
     }
 
-    assert(seq < this->rels_.size());
+    const std::size_t n1 = index_.find(e1)->second;
+    const std::size_t n2 = index_.find(e2)->second;
+    EraseFrom(&succ_[n1], n2);
+    EraseFrom(&pred_[n2], n1);
 
-    if (seq + 1 < this->rels_.size()) {
-      const auto& rel = this->rels_[seq];
-      std::size_t path_size = 0;
+    if (!cycle_.empty()) {
+      // The cycle may have been broken; the order is only partially valid.
+      Invalidate();
+    }
+  }
 
-      const Set<Ts> reach = rel.Reachable(e1);
-      for (const auto& e : reach.get()) {
-        if (path != nullptr) {
-          path_size = path->size();
-          rel.R(e1, e, path);  // true
-          path->pop_back();    // remove e
-        }
+ protected:
+  std::size_t Node(const Element& e) {
+    const auto it = index_.find(e);
+    if (it != index_.end()) {
+      return it->second;
+    }
 
-        if (R(e, e2, path, seq + 1)) {
+    const std::size_t n = nodes_.size();
+    index_[e] = n;
+    nodes_.push_back(e);
+    succ_.emplace_back();
+    pred_.emplace_back();
+    // Append to order.
+    ord_.push_back(next_ord_++);
+    mark_.push_back(0);
+    parent_.push_back(kInvalid);
+    return n;
+  }
+
+  static void EraseFrom(std::vector<std::size_t>* v, std::size_t n) {
+    const auto it = std::find(v->begin(), v->end(), n);
+    assert(it != v->end());
+    *it = v->back();
+    v->pop_back();
+  }
+
+  void NewEpoch() {
+    ++epoch_;
+    forward_.clear();
+    backward_.clear();
+  }
+
+  /**
+   * DFS from start over nodes with position <= upper.
+   *
+   * @return true if target was reached.
+   */
+  bool SearchForward(std::size_t start, std::size_t target,
+                     std::size_t upper) {
+    std::vector<std::size_t>& stack = stack_;
+    stack.clear();
+    stack.push_back(start);
+    mark_[start] = epoch_;
+
+    while (!stack.empty()) {
+      const std::size_t n = stack.back();
+      stack.pop_back();
+      forward_.push_back(n);
+
+      for (const std::size_t succ : succ_[n]) {
+        if (succ == target) {
+          parent_[target] = n;
           return true;
         }
 
-        if (path != nullptr) {
-          // e not connected to e2, remove all up to e1 (inclusive).
-          assert(path_size < path->size());
-          path->erase(path->begin() + path_size, path->end());
+        if (mark_[succ] != epoch_ && ord_[succ] < upper) {
+          mark_[succ] = epoch_;
+          parent_[succ] = n;
+          stack.push_back(succ);
         }
       }
-
-      return false;
     }
 
-    return this->rels_[seq].R(e1, e2, path);
+    return false;
   }
 
   /**
-   * Check if irreflexive.
-   *
-   * @param cyclic Optional parameter, in which the cycle is returned, if
-   *               result is false.
-   * @return true if irreflexive, false otherwise.
+   * DFS backward from start over nodes with position > lower.
    */
-  bool Irreflexive(typename Relation<Ts>::Path* cyclic = nullptr) const {
-    if (this->rels_.empty()) {
-      return true;
+  void SearchBackward(std::size_t start, std::size_t lower) {
+    std::vector<std::size_t>& stack = stack_;
+    stack.clear();
+    stack.push_back(start);
+    mark_[start] = epoch_;
+
+    while (!stack.empty()) {
+      const std::size_t n = stack.back();
+      stack.pop_back();
+      backward_.push_back(n);
+
+      for (const std::size_t pred : pred_[n]) {
+        if (mark_[pred] != epoch_ && ord_[pred] > lower) {
+          mark_[pred] = epoch_;
+          stack.push_back(pred);
+        }
+      }
     }
+  }
 
-    const auto domain = this->rels_.front().Domain();
-    for (const auto& e : domain.get()) {
-      if (R(e, e, cyclic)) {
-        return false;
-      }
+  /**
+   * Reassigns the positions of all visited nodes, s.t. all nodes found by
+   * the backward search precede all nodes found by the forward search, each
+   * keeping their relative order.
+   */
+  void Reorder() {
+    const auto by_ord = [this](std::size_t a, std::size_t b) {
+      return ord_[a] < ord_[b];
+    };
+    std::sort(forward_.begin(), forward_.end(), by_ord);
+    std::sort(backward_.begin(), backward_.end(), by_ord);
+
+    std::vector<std::size_t>& positions = stack_;
+    positions.clear();
+    for (const std::size_t n : backward_) {
+      positions.push_back(ord_[n]);
+    }
+    for (const std::size_t n : forward_) {
+      positions.push_back(ord_[n]);
     }
+    std::sort(positions.begin(), positions.end());
 
-    return true;
+    std::size_t i = 0;
+    for (const std::size_t n : backward_) {
+      ord_[n] = positions[i++];
+    }
+    for (const std::size_t n : forward_) {
+      ord_[n] = positions[i++];
+    }
   }
+
+  bool dirty_;
+  Path cycle_;
+
+  std::vector<Element> nodes_;
+  typename Ts::template MapContainer<std::size_t> index_;
+  std::vector<std::vector<std::size_t>> succ_;
+  std::vector<std::vector<std::size_t>> pred_;
+  std::vector<std::size_t> ord_;
+  std::size_t next_ord_;
+
+  // Search state.
+  std::vector<std::size_t> mark_;
+  std::vector<std::size_t> parent_;
+  std::vector<std::size_t> forward_;
+  std::vector<std::size_t> backward_;
+  std::vector<std::size_t> stack_;
+  std::size_t epoch_;
 };
 
 template <class Ts>
-inline RelationSeq<Ts> operator+(const RelationSeq<Ts>& lhs,
-                                 const Relation<Ts>& rhs) {
-  RelationSeq<Ts> res = lhs;
-  return res += rhs;
-}
+constexpr std::size_t OnlineOrder<Ts>::kInvalid;
 
 template <class Ts>
-inline RelationSeq<Ts> operator+(RelationSeq<Ts>&& lhs,
-                                 const Relation<Ts>& rhs) {
-  lhs += rhs;
+inline Relation<Ts> operator*(const Set<Ts>& lhs, const Set<Ts>& rhs) {
+  Relation<Ts> res;
+
+  for (const auto& e1 : lhs.get()) {
+    for (const auto& e2 : rhs.get()) {
+      res.Insert(e1, e2);
+    }
+  }
+
+  return res;
+}
+
+template <class Ts>
+inline Relation<Ts> operator|(const Relation<Ts>& lhs,
+                              const Relation<Ts>& rhs) {
+  Relation<Ts> res = lhs;
+  return res |= rhs;
+}
+
+template <class Ts>
+inline Relation<Ts> operator|(Relation<Ts>&& lhs, const Relation<Ts>& rhs) {
+  lhs |= rhs;
   return std::move(lhs);
 }
 
 template <class Ts>
-inline RelationSeq<Ts> operator+(const RelationSeq<Ts>& lhs,
-                                 Relation<Ts>&& rhs) {
-  RelationSeq<Ts> res = lhs;
-  return res += std::move(rhs);
+inline Relation<Ts> operator|(const Relation<Ts>& lhs, Relation<Ts>&& rhs) {
+  rhs |= lhs;
+  return std::move(rhs);
 }
 
 template <class Ts>
-inline RelationSeq<Ts> operator+(RelationSeq<Ts>&& lhs, Relation<Ts>&& rhs) {
-  lhs += std::move(rhs);
+inline Relation<Ts> operator|(Relation<Ts>&& lhs, Relation<Ts>&& rhs) {
+  lhs |= rhs;
   return std::move(lhs);
 }
 
 template <class Ts>
-inline RelationSeq<Ts> operator+(const RelationSeq<Ts>& lhs,
-                                 const RelationSeq<Ts>& rhs) {
-  RelationSeq<Ts> res = lhs;
-  return res += rhs;
+inline Relation<Ts> operator-(const Relation<Ts>& lhs,
+                              const Relation<Ts>& rhs) {
+  Relation<Ts> res = lhs;
+  return res -= rhs;
 }
 
 template <class Ts>
-inline RelationSeq<Ts> operator+(RelationSeq<Ts>&& lhs,
-                                 const RelationSeq<Ts>& rhs) {
-  lhs += rhs;
+inline Relation<Ts> operator-(Relation<Ts>&& lhs, const Relation<Ts>& rhs) {
+  lhs -= rhs;
   return std::move(lhs);
 }
 
 template <class Ts>
-inline RelationSeq<Ts> operator+(const RelationSeq<Ts>& lhs,
-                                 RelationSeq<Ts>&& rhs) {
-  RelationSeq<Ts> res = lhs;
-  return res += rhs;
+inline Relation<Ts> operator-(const Relation<Ts>& lhs, Relation<Ts>&& rhs) {
+  Relation<Ts> res = lhs;
+  return res -= rhs;
 }
 
 template <class Ts>
-inline RelationSeq<Ts> operator+(RelationSeq<Ts>&& lhs, RelationSeq<Ts>&& rhs) {
-  lhs += rhs;
+inline Relation<Ts> operator-(Relation<Ts>&& lhs, Relation<Ts>&& rhs) {
+  lhs -= rhs;
+  return std::move(lhs);
+}
+
+template <class Ts>
+inline Relation<Ts> operator&(const Relation<Ts>& lhs,
+                              const Relation<Ts>& rhs) {
+  Relation<Ts> res;
+
+  const auto lhs_domain = lhs.Domain();
+  for (const auto& e : lhs_domain.get()) {
+    Set<Ts> intersect = lhs.Reachable(e) & rhs.Reachable(e);
+    // insert checks if empty or not
+    res.Insert(e, std::move(intersect));
+  }
+
+  return res;
+}
+
+template <class Ts>
+inline Relation<Ts> operator&(Relation<Ts>&& lhs, const Relation<Ts>& rhs) {
+  lhs &= rhs;
+  return std::move(lhs);
+}
+
+template <class Ts>
+inline Relation<Ts> operator&(const Relation<Ts>& lhs, Relation<Ts>&& rhs) {
+  rhs &= lhs;
+  return std::move(rhs);
+}
+
+template <class Ts>
+inline Relation<Ts> operator&(Relation<Ts>&& lhs, Relation<Ts>&& rhs) {
+  lhs &= rhs;
   return std::move(lhs);
 }
 
 /**
- * @brief Helper class to instantiate types used by Set, Relation, etc.
- *
- * Set, Relation, etc. take a template parameter that provides Element, and
- * SetContainer or MapContainer; this class can be used to instantiate a class
- * to be passed as the template parameter to Set and Relation.
+ * Relation operator base class.
+ * No derived class shall define a destructor!
  */
-template <class E, class Hash = typename E::Hash>
-struct Types {
+template <class Ts>
+class RelationOp {
+ public:
+  RelationOp() {}
+
+  explicit RelationOp(std::vector<Relation<Ts>> rels)
+      : rels_(std::move(rels)) {}
+
+  /*//virtual ~RelationOp()
+   *
+   * No destructor, so compiler can implicitly create move constructor and
+   * assignment operators.
+  */
+
+  /**
+   * Evaluate in-place, where postcondition is rels_.size() <= 1. This avoids
+   * some of the copying overhead of Eval(), and can therefore be more
+   * efficient.
+   *
+   * @return Reference to this object.
+   */
+  virtual RelationOp& EvalInplace() = 0;
+
+  /**
+   * Evaluate operator, computing the result of the opertor.
+   *
+   * @return Relation representing view of operator.
+   */
+  virtual Relation<Ts> Eval() const = 0;
+
+  void Clear() { rels_.clear(); }
+
+  /**
+   * Evaluate operator in-place, and clearing it, returning the evaluated
+   * Relation. Optimized for move, and should be used where the operator is
+   * used as a temporary.
+   *
+   * @return Relation representing view of operator before call.
+   */
+  Relation<Ts> EvalClear() {
+    if (rels_.empty()) {
+      // Already cleared
+      return Relation<Ts>();
+    }
+
+    EvalInplace();
+    assert(rels_.size() == 1);
+
+    Relation<Ts> result = std::move(rels_.back());
+    rels_.clear();
+    return result;  // NRVO
+  }
+
+ protected:
+  void Add(const Relation<Ts>& er) { rels_.push_back(er); }
+
+  void Add(Relation<Ts>&& er) { rels_.push_back(std::move(er)); }
+
+  void Add(const std::vector<Relation<Ts>>& rels) {
+    rels_.reserve(rels_.size() + rels.size());
+    rels_.insert(rels_.end(), rels.begin(), rels.end());
+  }
+
+ protected:
+  std::vector<Relation<Ts>> rels_;
+};
+
+/**
+ * Operator ";".
+ */
+template <class Ts>
+class RelationSeq : public RelationOp<Ts> {
+ public:
+  typedef typename Ts::Element Element;
+
+  RelationSeq() {}
+
+  explicit RelationSeq(std::vector<Relation<Ts>> v)
+      : RelationOp<Ts>(std::move(v)) {}
+
+  RelationSeq& operator+=(const Relation<Ts>& rhs) {
+    this->Add(rhs);
+    return *this;
+  }
+
+  RelationSeq& operator+=(Relation<Ts>&& rhs) {
+    this->Add(std::move(rhs));
+    return *this;
+  }
+
+  RelationSeq& operator+=(const RelationSeq& rhs) {
+    this->Add(rhs.rels_);
+    return *this;
+  }
+
+  RelationOp<Ts>& EvalInplace() override {
+    while (this->rels_.size() > 1) {
+      std::size_t from_idx = this->rels_.size() - 2;
+      const auto& first = this->rels_[from_idx];
+      Relation<Ts> last_evald;
+      const Relation<Ts>& last = Rows(this->rels_.back(), &last_evald);
+
+      Relation<Ts> er;
+
+      first.for_each([&er, &last](const Element& e1, const Element& e2) {
+        const auto row = last.get().find(e2);
+        if (row != last.get().end()) {
+          er.Insert(e1, row->second);
+        }
+      });
+
+      this->rels_.erase(this->rels_.end() - 2, this->rels_.end());
+      this->rels_.push_back(std::move(er));
+    }
+
+    return *this;
+  }
+
+  Relation<Ts> Eval() const override {
+    Relation<Ts> er;
+
+    if (this->rels_.empty()) {
+      return Relation<Ts>();
+    } else if (this->rels_.size() == 1) {
+      return this->rels_.back();
+    }
+
+    std::vector<Relation<Ts>> evald;
+    const auto steps = EvalSteps(&evald);
+
+    Levels levels;
+    const auto domain = this->rels_.front().Domain();
+    for (const auto& e1 : domain.get()) {
+      if (Propagate(e1, steps, &levels)) {
+        er.Insert(e1, std::move(levels.back()));
+      }
+    }
+
+    return er;
+  }
+
+  /**
+   * Check if (e1, e2) is in the relation. This effectively does a search if
+   * there is an edge from e1 to e2.
+   *
+   * @param e1 First element.
+   * @param e2 Second element.
+   * @param path Optional; return path from e1 to e2.
+   * @param seq Index of first relation of the sequence to consider.
+   * @return true if related, false otherwise.
+   */
+  bool R(const Element& e1, const Element& e2,
+         typename Relation<Ts>::Path* path = nullptr,
+         std::size_t seq = 0) const {
+    if (this->rels_.empty()) {
+      return false;
+    }
+
+    assert(seq < this->rels_.size());
+
+    // Single query: rather than evaluating each relation, propagate via
+    // Reachable.
+    std::vector<Relation<Ts>> reached(this->rels_.size() - seq);
+    Steps steps;
+    for (std::size_t i = seq; i < this->rels_.size(); ++i) {
+      const auto& rel = this->rels_[i];
+      Relation<Ts>& rows = reached[i - seq];
+      typename Relation<Ts>::SearchState state;
+
+      // Rows are computed lazily, only for elements in the frontier.
+      steps.push_back(StepFunc([&rel, &rows, state](const Element& e) mutable
+                               -> const Set<Ts>* {
+        auto row = rows.get().find(e);
+        if (row == rows.get().end()) {
+          rows.Insert(e, rel.Reachable(e, &state));
+          row = rows.get().find(e);
+          if (row == rows.get().end()) {
+            return nullptr;
+          }
+        }
+
+        return &row->second;
+      }));
+    }
+
+    Levels levels;
+    if (!Propagate(e1, steps, &levels) || !levels.back().Contains(e2)) {
+      return false;
+    }
+
+    if (path != nullptr) {
+      GetPath(levels, seq, e2, path);
+    }
+
+    return true;
+  }
+
+  /**
+   * Check if irreflexive: for every element of the domain of the first
+   * relation, propagates the set of reachable elements through the sequence,
+   * and checks if it contains the start element.
+   *
+   * @param cyclic Optional parameter, in which the cycle is returned, if
+   *               result is false.
+   * @return true if irreflexive, false otherwise.
+   */
+  bool Irreflexive(typename Relation<Ts>::Path* cyclic = nullptr) const {
+    if (this->rels_.empty()) {
+      return true;
+    }
+
+    std::vector<Relation<Ts>> evald;
+    const auto steps = EvalSteps(&evald);
+
+    Levels levels;
+    const auto domain = this->rels_.front().Domain();
+    for (const auto& e : domain.get()) {
+      if (Propagate(e, steps, &levels) && levels.back().Contains(e)) {
+        if (cyclic != nullptr) {
+          GetPath(levels, 0, e, cyclic);
+        }
+
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+ protected:
+  /**
+   * Sets of elements reachable after each relation of the sequence: levels[0]
+   * is the start, levels[i + 1] is reachable from levels[i] via relation i.
+   */
+  typedef std::vector<Set<Ts>> Levels;
+
+  /**
+   * A step maps an element to the set of elements reachable from it via one
+   * relation (nullptr if none).
+   */
+  typedef std::function<const Set<Ts>*(const Element&)> StepFunc;
+  typedef std::vector<StepFunc> Steps;
+
+  /**
+   * @return rel if it has no properties (its rows are its tuples), otherwise
+   *         rel evaluated into evald.
+   */
+  static const Relation<Ts>& Rows(const Relation<Ts>& rel,
+                                  Relation<Ts>* evald) {
+    if (!rel.props()) {
+      return rel;
+    }
+
+    *evald = rel.Eval();
+    return *evald;
+  }
+
+  /**
+   * @return Steps looking up rows of each relation, with properties
+   *         evaluated once (into evald) up front.
+   */
+  Steps EvalSteps(std::vector<Relation<Ts>>* evald) const {
+    // Must not reallocate after taking references.
+    evald->resize(this->rels_.size());
+
+    Steps steps;
+    for (std::size_t i = 0; i < this->rels_.size(); ++i) {
+      const Relation<Ts>& rel = Rows(this->rels_[i], &(*evald)[i]);
+      steps.push_back(StepFunc([&rel](const Element& e) -> const Set<Ts>* {
+        const auto row = rel.get().find(e);
+        return row != rel.get().end() ? &row->second : nullptr;
+      }));
+    }
+
+    return steps;
+  }
+
+  /**
+   * Propagates the frontier reachable from start through all steps.
+   *
+   * @return true if the final level is non-empty.
+   */
+  static bool Propagate(const Element& start, const Steps& steps,
+                        Levels* levels) {
+    levels->resize(steps.size() + 1);
+    (*levels)[0].Clear();
+    (*levels)[0].Insert(start);
+
+    for (std::size_t i = 0; i < steps.size(); ++i) {
+      Set<Ts>& next = (*levels)[i + 1];
+      next.Clear();
+
+      for (const auto& e : (*levels)[i].get()) {
+        const Set<Ts>* row = steps[i](e);
+        if (row != nullptr) {
+          next |= *row;
+        }
+      }
+
+      if (next.empty()) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * Get path from the start (levels[0]) to end, which must be in the final
+   * level, by walking back through the levels; each relation's segment is
+   * obtained from the relation itself (with properties unevaluated).
+   */
+  void GetPath(const Levels& levels, std::size_t seq, const Element& end,
+               typename Relation<Ts>::Path* out) const {
+    typename Relation<Ts>::SearchState state;
+
+    // Elements via which the path passes, from end to start.
+    std::vector<Element> via;
+    via.push_back(end);
+
+    for (std::size_t i = levels.size() - 1; i-- > 0;) {
+      const auto& rel = this->rels_[seq + i];
+      for (const auto& e : levels[i].get()) {
+        if (rel.R(e, via.back(), nullptr, &state)) {
+          via.push_back(e);
+          break;
+        }
+      }
+    }
+
+    assert(via.size() == levels.size());
+    std::reverse(via.begin(), via.end());
+
+    for (std::size_t i = 0; i + 1 < via.size(); ++i) {
+      typename Relation<Ts>::Path segment;
+      this->rels_[seq + i].R(via[i], via[i + 1], &segment, &state);
+
+      // Consecutive segments share their first and last elements.
+      out->insert(out->end(), segment.begin() + (i == 0 ? 0 : 1),
+                  segment.end());
+    }
+  }
+};
+
+template <class Ts>
+inline RelationSeq<Ts> operator+(const RelationSeq<Ts>& lhs,
+                                 const Relation<Ts>& rhs) {
+  RelationSeq<Ts> res = lhs;
+  return res += rhs;
+}
+
+template <class Ts>
+inline RelationSeq<Ts> operator+(RelationSeq<Ts>&& lhs,
+                                 const Relation<Ts>& rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+template <class Ts>
+inline RelationSeq<Ts> operator+(const RelationSeq<Ts>& lhs,
+                                 Relation<Ts>&& rhs) {
+  RelationSeq<Ts> res = lhs;
+  return res += std::move(rhs);
+}
+
+template <class Ts>
+inline RelationSeq<Ts> operator+(RelationSeq<Ts>&& lhs, Relation<Ts>&& rhs) {
+  lhs += std::move(rhs);
+  return std::move(lhs);
+}
+
+template <class Ts>
+inline RelationSeq<Ts> operator+(const RelationSeq<Ts>& lhs,
+                                 const RelationSeq<Ts>& rhs) {
+  RelationSeq<Ts> res = lhs;
+  return res += rhs;
+}
+
+template <class Ts>
+inline RelationSeq<Ts> operator+(RelationSeq<Ts>&& lhs,
+                                 const RelationSeq<Ts>& rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+template <class Ts>
+inline RelationSeq<Ts> operator+(const RelationSeq<Ts>& lhs,
+                                 RelationSeq<Ts>&& rhs) {
+  RelationSeq<Ts> res = lhs;
+  return res += rhs;
+}
+
+template <class Ts>
+inline RelationSeq<Ts> operator+(RelationSeq<Ts>&& lhs, RelationSeq<Ts>&& rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+/**
+ * @brief Helper class to instantiate types used by Set, Relation, etc.
+ *
+ * Set, Relation, etc. take a template parameter that provides Element, and
+ * SetContainer or MapContainer; this class can be used to instantiate a class
+ * to be passed as the template parameter to Set and Relation.
+ */
+template <class E, class Hash = typename E::Hash,
+          class Alloc = std::allocator<E>>
+struct Types {
+  typedef E Element;
+
+  typedef std::unordered_set<Element, Hash, std::equal_to<Element>, Alloc>
+      SetContainer;
+
+  template <class T>
+  using MapContainer = std::unordered_map<
+      Element, T, Hash, std::equal_to<Element>,
+      typename std::allocator_traits<Alloc>::template rebind_alloc<
+          std::pair<const Element, T>>>;
+};
+
+/**
+ * @brief Allocator which allocates from Arena::Current(), or from the heap if
+ * there is none.
+ *
+ * Each allocation is tagged with its arena, s.t. deallocation does not depend
+ * on the arena current at that point. Containers must not outlive (or be
+ * cleared after) the Release() of an arena they allocated from.
+ */
+template <class T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef std::size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+
+  template <class U>
+  struct rebind {
+    typedef ArenaAllocator<U> other;
+  };
+
+  ArenaAllocator() {}
+
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>&) {}  // NOLINT
+
+  T* allocate(std::size_t n, const void* = nullptr) {
+    static_assert(alignof(T) <= Arena::kAlign, "Unsupported alignment");
+
+    const std::size_t size = n * sizeof(T) + Arena::kAlign;
+    Arena* arena = Arena::Current();
+    char* base = static_cast<char*>(arena != nullptr ? arena->Allocate(size)
+                                                     : ::operator new(size));
+    *reinterpret_cast<Arena**>(base) = arena;
+    return reinterpret_cast<T*>(base + Arena::kAlign);
+  }
+
+  void deallocate(T* p, std::size_t) {
+    char* base = reinterpret_cast<char*>(p) - Arena::kAlign;
+    if (*reinterpret_cast<Arena**>(base) == nullptr) {
+      ::operator delete(base);
+    }
+  }
+
+  template <class U, class... Args>
+  void construct(U* p, Args&&... args) {
+    ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+  }
+
+  template <class U>
+  void destroy(U* p) {
+    p->~U();
+  }
+
+  T* address(T& x) const { return &x; }
+
+  const T* address(const T& x) const { return &x; }
+
+  std::size_t max_size() const {
+    return (std::numeric_limits<std::size_t>::max() - Arena::kAlign) /
+           sizeof(T);
+  }
+
+  template <class U>
+  bool operator==(const ArenaAllocator<U>&) const {
+    return true;
+  }
+
+  template <class U>
+  bool operator!=(const ArenaAllocator<U>&) const {
+    return false;
+  }
+};
+
+/**
+ * @brief Maps elements to dense indices, and indices back to elements.
+ *
+ * Indices are assigned in order of first insertion, starting at 0. References
+ * returned by Get() remain valid until Clear().
+ */
+template <class E, class Hash = typename E::Hash, class Index = std::size_t>
+class Interner {
+ public:
+  typedef E Element;
+  typedef Index IndexType;
+
+  static constexpr Index kInvalid = std::numeric_limits<Index>::max();
+
+  /**
+   * Process-wide instance, as used by InternIndexer if there is no Current()
+   * instance.
+   */
+  static Interner& Global() {
+    static Interner global;
+    return global;
+  }
+
+  /**
+   * The instance used by InternIndexer in the current thread; nullptr if
+   * none (see InternScope).
+   */
+  static Interner*& Current() {
+    static MC2LIB_THREAD_LOCAL Interner* current = nullptr;
+    return current;
+  }
+
+  /**
+   * Insert element, if it does not exist yet.
+   *
+   * @param e Element to be inserted.
+   * @return Index of element.
+   */
+  Index Insert(const Element& e) {
+    auto result = index_.emplace(e, static_cast<Index>(elements_.size()));
+    if (result.second) {
+      assert(elements_.size() < kInvalid);
+      elements_.push_back(e);
+    }
+
+    return result.first->second;
+  }
+
+  /**
+   * @return Index of e if it exists; kInvalid otherwise.
+   */
+  Index Find(const Element& e) const {
+    const auto it = index_.find(e);
+    return it != index_.end() ? it->second : kInvalid;
+  }
+
+  bool Contains(const Element& e) const {
+    return index_.find(e) != index_.end();
+  }
+
+  const Element& Get(Index idx) const {
+    assert(idx < elements_.size());
+    return elements_[idx];
+  }
+
+  std::size_t size() const { return elements_.size(); }
+
+  bool empty() const { return elements_.empty(); }
+
+  void Clear() {
+    index_.clear();
+    elements_.clear();
+  }
+
+ protected:
+  std::unordered_map<Element, Index, Hash> index_;
+
+  // Deque, as we must not invalidate references on insertion.
+  std::deque<Element> elements_;
+};
+
+template <class E, class Hash, class Index>
+constexpr Index Interner<E, Hash, Index>::kInvalid;
+
+/**
+ * Indexer used by DenseTypes by default: maps elements to indices via
+ * Table::Current(), or via Table::Global() if there is none.
+ *
+ * Not synchronized: a table may only be used concurrently once all elements
+ * used have been interned, as Index() then only reads the table.
+ */
+template <class E, class Hash = typename E::Hash,
+          class Table = Interner<E, Hash>>
+struct InternIndexer {
+  static constexpr std::size_t kInvalid = Table::kInvalid;
+
+  static std::size_t Index(const E& e) {
+    Table& table = GetTable();
+    const std::size_t idx = table.Find(e);
+    return idx != kInvalid ? idx : table.Insert(e);
+  }
+
+  static std::size_t Find(const E& e) { return GetTable().Find(e); }
+
+  static const E& Get(std::size_t idx) {
+    return GetTable().Get(static_cast<typename Table::IndexType>(idx));
+  }
+
+ private:
+  static Table& GetTable() {
+    Table* table = Table::Current();
+    return table != nullptr ? *table : Table::Global();
+  }
+};
+
+template <class E, class Hash, class Table>
+constexpr std::size_t InternIndexer<E, Hash, Table>::kInvalid;
+
+/**
+ * @brief Sets Table::Current() for the lifetime of this object.
+ *
+ * Elements added to dense containers (see DenseTypes) are then interned in
+ * table, e.g. per execution, rather than in the global table, which grows
+ * with every distinct element ever added. Containers must only be used while
+ * the table they were populated with is current, and not after its Clear().
+ * As Current() is per thread, tasks running on other threads must set the
+ * same table.
+ */
+template <class Table>
+class InternScope {
+ public:
+  explicit InternScope(Table* table) : prev_(Table::Current()) {
+    Table::Current() = table;
+  }
+
+  ~InternScope() { Table::Current() = prev_; }
+
+  InternScope(const InternScope&) = delete;
+
+  InternScope& operator=(const InternScope&) = delete;
+
+ private:
+  Table* prev_;
+};
+
+/**
+ * Indexer for elements which already are dense indices (e.g. unsigned
+ * integers assigned by an Interner).
+ */
+template <class E>
+struct IdentityIndexer {
+  static constexpr std::size_t kInvalid =
+      std::numeric_limits<std::size_t>::max();
+
+  static std::size_t Index(E e) { return static_cast<std::size_t>(e); }
+
+  static std::size_t Find(E e) { return static_cast<std::size_t>(e); }
+
+  static E Get(std::size_t idx) { return static_cast<E>(idx); }
+};
+
+template <class E>
+constexpr std::size_t IdentityIndexer<E>::kInvalid;
+
+/**
+ * @return Index of first set bit in words at or after idx; words.size() * 64
+ *         if none exists.
+ */
+inline std::size_t NextSetBit(const std::vector<std::uint64_t>& words,
+                              std::size_t idx) {
+  const std::size_t end = words.size() * 64;
+
+  while (idx < end) {
+    const std::uint64_t w = words[idx / 64] >> (idx % 64);
+    if (w != 0) {
+      return idx + __builtin_ctzll(w);
+    }
+
+    idx = (idx / 64 + 1) * 64;
+  }
+
+  return end;
+}
+
+/**
+ * @brief Set container backed by a bit vector over dense element indices.
+ *
+ * Provides the subset of the std::unordered_set interface used by Set; bulk
+ * operations (union, difference, intersection, subset) work on 64 elements
+ * at a time.
+ */
+template <class E, class Indexer>
+class DenseSetContainer {
+ public:
+  typedef E key_type;
+  typedef E value_type;
+  typedef std::size_t size_type;
+
+  class const_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef E value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const E* pointer;
+    // Either const E& or E, depending on Indexer.
+    typedef decltype(Indexer::Get(0)) reference;
+
+    const_iterator() : words_(nullptr), idx_(0) {}
+
+    const_iterator(const std::vector<std::uint64_t>* words, std::size_t idx)
+        : words_(words), idx_(NextSetBit(*words, idx)) {}
+
+    reference operator*() const { return Indexer::Get(idx_); }
+
+    pointer operator->() const { return &Indexer::Get(idx_); }
+
+    const_iterator& operator++() {
+      idx_ = NextSetBit(*words_, idx_ + 1);
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const const_iterator& rhs) const {
+      return idx_ == rhs.idx_;
+    }
+
+    bool operator!=(const const_iterator& rhs) const {
+      return idx_ != rhs.idx_;
+    }
+
+    std::size_t index() const { return idx_; }
+
+   private:
+    const std::vector<std::uint64_t>* words_;
+    std::size_t idx_;
+  };
+
+  typedef const_iterator iterator;
+
+  DenseSetContainer() : size_(0) {}
+
+  DenseSetContainer(std::initializer_list<E> il) : size_(0) {
+    insert(il.begin(), il.end());
+  }
+
+  const_iterator begin() const { return const_iterator(&words_, 0); }
+
+  const_iterator end() const {
+    return const_iterator(&words_, words_.size() * 64);
+  }
+
+  std::pair<iterator, bool> insert(const E& e) {
+    const std::size_t idx = Indexer::Index(e);
+
+    if (words_.size() <= idx / 64) {
+      words_.resize(idx / 64 + 1, 0);
+    }
+
+    const std::uint64_t bit = static_cast<std::uint64_t>(1) << (idx % 64);
+    const bool inserted = (words_[idx / 64] & bit) == 0;
+    if (inserted) {
+      words_[idx / 64] |= bit;
+      ++size_;
+    }
+
+    return std::make_pair(const_iterator(&words_, idx), inserted);
+  }
+
+  template <class InputIt>
+  void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      insert(*first);
+    }
+  }
+
+  template <class... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    return insert(E(std::forward<Args>(args)...));
+  }
+
+  size_type erase(const E& e) {
+    const std::size_t idx = Indexer::Find(e);
+    if (!Test(idx)) {
+      return 0;
+    }
+
+    Reset(idx);
+    return 1;
+  }
+
+  iterator erase(const_iterator it) {
+    Reset(it.index());
+    return const_iterator(&words_, it.index() + 1);
+  }
+
+  const_iterator find(const E& e) const {
+    const std::size_t idx = Indexer::Find(e);
+    return Test(idx) ? const_iterator(&words_, idx) : end();
+  }
+
+  size_type count(const E& e) const { return Test(Indexer::Find(e)) ? 1 : 0; }
+
+  void clear() {
+    words_.clear();
+    size_ = 0;
+  }
+
+  size_type size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  bool operator==(const DenseSetContainer& rhs) const {
+    if (size_ != rhs.size_) {
+      return false;
+    }
+
+    // Trailing words may differ in length, but must then be zero.
+    const std::size_t common = std::min(words_.size(), rhs.words_.size());
+    for (std::size_t i = 0; i < common; ++i) {
+      if (words_[i] != rhs.words_[i]) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool operator!=(const DenseSetContainer& rhs) const {
+    return !(*this == rhs);
+  }
+
+  friend void ContainerUnion(DenseSetContainer* lhs,
+                             const DenseSetContainer& rhs) {
+    if (lhs->words_.size() < rhs.words_.size()) {
+      lhs->words_.resize(rhs.words_.size(), 0);
+    }
+
+    for (std::size_t i = 0; i < rhs.words_.size(); ++i) {
+      lhs->words_[i] |= rhs.words_[i];
+    }
+
+    lhs->Recount();
+  }
+
+  friend void ContainerDifference(DenseSetContainer* lhs,
+                                  const DenseSetContainer& rhs) {
+    const std::size_t common = std::min(lhs->words_.size(), rhs.words_.size());
+    for (std::size_t i = 0; i < common; ++i) {
+      lhs->words_[i] &= ~rhs.words_[i];
+    }
+
+    lhs->Recount();
+  }
+
+  friend void ContainerIntersection(DenseSetContainer* lhs,
+                                    const DenseSetContainer& rhs) {
+    if (lhs->words_.size() > rhs.words_.size()) {
+      lhs->words_.resize(rhs.words_.size());
+    }
+
+    for (std::size_t i = 0; i < lhs->words_.size(); ++i) {
+      lhs->words_[i] &= rhs.words_[i];
+    }
+
+    lhs->Recount();
+  }
+
+  friend bool ContainerSubsetEq(const DenseSetContainer& lhs,
+                                const DenseSetContainer& rhs) {
+    if (lhs.size_ > rhs.size_) return false;
+
+    for (std::size_t i = 0; i < lhs.words_.size(); ++i) {
+      const std::uint64_t r = i < rhs.words_.size() ? rhs.words_[i] : 0;
+      if ((lhs.words_[i] & ~r) != 0) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  bool Test(std::size_t idx) const {
+    return idx / 64 < words_.size() &&
+           (words_[idx / 64] & (static_cast<std::uint64_t>(1) << (idx % 64)));
+  }
+
+  void Reset(std::size_t idx) {
+    assert(Test(idx));
+    words_[idx / 64] &= ~(static_cast<std::uint64_t>(1) << (idx % 64));
+    --size_;
+  }
+
+  void Recount() {
+    size_ = 0;
+    for (const auto w : words_) {
+      size_ += __builtin_popcountll(w);
+    }
+  }
+
+  std::vector<std::uint64_t> words_;
+  std::size_t size_;
+};
+
+/**
+ * @brief Map container with slots indexed by dense element indices.
+ *
+ * Provides the subset of the std::unordered_map interface used by Relation.
+ * Unlike std::unordered_map, references to values are invalidated when a new
+ * key with a larger index than all existing keys is inserted.
+ */
+template <class E, class T, class Indexer>
+class DenseMapContainer {
+ public:
+  typedef E key_type;
+  typedef T mapped_type;
+  typedef std::pair<E, T> value_type;
+  typedef std::size_t size_type;
+
+  template <class V, class Slots>
+  class Iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef V value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef V* pointer;
+    typedef V& reference;
+
+    Iterator() : slots_(nullptr), used_(nullptr), idx_(0) {}
+
+    Iterator(Slots* slots, const std::vector<std::uint64_t>* used,
+             std::size_t idx)
+        : slots_(slots), used_(used), idx_(NextSetBit(*used, idx)) {}
+
+    template <class V2, class Slots2>
+    Iterator(const Iterator<V2, Slots2>& other)  // NOLINT
+        : slots_(other.slots_), used_(other.used_), idx_(other.idx_) {}
+
+    reference operator*() const { return (*slots_)[idx_]; }
+
+    pointer operator->() const { return &(*slots_)[idx_]; }
+
+    Iterator& operator++() {
+      idx_ = NextSetBit(*used_, idx_ + 1);
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator result = *this;
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator& rhs) const { return idx_ == rhs.idx_; }
+
+    bool operator!=(const Iterator& rhs) const { return idx_ != rhs.idx_; }
+
+    std::size_t index() const { return idx_; }
+
+   private:
+    template <class V2, class Slots2>
+    friend class Iterator;
+
+    Slots* slots_;
+    const std::vector<std::uint64_t>* used_;
+    std::size_t idx_;
+  };
+
+  typedef Iterator<value_type, std::vector<value_type>> iterator;
+  typedef Iterator<const value_type, const std::vector<value_type>>
+      const_iterator;
+
+  DenseMapContainer() : size_(0) {}
+
+  iterator begin() { return iterator(&slots_, &used_, 0); }
+
+  iterator end() { return iterator(&slots_, &used_, used_.size() * 64); }
+
+  const_iterator begin() const { return const_iterator(&slots_, &used_, 0); }
+
+  const_iterator end() const {
+    return const_iterator(&slots_, &used_, used_.size() * 64);
+  }
+
+  T& operator[](const E& e) {
+    const std::size_t idx = Indexer::Index(e);
+
+    if (slots_.size() <= idx) {
+      slots_.resize(idx + 1);
+      used_.resize(idx / 64 + 1, 0);
+    }
+
+    if (!Test(idx)) {
+      used_[idx / 64] |= static_cast<std::uint64_t>(1) << (idx % 64);
+      slots_[idx].first = e;
+      ++size_;
+    }
+
+    return slots_[idx].second;
+  }
+
+  iterator find(const E& e) {
+    const std::size_t idx = Indexer::Find(e);
+    return Test(idx) ? iterator(&slots_, &used_, idx) : end();
+  }
+
+  const_iterator find(const E& e) const {
+    const std::size_t idx = Indexer::Find(e);
+    return Test(idx) ? const_iterator(&slots_, &used_, idx) : end();
+  }
+
+  size_type count(const E& e) const { return Test(Indexer::Find(e)) ? 1 : 0; }
+
+  size_type erase(const E& e) {
+    const std::size_t idx = Indexer::Find(e);
+    if (!Test(idx)) {
+      return 0;
+    }
+
+    Reset(idx);
+    return 1;
+  }
+
+  iterator erase(const_iterator it) {
+    Reset(it.index());
+    return iterator(&slots_, &used_, it.index() + 1);
+  }
+
+  void clear() {
+    slots_.clear();
+    used_.clear();
+    size_ = 0;
+  }
+
+  size_type size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  bool operator==(const DenseMapContainer& rhs) const {
+    if (size_ != rhs.size_) {
+      return false;
+    }
+
+    for (auto it = begin(); it != end(); ++it) {
+      if (!rhs.Test(it.index()) ||
+          !(it->second == rhs.slots_[it.index()].second)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool operator!=(const DenseMapContainer& rhs) const {
+    return !(*this == rhs);
+  }
+
+ private:
+  bool Test(std::size_t idx) const {
+    return idx / 64 < used_.size() &&
+           (used_[idx / 64] & (static_cast<std::uint64_t>(1) << (idx % 64)));
+  }
+
+  void Reset(std::size_t idx) {
+    assert(Test(idx));
+    used_[idx / 64] &= ~(static_cast<std::uint64_t>(1) << (idx % 64));
+    slots_[idx].second = T();
+    --size_;
+  }
+
+  std::vector<value_type> slots_;
+  std::vector<std::uint64_t> used_;
+  std::size_t size_;
+};
+
+/**
+ * @brief Dense bit-matrix alternative to Types.
+ *
+ * Elements are mapped to dense indices via Indexer (by default via the global
+ * Interner), s.t. a Set is a bit vector and a Relation is a vector of such
+ * rows. Set operations, and therefore Relation union, intersection,
+ * difference and composition, operate on 64 elements at a time.
+ *
+ * Best suited if the universe of elements is small, e.g. the events of a few
+ * hundred operations; since rows are sized according to the largest index
+ * they contain, unrelated uses should intern their elements in separate
+ * tables (see InternScope).
+ */
+template <class E, class Hash = typename E::Hash,
+          class Indexer = InternIndexer<E, Hash>>
+struct DenseTypes {
+  typedef E Element;
+
+  typedef DenseSetContainer<Element, Indexer> SetContainer;
+
+  template <class T>
+  using MapContainer = DenseMapContainer<Element, T, Indexer>;
+};
+
+/**
+ * @brief Open-addressing hash table storing values inline, as used by
+ * FlatSetContainer and FlatMapContainer.
+ *
+ * Slots are kept in a single vector of a power-of-two size, and collisions
+ * are resolved by linear probing. Erased slots are marked as deleted rather
+ * than being moved, s.t. erasing does not move other elements; deleted slots
+ * are reclaimed on rehash. Values must be default constructible.
+ */
+template <class K, class V, class Hash>
+class FlatHashTable {
+ public:
+  typedef K key_type;
+  typedef V value_type;
+  typedef std::size_t size_type;
+
+  template <class V2, class Table>
+  class Iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef V value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef V2* pointer;
+    typedef V2& reference;
+
+    Iterator() : table_(nullptr), idx_(0) {}
+
+    Iterator(Table* table, std::size_t idx)
+        : table_(table), idx_(table->NextFull(idx)) {}
+
+    template <class V3, class Table2>
+    Iterator(const Iterator<V3, Table2>& other)  // NOLINT
+        : table_(other.table_), idx_(other.idx_) {}
+
+    reference operator*() const { return table_->slots_[idx_]; }
+
+    pointer operator->() const { return &table_->slots_[idx_]; }
+
+    Iterator& operator++() {
+      idx_ = table_->NextFull(idx_ + 1);
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator result = *this;
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator& rhs) const { return idx_ == rhs.idx_; }
+
+    bool operator!=(const Iterator& rhs) const { return idx_ != rhs.idx_; }
+
+    std::size_t index() const { return idx_; }
+
+   private:
+    template <class V3, class Table2>
+    friend class Iterator;
+
+    Table* table_;
+    std::size_t idx_;
+  };
+
+  FlatHashTable() : size_(0), used_(0), shift_(64) {}
+
+  FlatHashTable(const FlatHashTable&) = default;
+
+  FlatHashTable(FlatHashTable&& rhs)
+      : slots_(std::move(rhs.slots_)),
+        ctrl_(std::move(rhs.ctrl_)),
+        size_(rhs.size_),
+        used_(rhs.used_),
+        shift_(rhs.shift_) {
+    rhs.Reset();
+  }
+
+  FlatHashTable& operator=(const FlatHashTable&) = default;
+
+  FlatHashTable& operator=(FlatHashTable&& rhs) {
+    if (this != &rhs) {
+      slots_ = std::move(rhs.slots_);
+      ctrl_ = std::move(rhs.ctrl_);
+      size_ = rhs.size_;
+      used_ = rhs.used_;
+      shift_ = rhs.shift_;
+      rhs.Reset();
+    }
+
+    return *this;
+  }
+
+  size_type count(const K& k) const { return FindIndex(k) != npos() ? 1 : 0; }
+
+  size_type erase(const K& k) {
+    const std::size_t idx = FindIndex(k);
+    if (idx == npos()) {
+      return 0;
+    }
+
+    EraseIndex(idx);
+    return 1;
+  }
+
+  void clear() { Reset(); }
+
+  size_type size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+ protected:
+  enum Ctrl : std::uint8_t { kEmpty = 0, kFull, kDeleted };
+
+  static const K& KeyOf(const K& k) { return k; }
+
+  template <class T>
+  static const K& KeyOf(const std::pair<K, T>& v) {
+    return v.first;
+  }
+
+  /**
+   * @return Index past the last slot, as used for end iterators.
+   */
+  std::size_t npos() const { return slots_.size(); }
+
+  std::size_t NextFull(std::size_t idx) const {
+    while (idx < ctrl_.size() && ctrl_[idx] != kFull) {
+      ++idx;
+    }
+
+    return idx < ctrl_.size() ? idx : npos();
+  }
+
+  std::size_t Bucket(const K& k) const {
+    // Mixed, as Hash may be the identity (e.g. for integers). The seed
+    // depends on the capacity: otherwise keys inserted in the slot order of a
+    // larger table (e.g. when copying) arrive sorted by bucket, and cluster
+    // at the start of a smaller table, making insertion quadratic.
+    std::uint64_t h = static_cast<std::uint64_t>(Hash()(k)) ^
+                      (shift_ * 0x9e3779b97f4a7c15ULL);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return shift_ < 64 ? static_cast<std::size_t>(h >> shift_) : 0;
+  }
+
+  std::size_t FindIndex(const K& k) const {
+    if (size_ == 0) {
+      return npos();
+    }
+
+    const std::size_t mask = slots_.size() - 1;
+    for (std::size_t idx = Bucket(k);; idx = (idx + 1) & mask) {
+      if (ctrl_[idx] == kEmpty) {
+        return npos();
+      } else if (ctrl_[idx] == kFull && KeyOf(slots_[idx]) == k) {
+        return idx;
+      }
+    }
+  }
+
+  /**
+   * Find slot of k, or claim a slot for k if it does not exist; the caller
+   * must then assign the slot's value.
+   *
+   * @return Index of slot, and true if the slot was claimed.
+   */
+  std::pair<std::size_t, bool> InsertIndex(const K& k) {
+    const std::size_t found = FindIndex(k);
+    if (found != npos()) {
+      return std::make_pair(found, false);
+    }
+
+    if ((used_ + 1) * 4 > slots_.size() * 3) {
+      // Only grow if live elements need it; otherwise purge deleted slots.
+      std::size_t capacity = slots_.empty() ? 8 : slots_.size();
+      while ((size_ + 1) * 2 > capacity) {
+        capacity *= 2;
+      }
+
+      Rehash(capacity);
+    }
+
+    const std::size_t idx = ProbeFree(k);
+    if (ctrl_[idx] == kEmpty) {
+      ++used_;
+    }
+
+    ctrl_[idx] = kFull;
+    ++size_;
+    return std::make_pair(idx, true);
+  }
+
+  void EraseIndex(std::size_t idx) {
+    assert(ctrl_[idx] == kFull);
+    ctrl_[idx] = kDeleted;
+    slots_[idx] = V();  // release any resources held by the value
+    --size_;
+
+    if (size_ == 0) {
+      std::fill(ctrl_.begin(), ctrl_.end(), kEmpty);
+      used_ = 0;
+    }
+  }
+
+  bool EqualKeys(const FlatHashTable& rhs) const {
+    if (size_ != rhs.size_) {
+      return false;
+    }
+
+    for (std::size_t idx = NextFull(0); idx != npos();
+         idx = NextFull(idx + 1)) {
+      if (rhs.FindIndex(KeyOf(slots_[idx])) == rhs.npos()) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  std::vector<V> slots_;
+
+ private:
+  std::size_t ProbeFree(const K& k) const {
+    const std::size_t mask = slots_.size() - 1;
+    std::size_t idx = Bucket(k);
+    while (ctrl_[idx] == kFull) {
+      idx = (idx + 1) & mask;
+    }
+
+    return idx;
+  }
+
+  void Rehash(std::size_t capacity) {
+    assert((capacity & (capacity - 1)) == 0);
+
+    std::vector<V> slots(capacity);
+    std::vector<std::uint8_t> ctrl(capacity, kEmpty);
+    std::swap(slots, slots_);
+    std::swap(ctrl, ctrl_);
+
+    shift_ = 64;
+    for (std::size_t c = capacity; c > 1; c >>= 1) {
+      --shift_;
+    }
+
+    for (std::size_t i = 0; i < ctrl.size(); ++i) {
+      if (ctrl[i] == kFull) {
+        const std::size_t idx = ProbeFree(KeyOf(slots[i]));
+        slots_[idx] = std::move(slots[i]);
+        ctrl_[idx] = kFull;
+      }
+    }
+
+    used_ = size_;
+  }
+
+  void Reset() {
+    slots_.clear();
+    ctrl_.clear();
+    size_ = 0;
+    used_ = 0;
+    shift_ = 64;
+  }
+
+  std::vector<std::uint8_t> ctrl_;
+  std::size_t size_;
+  std::size_t used_;  // full and deleted slots
+  unsigned shift_;
+};
+
+/**
+ * @brief Set container backed by FlatHashTable.
+ *
+ * Provides the subset of the std::unordered_set interface used by Set.
+ * Unlike std::unordered_set, references to elements are invalidated by
+ * insertion.
+ */
+template <class E, class Hash>
+class FlatSetContainer : public FlatHashTable<E, E, Hash> {
+  typedef FlatHashTable<E, E, Hash> Base;
+
+ public:
+  typedef typename Base::template Iterator<const E, const Base> const_iterator;
+  typedef const_iterator iterator;
+
+  FlatSetContainer() {}
+
+  FlatSetContainer(std::initializer_list<E> il) {
+    insert(il.begin(), il.end());
+  }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+
+  const_iterator end() const { return const_iterator(this, this->npos()); }
+
+  std::pair<iterator, bool> insert(const E& e) {
+    const auto result = this->InsertIndex(e);
+    if (result.second) {
+      this->slots_[result.first] = e;
+    }
+
+    return std::make_pair(const_iterator(this, result.first), result.second);
+  }
+
+  template <class InputIt>
+  void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      insert(*first);
+    }
+  }
+
+  template <class... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    E e(std::forward<Args>(args)...);
+    const auto result = this->InsertIndex(e);
+    if (result.second) {
+      this->slots_[result.first] = std::move(e);
+    }
+
+    return std::make_pair(const_iterator(this, result.first), result.second);
+  }
+
+  using Base::erase;
+
+  iterator erase(const_iterator it) {
+    this->EraseIndex(it.index());
+    return const_iterator(this, it.index() + 1);
+  }
+
+  const_iterator find(const E& e) const {
+    return const_iterator(this, this->FindIndex(e));
+  }
+
+  bool operator==(const FlatSetContainer& rhs) const {
+    return this->EqualKeys(rhs);
+  }
+
+  bool operator!=(const FlatSetContainer& rhs) const {
+    return !(*this == rhs);
+  }
+};
+
+/**
+ * @brief Map container backed by FlatHashTable.
+ *
+ * Provides the subset of the std::unordered_map interface used by Relation.
+ * Unlike std::unordered_map, references to values are invalidated by
+ * insertion of a new key.
+ */
+template <class E, class T, class Hash>
+class FlatMapContainer : public FlatHashTable<E, std::pair<E, T>, Hash> {
+  typedef FlatHashTable<E, std::pair<E, T>, Hash> Base;
+
+ public:
+  typedef T mapped_type;
+  typedef typename Base::value_type value_type;
+
+  typedef typename Base::template Iterator<value_type, Base> iterator;
+  typedef typename Base::template Iterator<const value_type, const Base>
+      const_iterator;
+
+  iterator begin() { return iterator(this, 0); }
+
+  iterator end() { return iterator(this, this->npos()); }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+
+  const_iterator end() const { return const_iterator(this, this->npos()); }
+
+  T& operator[](const E& e) {
+    const auto result = this->InsertIndex(e);
+    if (result.second) {
+      this->slots_[result.first].first = e;
+    }
+
+    return this->slots_[result.first].second;
+  }
+
+  iterator find(const E& e) { return iterator(this, this->FindIndex(e)); }
+
+  const_iterator find(const E& e) const {
+    return const_iterator(this, this->FindIndex(e));
+  }
+
+  using Base::erase;
+
+  iterator erase(const_iterator it) {
+    this->EraseIndex(it.index());
+    return iterator(this, it.index() + 1);
+  }
+
+  bool operator==(const FlatMapContainer& rhs) const {
+    if (!this->EqualKeys(rhs)) {
+      return false;
+    }
+
+    for (const auto& kv : *this) {
+      if (!(kv.second == rhs.find(kv.first)->second)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool operator!=(const FlatMapContainer& rhs) const {
+    return !(*this == rhs);
+  }
+};
+
+/**
+ * @brief Open-addressing alternative to Types.
+ *
+ * Sets, and the rows of a Relation, are hash tables storing elements inline
+ * in a single vector, avoiding a node allocation per element and a pointer
+ * chase per lookup. Unlike DenseTypes, does not require a global index of
+ * elements.
+ */
+template <class E, class Hash = typename E::Hash>
+struct FlatTypes {
+  typedef E Element;
+
+  typedef FlatSetContainer<Element, Hash> SetContainer;
+
+  template <class T>
+  using MapContainer = FlatMapContainer<Element, T, Hash>;
+};
+
+/**
+ * @brief Set container storing up to N elements inline, which spills to a
+ * std::unordered_set beyond that.
+ *
+ * Inline elements are kept sorted by hash value (as elements need not have
+ * an order consistent with equality), s.t. lookups are a binary search.
+ * Once spilled, elements remain in the hash table until clear(). Provides the
+ * subset of the std::unordered_set interface used by Set; references to
+ * inline elements are invalidated by insertion and erasure. Elements must be
+ * default constructible.
+ */
+template <class E, class Hash, std::size_t N>
+class SmallSetContainer {
+ public:
+  typedef E key_type;
+  typedef E value_type;
+  typedef std::size_t size_type;
+  typedef std::unordered_set<E, Hash> Spill;
+
+  class const_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef E value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const E* pointer;
+    typedef const E& reference;
+
+    const_iterator() : elem_(nullptr) {}
+
+    explicit const_iterator(const E* elem) : elem_(elem) {}
+
+    explicit const_iterator(typename Spill::const_iterator it)
+        : elem_(nullptr), it_(it) {}
+
+    reference operator*() const { return elem_ != nullptr ? *elem_ : *it_; }
+
+    pointer operator->() const { return &**this; }
+
+    const_iterator& operator++() {
+      if (elem_ != nullptr) {
+        ++elem_;
+      } else {
+        ++it_;
+      }
+
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const const_iterator& rhs) const {
+      return elem_ == rhs.elem_ && (elem_ != nullptr || it_ == rhs.it_);
+    }
+
+    bool operator!=(const const_iterator& rhs) const {
+      return !(*this == rhs);
+    }
+
+   private:
+    friend class SmallSetContainer;
+
+    const E* elem_;
+    typename Spill::const_iterator it_;
+  };
+
+  typedef const_iterator iterator;
+
+  SmallSetContainer() : size_(0) {}
+
+  SmallSetContainer(std::initializer_list<E> il) : size_(0) {
+    insert(il.begin(), il.end());
+  }
+
+  SmallSetContainer(const SmallSetContainer& rhs)
+      : spill_(rhs.spill_ ? new Spill(*rhs.spill_) : nullptr),
+        size_(rhs.size_) {
+    std::copy(rhs.elems_, rhs.elems_ + rhs.size_, elems_);
+    std::copy(rhs.hashes_, rhs.hashes_ + rhs.size_, hashes_);
+  }
+
+  SmallSetContainer(SmallSetContainer&& rhs)
+      : spill_(std::move(rhs.spill_)), size_(rhs.size_) {
+    std::move(rhs.elems_, rhs.elems_ + rhs.size_, elems_);
+    std::copy(rhs.hashes_, rhs.hashes_ + rhs.size_, hashes_);
+    rhs.size_ = 0;
+  }
+
+  SmallSetContainer& operator=(SmallSetContainer rhs) {
+    spill_ = std::move(rhs.spill_);
+    size_ = rhs.size_;
+    std::move(rhs.elems_, rhs.elems_ + rhs.size_, elems_);
+    std::copy(rhs.hashes_, rhs.hashes_ + rhs.size_, hashes_);
+    return *this;
+  }
+
+  bool spilled() const { return spill_ != nullptr; }
+
+  const_iterator begin() const {
+    return spill_ ? const_iterator(spill_->cbegin()) : const_iterator(elems_);
+  }
+
+  const_iterator end() const {
+    return spill_ ? const_iterator(spill_->cend())
+                  : const_iterator(elems_ + size_);
+  }
+
+  std::pair<iterator, bool> insert(const E& e) { return emplace(e); }
+
+  template <class InputIt>
+  void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      insert(*first);
+    }
+  }
+
+  template <class... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    if (spill_) {
+      const auto result = spill_->emplace(std::forward<Args>(args)...);
+      return std::make_pair(const_iterator(result.first), result.second);
+    }
+
+    E e(std::forward<Args>(args)...);
+    const std::size_t hash = Hash()(e);
+    std::size_t idx = Find(e, hash);
+    if (idx != size_) {
+      return std::make_pair(const_iterator(elems_ + idx), false);
+    }
+
+    if (size_ == N) {
+      spill_.reset(new Spill(std::make_move_iterator(elems_),
+                             std::make_move_iterator(elems_ + size_)));
+      std::fill(elems_, elems_ + size_, E());
+      size_ = 0;
+
+      const auto result = spill_->insert(std::move(e));
+      return std::make_pair(const_iterator(result.first), true);
+    }
+
+    idx = std::upper_bound(hashes_, hashes_ + size_, hash) - hashes_;
+    std::move_backward(elems_ + idx, elems_ + size_, elems_ + size_ + 1);
+    std::copy_backward(hashes_ + idx, hashes_ + size_, hashes_ + size_ + 1);
+    elems_[idx] = std::move(e);
+    hashes_[idx] = hash;
+    ++size_;
+    return std::make_pair(const_iterator(elems_ + idx), true);
+  }
+
+  size_type erase(const E& e) {
+    if (spill_) {
+      return spill_->erase(e);
+    }
+
+    const std::size_t idx = Find(e, Hash()(e));
+    if (idx == size_) {
+      return 0;
+    }
+
+    EraseIndex(idx);
+    return 1;
+  }
+
+  iterator erase(const_iterator it) {
+    if (spill_) {
+      return const_iterator(spill_->erase(it.it_));
+    }
+
+    const std::size_t idx = it.elem_ - elems_;
+    EraseIndex(idx);
+    return const_iterator(elems_ + idx);
+  }
+
+  const_iterator find(const E& e) const {
+    if (spill_) {
+      return const_iterator(spill_->find(e));
+    }
+
+    return const_iterator(elems_ + Find(e, Hash()(e)));
+  }
+
+  size_type count(const E& e) const { return find(e) != end() ? 1 : 0; }
+
+  void clear() {
+    spill_.reset();
+    std::fill(elems_, elems_ + size_, E());
+    size_ = 0;
+  }
+
+  size_type size() const { return spill_ ? spill_->size() : size_; }
+
+  bool empty() const { return size() == 0; }
+
+  bool operator==(const SmallSetContainer& rhs) const {
+    if (size() != rhs.size()) {
+      return false;
+    }
+
+    for (const auto& e : *this) {
+      if (rhs.find(e) == rhs.end()) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool operator!=(const SmallSetContainer& rhs) const {
+    return !(*this == rhs);
+  }
+
+ private:
+  /**
+   * @return Index of e in inline elements; size_ if it does not exist.
+   */
+  std::size_t Find(const E& e, std::size_t hash) const {
+    for (std::size_t idx =
+             std::lower_bound(hashes_, hashes_ + size_, hash) - hashes_;
+         idx < size_ && hashes_[idx] == hash; ++idx) {
+      if (elems_[idx] == e) {
+        return idx;
+      }
+    }
+
+    return size_;
+  }
+
+  void EraseIndex(std::size_t idx) {
+    assert(idx < size_);
+    std::move(elems_ + idx + 1, elems_ + size_, elems_ + idx);
+    std::copy(hashes_ + idx + 1, hashes_ + size_, hashes_ + idx);
+    --size_;
+    elems_[size_] = E();  // release any resources held by the element
+  }
+
+  E elems_[N];
+  std::size_t hashes_[N];
+  std::unique_ptr<Spill> spill_;
+  std::size_t size_;  // number of inline elements
+};
+
+/**
+ * @brief Small-set alternative to Types.
+ *
+ * Sets, and therefore the rows of a Relation, store up to N elements inline
+ * (see SmallSetContainer); most rows of relations such as po, rf, co or
+ * fences only have a few elements, and thus do not require any allocation.
+ */
+template <class E, class Hash = typename E::Hash, std::size_t N = 4>
+struct SmallTypes {
   typedef E Element;
 
-  typedef std::unordered_set<Element, Hash> SetContainer;
+  typedef SmallSetContainer<Element, Hash, N> SetContainer;
 
   template <class T>
   using MapContainer = std::unordered_map<Element, T, Hash>;
@@ -108,6 +108,145 @@ TEST(CodeGen, X86_64_SC_PER_LOCATION) {
   ASSERT_TRUE(checker->no_thin_air());
   ASSERT_TRUE(checker->observation());
   ASSERT_TRUE(checker->propagation());
+
+  for (const auto& e : ew.events.get()) {
+    ASSERT_TRUE(ew.table.Contains(e));
+  }
+}
+
+TEST(CodeGen, X86_64_NoThrowObs) {
+  std::vector<codegen::strong::Operation::Ptr> threads = {
+      // p0
+      std::make_shared<strong::Write>(0xf0, 0),            // @0x0
+      std::make_shared<strong::Read>(0xf0, 0),             // @0x8
+      std::make_shared<strong::ReadModifyWrite>(0xf1, 0),  // 0x17
+
+      // p1
+      std::make_shared<strong::Write>(0xf1, 1),  // 0x0
+  };
+
+  cats::ExecWitness ew;
+  cats::Arch_TSO arch;
+  EvtStateCats* evts = new EvtStateCats(&ew, &arch);
+  evts->set_throw_obs_errors(false);
+  Compiler<strong::Operation, strong::Backend_X86_64> compiler(
+      std::unique_ptr<EvtStateCats>(evts), ExtractThreads(&threads));
+
+  char code[128];
+
+  ASSERT_NE(0, compiler.Emit(0, 0, code, sizeof(code)));
+  ASSERT_NE(0, compiler.Emit(1, 0xffff, code, sizeof(code)));
+
+  auto checker = arch.MakeChecker(&arch, &ew);
+  ew.po.set_props(mc::EventRel::kTransitiveClosure);
+  ew.co.set_props(mc::EventRel::kTransitiveClosure);
+
+  types::WriteID wid = 0;
+  ASSERT_TRUE(compiler.UpdateObs(0x0, 0, 0xf0, &wid, 1));
+  ASSERT_TRUE(compiler.UpdateObs(0x8, 0, 0xf0, &wid, 1));
+
+  CheckResult result = evts->Check(*checker);
+  ASSERT_EQ(CheckResult::kInvalid, result.verdict);
+  ASSERT_EQ(std::string("SC_PER_LOCATION"), result.failed);
+  ASSERT_FALSE(result.cycle.empty());
+  ASSERT_EQ(result.cycle.front(), result.cycle.back());
+  for (const auto idx : result.cycle) {
+    ASSERT_TRUE(idx != EventTable::kInvalid);
+    ASSERT_EQ(0xf0u, ew.table.Get(idx).addr);
+  }
+
+  // Invalid write-ID: recorded, and observed as the initial write.
+  wid = 0x42;
+  ASSERT_TRUE(compiler.UpdateObs(0x8, 0, 0xf0, &wid, 1));
+  ASSERT_NE(evts->obs_error().find("Invalid write"), std::string::npos);
+  result = evts->Check(*checker);
+  ASSERT_EQ(CheckResult::kIllFormed, result.verdict);
+  ASSERT_EQ(std::string("INVALID_OBS"), result.failed);
+
+  // The witness itself is valid, but the invalid observation remains
+  // recorded until Reset().
+  wid = 0x1;
+  ASSERT_TRUE(compiler.UpdateObs(0x8, 0, 0xf0, &wid, 1));
+  result = checker->check();
+  ASSERT_TRUE(result.valid());
+  ASSERT_TRUE(result.failed == nullptr);
+  ASSERT_TRUE(result.cycle.empty());
+  ASSERT_EQ(CheckResult::kIllFormed, evts->Check(*checker).verdict);
+
+  // Atomicity violation: recorded, and not observed.
+  wid = 0;
+  ASSERT_TRUE(compiler.UpdateObs(0xffff + 0x0, 0, 0xf1, &wid, 1));
+  ASSERT_TRUE(compiler.UpdateObs(0x17, 0, 0xf1, &wid, 1));
+  wid = 3;
+  ASSERT_FALSE(compiler.UpdateObs(0x17, 1, 0xf1, &wid, 1));
+  ASSERT_NE(evts->obs_error().find("Invalid write"), std::string::npos);
+
+  compiler.Reset();
+  ASSERT_TRUE(evts->obs_error().empty());
+  ASSERT_NE(0, compiler.Emit(0, 0, code, sizeof(code)));
+  ASSERT_NE(0, compiler.Emit(1, 0xffff, code, sizeof(code)));
+
+  wid = 0;
+  ASSERT_TRUE(compiler.UpdateObs(0xffff + 0x0, 0, 0xf1, &wid, 1));
+  ASSERT_TRUE(compiler.UpdateObs(0x17, 0, 0xf1, &wid, 1));
+  wid = 3;
+  ASSERT_FALSE(compiler.UpdateObs(0x17, 1, 0xf1, &wid, 1));
+  ASSERT_NE(evts->obs_error().find("NOT ATOMIC"), std::string::npos);
+  ASSERT_EQ(std::string("INVALID_OBS"), evts->Check(*checker).failed);
+}
+
+TEST(CodeGen, X86_64_Streaming) {
+  std::vector<codegen::strong::Operation::Ptr> threads = {
+      // p0
+      std::make_shared<strong::Write>(0xf0, 0),            // @0x0
+      std::make_shared<strong::Read>(0xf0, 0),             // @0x8
+      std::make_shared<strong::ReadModifyWrite>(0xf1, 0),  // 0x17
+
+      // p1
+      std::make_shared<strong::Write>(0xf1, 1),  // 0x0
+  };
+
+  cats::ExecWitness ew;
+  cats::Arch_TSO arch;
+  cats::StreamingChecker streaming(&arch, &ew);
+  EvtStateCats* evts = new EvtStateCats(&ew, &arch);
+  evts->set_streaming(&streaming);
+  Compiler<strong::Operation, strong::Backend_X86_64> compiler(
+      std::unique_ptr<EvtStateCats>(evts), ExtractThreads(&threads));
+
+  char code[128];
+
+  ASSERT_NE(0, compiler.Emit(0, 0, code, sizeof(code)));
+  ASSERT_NE(0, compiler.Emit(1, 0xffff, code, sizeof(code)));
+
+  ew.po.set_props(mc::EventRel::kTransitiveClosure);
+  ew.co.set_props(mc::EventRel::kTransitiveClosure);
+
+  types::WriteID wid = 0;
+  ASSERT_TRUE(compiler.UpdateObs(0x0, 0, 0xf0, &wid, 1));
+  ASSERT_TRUE(streaming.valid());
+  ASSERT_TRUE(compiler.UpdateObs(0x8, 0, 0xf0, &wid, 1));
+  ASSERT_FALSE(streaming.valid());
+  ASSERT_EQ(std::string("SC_PER_LOCATION"), streaming.result().failed);
+
+  wid = 0x1;  // replacement erases the offending observation
+  ASSERT_TRUE(compiler.UpdateObs(0x8, 0, 0xf0, &wid, 1));
+  ASSERT_TRUE(streaming.valid());
+
+  wid = 0;
+  ASSERT_TRUE(compiler.UpdateObs(0xffff + 0x0, 0, 0xf1, &wid, 1));
+  ASSERT_TRUE(compiler.UpdateObs(0x17, 0, 0xf1, &wid, 1));
+  wid = 3;  // restart atomic
+  ASSERT_TRUE(compiler.UpdateObs(0x17, 0, 0xf1, &wid, 1));
+  ASSERT_TRUE(compiler.UpdateObs(0x17, 1, 0xf1, &wid, 1));
+  ASSERT_TRUE(streaming.valid());
+
+  CheckResult result = streaming.Finish();
+  ASSERT_TRUE(result.valid());
+  ASSERT_TRUE(arch.MakeChecker(&arch, &ew)->check().valid());
+
+  compiler.Reset();
+  ASSERT_TRUE(streaming.valid());
 }
 
 TEST(CodeGen, X86_64_VA_Synonyms) {
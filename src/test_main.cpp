@@ -1,9 +1,37 @@
 // This code is licensed under the BSD 3-Clause license. See the LICENSE file
 // in the project root for license terms.
 
+#include "mc2lib/memconsistency/eventsets.hpp"
+
+#include <memory>
+
 #include <gtest/gtest.h>
 
+namespace {
+
+// Dense event containers (see MC2LIB_DENSE_EVENTSETS) of each test index
+// events via a table of their own, rather than via the global table.
+class EventTablePerTest : public ::testing::EmptyTestEventListener {
+ private:
+  void OnTestStart(const ::testing::TestInfo &) override {
+    table_.reset(new mc2lib::memconsistency::EventTable());
+    scope_.reset(new mc2lib::memconsistency::EventTableScope(table_.get()));
+  }
+
+  void OnTestEnd(const ::testing::TestInfo &) override {
+    scope_.reset();
+    table_.reset();
+  }
+
+  std::unique_ptr<mc2lib::memconsistency::EventTable> table_;
+  std::unique_ptr<mc2lib::memconsistency::EventTableScope> scope_;
+};
+
+}  // namespace
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
+  ::testing::UnitTest::GetInstance()->listeners().Append(
+      new EventTablePerTest());
   return RUN_ALL_TESTS();
 }
@@ -4,7 +4,11 @@
 #include "mc2lib/memconsistency/cats.hpp"
 #include "mc2lib/memconsistency/model12.hpp"
 
+#include <algorithm>
+#include <random>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -112,3 +116,1419 @@ TEST(MemConsistency, CatsDekkerInvalidSCValidTSO) {
   ASSERT_TRUE(c_tso->propagation());
   ASSERT_NO_THROW(c_tso->valid_exec());
 }
+
+TEST(MemConsistency, CatsExecWitnessMemo) {
+  cats::ExecWitness ew;
+
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Rx0 = Event(Event::kRead, 10, Iiid(0, 13));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 22));
+
+  ew.events |= EventSet({Ix, Wx0, Rx0, Rx1});
+  ew.po.Insert(Wx0, Rx0);
+  ew.co.Insert(Ix, Wx0);
+  ew.rf.Insert(Ix, Rx1);
+
+  const auto generation = ew.generation();
+  ASSERT_EQ(generation, ew.generation());
+
+  const EventRel* fr = &ew.fr();
+  const EventRel* com = &ew.com();
+  ASSERT_TRUE(fr->R(Rx1, Wx0));
+  ASSERT_EQ(fr, &ew.fr());
+  ASSERT_EQ(com, &ew.com());
+  ASSERT_EQ(generation, ew.generation());
+  ASSERT_TRUE(ew.fre().R(Rx1, Wx0));
+  ASSERT_TRUE(ew.fri().empty());
+
+  // Any modification must invalidate derived relations.
+  ew.rf.Insert(Wx0, Rx0);
+  ASSERT_NE(generation, ew.generation());
+  ASSERT_TRUE(ew.rfi().R(Wx0, Rx0));
+  ASSERT_TRUE(ew.com().R(Wx0, Rx0));
+  ASSERT_FALSE(ew.rfe().R(Wx0, Rx0));
+
+  const auto generation2 = ew.generation();
+  ew.co.set_props(EventRel::kTransitiveClosure);
+  ASSERT_NE(generation2, ew.generation());
+  ASSERT_TRUE(ew.fr().R(Rx1, Wx0));
+
+  ew.Clear();
+  ASSERT_TRUE(ew.com().empty());
+  ASSERT_TRUE(ew.po_loc().empty());
+}
+
+namespace {
+
+class CountingTSO : public cats::Arch_TSO {
+ public:
+  CountingTSO() : ppo_calls(0) {}
+
+  EventRel ppo(const cats::ExecWitness& ew) const override {
+    ++ppo_calls;
+    return cats::Arch_TSO::ppo(ew);
+  }
+
+  mutable int ppo_calls;
+};
+
+// SC with optional fences, as state covered by the default generation().
+class FencedSC : public cats::Arch_SC {
+ public:
+  std::uint64_t generation() const override {
+    return cats::Architecture::generation();
+  }
+
+  EventRel fences(const cats::ExecWitness& ew) const override {
+    return fence_;
+  }
+
+  void set_fence(EventRel fence) {
+    fence_ = std::move(fence);
+    InvalidateGeneration();
+  }
+
+ private:
+  EventRel fence_;
+};
+
+}  // namespace
+
+TEST(MemConsistency, CatsArchProxyMemo) {
+  cats::ExecWitness ew;
+  CountingTSO tso;
+  cats::ArchProxy<CountingTSO> tso_proxy(&tso);
+  auto c_tso = tso_proxy.MakeChecker(&ew);
+
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Wy1 = Event(Event::kWrite, 20, Iiid(1, 33));
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 55));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 22));
+
+  ew.events |= EventSet({Ix, Iy, Wx0, Wy1, Ry0, Rx1});
+  ew.po.Insert(Wx0, Ry0);
+  ew.po.Insert(Wy1, Rx1);
+  ew.co.Insert(Ix, Wx0);
+  ew.co.Insert(Iy, Wy1);
+  ew.rf.Insert(Ix, Rx1);
+  ew.rf.Insert(Iy, Ry0);
+
+  // ppo is used by both hb and prop, but only computed once.
+  ASSERT_NO_THROW(c_tso->valid_exec());
+  ASSERT_EQ(1, tso.ppo_calls);
+  const auto ppo = tso_proxy.shared_ppo(ew);
+  ASSERT_EQ(ppo, tso_proxy.shared_ppo(ew));
+  ASSERT_EQ(1, tso.ppo_calls);
+
+  // Modifying the architecture invalidates memoized relations.
+  tso.mfence.Insert(Wx0, Ry0);
+  tso.mfence.Insert(Wy1, Rx1);
+  ASSERT_FALSE(c_tso->propagation());
+  ASSERT_EQ(2, tso.ppo_calls);
+
+  // Previously obtained relations remain valid.
+  ASSERT_FALSE(ppo->R(Wx0, Ry0));
+
+  // As does modifying the execution.
+  ew.events.Insert(Event(Event::kRead, 20, Iiid(1, 40)));
+  ASSERT_TRUE(tso_proxy.shared_ppo(ew)->empty());
+  ASSERT_EQ(3, tso.ppo_calls);
+
+  tso_proxy.Clear();
+  ASSERT_TRUE(tso.mfence.empty());
+  ASSERT_TRUE(tso_proxy.shared_fences(ew)->empty());
+}
+
+TEST(MemConsistency, CatsArchProxyDefaultGeneration) {
+  cats::ExecWitness ew;
+  FencedSC arch;
+  cats::ArchProxy<FencedSC> proxy(&arch);
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 55));
+  ew.events |= EventSet({Wx0, Ry0});
+
+  const auto fences = proxy.shared_fences(ew);
+  ASSERT_TRUE(fences->empty());
+  ASSERT_EQ(fences, proxy.shared_fences(ew));
+  ASSERT_EQ(arch.generation(), arch.generation());
+  ASSERT_EQ(arch.generation(), FencedSC(arch).generation());
+
+  // The setter invalidates the generation.
+  EventRel fence;
+  fence.Insert(Wx0, Ry0);
+  arch.set_fence(fence);
+  ASSERT_TRUE(proxy.shared_fences(ew)->R(Wx0, Ry0));
+  ASSERT_TRUE(proxy.shared_hb(ew)->R(Wx0, Ry0));
+
+  cats::Arch_SC sc;
+  ASSERT_EQ(sc.generation(), sc.generation());
+}
+
+TEST(MemConsistency, CatsScFastPath) {
+  cats::ExecWitness ew;
+  CountingTSO tso;
+  auto c_tso = tso.MakeChecker(&tso, &ew);
+
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Wy1 = Event(Event::kWrite, 20, Iiid(1, 33));
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 55));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 22));
+
+  ew.events |= EventSet({Ix, Iy, Wx0, Wy1, Ry0, Rx1});
+  ew.po.Insert(Wx0, Ry0);
+  ew.po.Insert(Wy1, Rx1);
+  ew.co.Insert(Ix, Wx0);
+  ew.co.Insert(Iy, Wy1);
+
+  // Ry0 reads Wy1: interleaving Wy1 Wx0 Ry0 Rx1 is SC.
+  ew.rf.Insert(Wy1, Ry0);
+  ew.rf.Insert(Wx0, Rx1);
+  ASSERT_TRUE(c_tso->sc_acyclic());
+  ASSERT_NO_THROW(c_tso->valid_exec());
+  ASSERT_EQ(0, tso.ppo_calls);
+
+  // Dekker: not SC, but valid on TSO; requires the full check.
+  ew.rf = EventRel();
+  ew.rf.Insert(Ix, Rx1);
+  ew.rf.Insert(Iy, Ry0);
+  ASSERT_FALSE(c_tso->sc_acyclic());
+  ASSERT_NO_THROW(c_tso->valid_exec());
+  ASSERT_NE(0, tso.ppo_calls);
+
+  // Cyclic co is detected as such, and reported by the full check.
+  ew.co.Insert(Wx0, Ix);
+  ASSERT_FALSE(c_tso->sc_acyclic());
+  ASSERT_THROW(c_tso->valid_exec(), Error);
+}
+
+TEST(MemConsistency, Model12ScFastPath) {
+  model12::ExecWitness ew;
+  model12::Arch_TSO tso;
+  auto c_tso = tso.MakeChecker(&tso, &ew);
+
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Wy1 = Event(Event::kWrite, 20, Iiid(1, 33));
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 55));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 22));
+
+  ew.events |= EventSet({Ix, Iy, Wx0, Wy1, Ry0, Rx1});
+  ew.po.Insert(Wx0, Ry0);
+  ew.po.Insert(Wy1, Rx1);
+  ew.ws.Insert(Ix, Wx0);
+  ew.ws.Insert(Iy, Wy1);
+  ew.rf.Insert(Wy1, Ry0);
+  ew.rf.Insert(Wx0, Rx1);
+  ASSERT_TRUE(c_tso->sc_acyclic());
+  ASSERT_NO_THROW(c_tso->valid_exec());
+
+  // Dekker: both reads read the initial values; not SC.
+  ew.rf = EventRel();
+  ew.rf.Insert(Ix, Rx1);
+  ew.rf.Insert(Iy, Ry0);
+  ASSERT_FALSE(c_tso->sc_acyclic());
+}
+
+TEST(MemConsistency, CatsValidExecParallel) {
+  mc2lib::parallel::ThreadPool pool(3);
+  cats::ExecWitness ew;
+  cats::Arch_SC sc;
+  cats::ArchProxy<cats::Arch_SC> sc_proxy(&sc);
+  cats::Arch_TSO tso;
+
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Wy1 = Event(Event::kWrite, 20, Iiid(1, 33));
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 55));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 22));
+
+  ew.events |= EventSet({Ix, Iy, Wx0, Wy1, Ry0, Rx1});
+  ew.po.Insert(Wx0, Ry0);
+  ew.po.Insert(Wy1, Rx1);
+  ew.co.Insert(Ix, Wx0);
+  ew.co.Insert(Iy, Wy1);
+  ew.rf.Insert(Ix, Rx1);
+  ew.rf.Insert(Iy, Ry0);
+
+  ASSERT_NO_THROW(tso.MakeChecker(&tso, &ew)->valid_exec_parallel(&pool));
+
+  // Relations shared by the axioms are computed before fanning out.
+  CountingTSO counting_tso;
+  cats::ArchProxy<CountingTSO> tso_proxy(&counting_tso);
+  ASSERT_NO_THROW(tso_proxy.MakeChecker(&ew)->valid_exec_parallel(&pool));
+  ASSERT_EQ(1, counting_tso.ppo_calls);
+
+  for (const cats::Architecture* arch :
+       std::vector<const cats::Architecture*>{&sc, &sc_proxy}) {
+    auto c_sc = arch->MakeChecker(arch, &ew);
+
+    std::string error;
+    EventRel::Path cyclic;
+    try {
+      c_sc->valid_exec(&cyclic);
+    } catch (const Error& e) {
+      error = e.what();
+    }
+    ASSERT_EQ(std::string("PROPAGATION"), error);
+
+    for (int i = 0; i < 10; ++i) {
+      std::string error_parallel;
+      EventRel::Path cyclic_parallel;
+      try {
+        c_sc->valid_exec_parallel(&pool, &cyclic_parallel);
+      } catch (const Error& e) {
+        error_parallel = e.what();
+      }
+      ASSERT_EQ(error, error_parallel);
+      ASSERT_EQ(cyclic, cyclic_parallel);
+    }
+  }
+
+  // The first failing axiom is reported.
+  ew.co.Insert(Wx0, Ix);
+  try {
+    tso.MakeChecker(&tso, &ew)->valid_exec_parallel(&pool);
+    FAIL();
+  } catch (const Error& e) {
+    ASSERT_EQ(std::string("WF_CO_NOT_STRICT_PARTIAL_ORDER"), e.what());
+  }
+
+  // Both SC_PER_LOCATION and PROPAGATION fail on SC.
+  ew.co.Erase(Wx0, Ix);
+  Event Rx0 = Event(Event::kRead, 10, Iiid(0, 60));
+  ew.events.Insert(Rx0);
+  ew.po.Insert(Ry0, Rx0);
+  ew.po.set_props(EventRel::kTransitiveClosure);
+  ew.rf.Insert(Ix, Rx0);
+
+  auto c_sc = sc_proxy.MakeChecker(&ew);
+  EventRel::Path cyclic;
+  ASSERT_FALSE(c_sc->sc_per_location(&cyclic));
+
+  for (int i = 0; i < 10; ++i) {
+    EventRel::Path cyclic_parallel;
+    try {
+      c_sc->valid_exec_parallel(&pool, &cyclic_parallel);
+      FAIL();
+    } catch (const Error& e) {
+      ASSERT_EQ(std::string("SC_PER_LOCATION"), e.what());
+    }
+    ASSERT_EQ(cyclic, cyclic_parallel);
+  }
+
+  // From within a task of the pool, with no other worker to wait for.
+  mc2lib::parallel::ThreadPool pool1(1);
+  const auto table = EventTable::Current();
+  auto nested = pool1.Submit([&c_sc, &pool1, table]() {
+    const EventTableScope table_scope(table);
+    try {
+      c_sc->valid_exec_parallel(&pool1);
+    } catch (const Error& e) {
+      return std::string(e.what());
+    }
+
+    return std::string();
+  });
+  ASSERT_EQ(std::string("SC_PER_LOCATION"), nested.get());
+}
+
+TEST(MemConsistency, CatsCheckBatch) {
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Wy1 = Event(Event::kWrite, 20, Iiid(1, 33));
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 55));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 22));
+
+  cats::ExecWitness ew;
+  ew.events |= EventSet({Ix, Iy, Wx0, Wy1, Ry0, Rx1});
+  ew.po.Insert(Wx0, Ry0);
+  ew.po.Insert(Wy1, Rx1);
+  ew.co.Insert(Ix, Wx0);
+  ew.co.Insert(Iy, Wy1);
+
+  // Alternate between SC and Dekker outcomes.
+  std::vector<cats::ExecWitness> execs(64, ew);
+  for (std::size_t i = 0; i < execs.size(); ++i) {
+    if (i % 2 == 0) {
+      execs[i].rf.Insert(Wy1, Ry0);
+      execs[i].rf.Insert(Wx0, Rx1);
+    } else {
+      execs[i].rf.Insert(Ix, Rx1);
+      execs[i].rf.Insert(Iy, Ry0);
+    }
+  }
+
+  mc2lib::parallel::ThreadPool pool(4);
+  const cats::Arch_SC sc;
+  const cats::ArchFactory make_sc = [&sc]() {
+    return std::unique_ptr<cats::Architecture>(new cats::Arch_SC(sc));
+  };
+  const auto verdicts = cats::CheckBatch(execs, make_sc, &pool);
+
+  ASSERT_EQ(execs.size(), verdicts.size());
+  for (std::size_t i = 0; i < execs.size(); ++i) {
+    const auto expected = sc.MakeChecker(&sc, &execs[i])->check();
+
+    ASSERT_EQ(i % 2 == 0, verdicts[i].valid());
+    ASSERT_EQ(expected.verdict, verdicts[i].verdict);
+    ASSERT_EQ(std::string(expected.valid() ? "" : expected.failed),
+              std::string(verdicts[i].valid() ? "" : verdicts[i].failed));
+    ASSERT_EQ(expected.cycle, verdicts[i].cycle);
+    ASSERT_EQ(expected.cycle_path, verdicts[i].cycle_path);
+  }
+
+  // From within a task of the pool, with no other worker to wait for.
+  mc2lib::parallel::ThreadPool pool1(1);
+  const auto table = EventTable::Current();
+  const auto nested =
+      pool1.Submit([&execs, &make_sc, &pool1, table]() {
+        const EventTableScope table_scope(table);
+        return cats::CheckBatch(execs, make_sc, &pool1);
+      }).get();
+  ASSERT_EQ(execs.size(), nested.size());
+  for (std::size_t i = 0; i < execs.size(); ++i) {
+    ASSERT_EQ(verdicts[i].verdict, nested[i].verdict);
+  }
+}
+
+TEST(MemConsistency, CatsFingerprint) {
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Rx0 = Event(Event::kRead, 10, Iiid(0, 13));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 22));
+
+  cats::ExecWitness ew1;
+  ew1.events |= EventSet({Ix, Wx0, Rx0, Rx1});
+  ew1.po.Insert(Wx0, Rx0);
+  ew1.co.Insert(Ix, Wx0);
+  ew1.rf.Insert(Ix, Rx1);
+  ew1.rf.Insert(Wx0, Rx0);
+
+  // Same execution, constructed in a different order.
+  cats::ExecWitness ew2;
+  ew2.rf.Insert(Wx0, Rx0);
+  ew2.rf.Insert(Ix, Rx1);
+  ew2.co.Insert(Ix, Wx0);
+  ew2.po.Insert(Wx0, Rx0);
+  for (const auto& e : {Rx1, Rx0, Wx0, Ix}) {
+    ew2.events.Insert(e);
+  }
+
+  ASSERT_TRUE(ew1.fingerprint() == ew2.fingerprint());
+
+  // The same tuple in a different relation.
+  cats::ExecWitness ew3 = ew1;
+  ew3.rf.Erase(Wx0, Rx0);
+  ASSERT_TRUE(ew1.fingerprint() != ew3.fingerprint());
+  ew3.po.Insert(Wx0, Rx0);
+  ASSERT_TRUE(ew1.fingerprint() != ew3.fingerprint());
+
+  ew2.rf.Erase(Ix, Rx1);
+  ew2.rf.Insert(Wx0, Rx1);
+  ASSERT_TRUE(ew1.fingerprint() != ew2.fingerprint());
+  ew2.rf.Erase(Wx0, Rx1);
+  ew2.rf.Insert(Ix, Rx1);
+  ASSERT_TRUE(ew1.fingerprint() == ew2.fingerprint());
+}
+
+TEST(MemConsistency, CatsVerdictCache) {
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Wy1 = Event(Event::kWrite, 20, Iiid(1, 33));
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 55));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 22));
+
+  cats::ExecWitness ew;
+  ew.events |= EventSet({Ix, Iy, Wx0, Wy1, Ry0, Rx1});
+  ew.po.Insert(Wx0, Ry0);
+  ew.po.Insert(Wy1, Rx1);
+  ew.co.Insert(Ix, Wx0);
+  ew.co.Insert(Iy, Wy1);
+
+  std::vector<cats::ExecWitness> execs(16, ew);
+  for (std::size_t i = 0; i < execs.size(); ++i) {
+    if (i % 2 == 0) {
+      execs[i].rf.Insert(Wy1, Ry0);
+      execs[i].rf.Insert(Wx0, Rx1);
+    } else {
+      execs[i].rf.Insert(Ix, Rx1);
+      execs[i].rf.Insert(Iy, Ry0);
+    }
+  }
+
+  cats::VerdictCache cache(2);
+  cats::Arch_SC sc;
+  cats::Arch_TSO tso;
+
+  for (const auto& exec : execs) {
+    const auto expected = sc.MakeChecker(&sc, &exec)->check();
+    const auto result = cache.Check(sc, exec);
+    ASSERT_EQ(expected.verdict, result.verdict);
+    ASSERT_EQ(expected.cycle, result.cycle);
+    ASSERT_EQ(expected.cycle_path, result.cycle_path);
+  }
+
+  ASSERT_EQ(2u, cache.stats().misses);
+  ASSERT_EQ(14u, cache.stats().hits);
+  ASSERT_EQ(14.0 / 16.0, cache.stats().hit_rate());
+
+  // Keyed on the architecture, including its state.
+  ASSERT_TRUE(cache.Check(tso, execs[1]).valid());
+  ASSERT_EQ(3u, cache.stats().misses);
+  tso.mfence.Insert(Wx0, Ry0);
+  tso.mfence.Insert(Wy1, Rx1);
+  ASSERT_FALSE(cache.Check(tso, execs[1]).valid());
+  ASSERT_EQ(4u, cache.stats().misses);
+  ASSERT_EQ(2u, cache.size());
+
+  // ... i.e. on the contents of its state, not its identity.
+  cats::Arch_TSO tso2(tso);
+  ASSERT_FALSE(cache.Check(tso2, execs[1]).valid());
+  tso.Clear();
+  ASSERT_TRUE(cache.Check(tso, execs[1]).valid());
+  ASSERT_EQ(4u, cache.stats().misses);
+
+  ASSERT_EQ(16u, cache.stats().hits);
+
+  // Unless the state is fingerprinted, verdicts are shared by an
+  // architecture and its copies only, until modified.
+  FencedSC fenced;
+  cache.Check(fenced, execs[1]);
+  cache.Check(fenced, execs[1]);
+  cache.Check(FencedSC(fenced), execs[1]);
+  ASSERT_EQ(5u, cache.stats().misses);
+  ASSERT_EQ(18u, cache.stats().hits);
+  cache.Check(FencedSC(), execs[1]);
+  ASSERT_EQ(6u, cache.stats().misses);
+  EventRel fence;
+  fence.Insert(Wx0, Ry0);
+  fenced.set_fence(fence);
+  cache.Check(fenced, execs[1]);
+  ASSERT_EQ(7u, cache.stats().misses);
+
+  // Evicted.
+  ASSERT_TRUE(cache.Check(sc, execs[0]).valid());
+  ASSERT_EQ(8u, cache.stats().misses);
+
+  cache.Clear();
+  ASSERT_EQ(0u, cache.size());
+
+  mc2lib::parallel::ThreadPool pool(4);
+  const auto verdicts = cats::CheckBatch(
+      execs,
+      [&sc]() {
+        return std::unique_ptr<cats::Architecture>(new cats::Arch_SC(sc));
+      },
+      &pool, &cache);
+  for (std::size_t i = 0; i < execs.size(); ++i) {
+    ASSERT_EQ(i % 2 == 0, verdicts[i].valid());
+  }
+  ASSERT_EQ(execs.size(), cache.stats().hits + cache.stats().misses);
+}
+
+TEST(MemConsistency, PerLocationAcyclic) {
+  mc2lib::parallel::ThreadPool pool(3);
+  cats::ExecWitness ew;
+  model12::ExecWitness ew12;
+
+  // Many locations with few events each; CoRR violated on one of them.
+  for (int a = 1; a <= 200; ++a) {
+    const int poi = a * 2;
+    Event Ia = Event(Event::kWrite, a * 8, Iiid(-1, a));
+    Event Wa0 = Event(Event::kWrite, a * 8, Iiid(0, poi));
+    Event Ra1 = Event(Event::kRead, a * 8, Iiid(1, poi));
+    Event Ra1_ = Event(Event::kRead, a * 8, Iiid(1, poi + 1));
+
+    ew.events |= EventSet({Ia, Wa0, Ra1, Ra1_});
+    ew.po.Insert(Ra1, Ra1_);
+    ew.co.Insert(Ia, Wa0);
+    ew.rf.Insert(Wa0, Ra1);
+    ew.rf.Insert(a == 123 ? Ia : Wa0, Ra1_);
+  }
+
+  ew12.events = ew.events;
+  ew12.po = ew.po;
+  ew12.ws = ew.co;
+  ew12.rf = ew.rf;
+
+  cats::Arch_SC sc;
+  model12::Arch_SC sc12;
+  auto c_sc = sc.MakeChecker(&sc, &ew);
+  auto c_sc12 = sc12.MakeChecker(&sc12, &ew12);
+
+  EventRel::Path cyclic;
+  EventRel::Path cyclic12;
+  ASSERT_FALSE(c_sc->sc_per_location(&cyclic));
+  ASSERT_FALSE(c_sc12->uniproc(&cyclic12));
+  ASSERT_FALSE(cyclic.empty());
+  ASSERT_EQ(cyclic.front(), cyclic.back());
+  for (const auto& e : cyclic) {
+    ASSERT_EQ(123u * 8, e.addr);
+  }
+  ASSERT_EQ(cyclic, cyclic12);
+
+  c_sc->set_pool(&pool);
+  c_sc12->set_pool(&pool);
+  for (int i = 0; i < 10; ++i) {
+    EventRel::Path cyclic_parallel;
+    ASSERT_FALSE(c_sc->sc_per_location(&cyclic_parallel));
+    ASSERT_EQ(cyclic, cyclic_parallel);
+
+    cyclic_parallel.clear();
+    ASSERT_FALSE(c_sc12->uniproc(&cyclic_parallel));
+    ASSERT_EQ(cyclic, cyclic_parallel);
+  }
+
+  Event I123 = Event(Event::kWrite, 123 * 8, Iiid(-1, 123));
+  Event W123 = Event(Event::kWrite, 123 * 8, Iiid(0, 246));
+  Event R123 = Event(Event::kRead, 123 * 8, Iiid(1, 247));
+  ew.rf.Erase(I123, R123);
+  ew.rf.Insert(W123, R123);
+  ASSERT_TRUE(c_sc->sc_per_location());
+  c_sc->set_pool(nullptr);
+  ASSERT_TRUE(c_sc->sc_per_location());
+
+  // Falls back to checking the whole relation.
+  EventRel er;
+  er.Insert(W123, R123);
+  er.Insert(R123, I123);
+  std::vector<EventRel> parts;
+  ASSERT_TRUE(PartitionByAddr(er, &parts));
+  ASSERT_EQ(1u, parts.size());
+  er.Insert(I123, Event(Event::kRead, 8, Iiid(1, 3)));
+  er.Insert(Event(Event::kRead, 8, Iiid(1, 3)), W123);
+  ASSERT_FALSE(PartitionByAddr(er, &parts));
+  cyclic.clear();
+  ASSERT_FALSE(PerLocationAcyclic(er, &pool, &cyclic));
+  ASSERT_EQ(5u, cyclic.size());
+}
+
+TEST(MemConsistency, CatsWfCo) {
+  cats::ExecWitness ew;
+  cats::Arch_SC sc;
+  auto checker = sc.MakeChecker(&sc, &ew);
+
+  // Dozens of writes to a hot address, and one to another.
+  std::vector<Event> writes;
+  for (int i = 0; i < 40; ++i) {
+    writes.push_back(Event(Event::kWrite, 10, Iiid(i % 4, i)));
+    ew.events.Insert(writes.back());
+    for (std::size_t j = 0; j + 1 < writes.size(); ++j) {
+      ew.co.Insert(writes[j], writes.back());
+    }
+  }
+  ew.events.Insert(Event(Event::kWrite, 20, Iiid(0, 100)));
+  ASSERT_NO_THROW(checker->wf());
+
+  const auto wf_error = [&checker]() -> std::string {
+    try {
+      checker->wf();
+    } catch (const Error& e) {
+      return e.what();
+    }
+    return "";
+  };
+
+  // Not transitive.
+  ew.co.Erase(writes[3], writes[20]);
+  ASSERT_EQ(std::string("WF_CO_NOT_STRICT_PARTIAL_ORDER"), wf_error());
+  ew.co.Insert(writes[3], writes[20]);
+
+  ew.co.Insert(writes[39], writes[0]);
+  ASSERT_EQ(std::string("WF_CO_NOT_STRICT_PARTIAL_ORDER"), wf_error());
+  ew.co.Erase(writes[39], writes[0]);
+
+  // Not total.
+  Event Wx = Event(Event::kWrite, 10, Iiid(0, 101));
+  ew.events.Insert(Wx);
+  ASSERT_EQ(std::string("WF_CO_NOT_CONNEX"), wf_error());
+
+  ew.co.Insert(writes[0], Event(Event::kWrite, 20, Iiid(0, 100)));
+  ASSERT_EQ(std::string("WF_CO_NOT_SAME_LOC"), wf_error());
+}
+
+TEST(MemConsistency, Model12WfWs) {
+  model12::ExecWitness ew;
+  model12::Arch_SC sc;
+  auto checker = sc.MakeChecker(&sc, &ew);
+
+  // Dozens of writes to a hot address, and one to another.
+  std::vector<Event> writes;
+  for (int i = 0; i < 40; ++i) {
+    writes.push_back(Event(Event::kWrite, 10, Iiid(i % 4, i)));
+    ew.events.Insert(writes.back());
+    for (std::size_t j = 0; j + 1 < writes.size(); ++j) {
+      ew.ws.Insert(writes[j], writes.back());
+    }
+  }
+  ew.events.Insert(Event(Event::kWrite, 20, Iiid(0, 100)));
+  ASSERT_NO_THROW(checker->wf());
+
+  const auto wf_error = [&checker]() -> std::string {
+    try {
+      checker->wf();
+    } catch (const Error& e) {
+      return e.what();
+    }
+    return "";
+  };
+
+  // Not transitive.
+  ew.ws.Erase(writes[3], writes[20]);
+  ASSERT_EQ(std::string("WF_WS_NOT_STRICT_PARTIAL_ORDER"), wf_error());
+  ew.ws.Insert(writes[3], writes[20]);
+
+  ew.ws.Insert(writes[39], writes[0]);
+  ASSERT_EQ(std::string("WF_WS_NOT_STRICT_PARTIAL_ORDER"), wf_error());
+  ew.ws.Erase(writes[39], writes[0]);
+
+  // Not total.
+  Event Wx = Event(Event::kWrite, 10, Iiid(0, 101));
+  ew.events.Insert(Wx);
+  ASSERT_EQ(std::string("WF_WS_NOT_CONNEX"), wf_error());
+
+  ew.ws.Insert(writes[0], Event(Event::kWrite, 20, Iiid(0, 100)));
+  ASSERT_EQ(std::string("WF_WS_NOT_SAME_LOC"), wf_error());
+}
+
+// The pairwise checks of wf_co/wf_ws, which the fast path
+// (CoherenceOrder::StrictTotalOrderPerAddr) must agree with.
+static bool PairwiseStrictTotalOrderPerAddr(const EventRel& co,
+                                            const EventSet& writes) {
+  std::unordered_set<mc2lib::types::Addr> addrs;
+
+  for (const auto& tuples : co.get()) {
+    addrs.insert(tuples.first.addr);
+
+    for (const auto& e : tuples.second.get()) {
+      if (tuples.first.addr != e.addr) {
+        return false;
+      }
+    }
+  }
+
+  if (!co.StrictPartialOrder(writes)) {
+    return false;
+  }
+
+  for (const auto& addr : addrs) {
+    if (!co.ConnexOn(
+            writes.Filter([&](const Event& e) { return e.addr == addr; }))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+TEST(MemConsistency, CoherenceOrderDifferential) {
+  std::mt19937 urng(2468);
+  const auto rand = [&urng](int n) {
+    return std::uniform_int_distribution<int>(0, n - 1)(urng);
+  };
+
+  int num_valid = 0;
+  int num_invalid = 0;
+
+  for (int i = 0; i < 5000; ++i) {
+    EventSet writes;
+    EventRel co;
+    std::vector<Event> all;
+
+    for (int addr = 0; addr < 3; ++addr) {
+      std::vector<Event> order;
+      const int num_writes = rand(6);
+      for (int j = 0; j < num_writes; ++j) {
+        order.push_back(Event(Event::kWrite, addr, Iiid(j % 2, addr * 8 + j)));
+        writes.Insert(order.back());
+        all.push_back(order.back());
+      }
+
+      std::shuffle(order.begin(), order.end(), urng);
+      for (std::size_t j = 1; j < order.size(); ++j) {
+        co.Insert(order[j - 1], order[j]);
+        if (rand(2) == 0) {
+          // Explicitly transitive (to some extent).
+          co.Insert(order[rand(static_cast<int>(j))], order[j]);
+        }
+      }
+    }
+
+    if (rand(2) == 0) {
+      co.set_props(EventRel::kTransitiveClosure);
+    }
+
+    // Perturb.
+    if (!all.empty()) {
+      const Event& e1 = all[rand(static_cast<int>(all.size()))];
+      const Event& e2 = all[rand(static_cast<int>(all.size()))];
+      switch (rand(7)) {
+        case 0:
+          co.Insert(e1, e2);
+          break;
+        case 1:
+          co.Erase(e1, e2);
+          break;
+        case 2:
+          writes.Insert(Event(Event::kWrite, e1.addr, Iiid(2, 100)));
+          break;
+        case 3:
+          writes.Erase(e1);
+          break;
+        case 4:
+          writes.Erase(e1);
+          writes.Erase(e2);
+          break;
+        default:
+          break;
+      }
+    }
+
+    const bool expected = PairwiseStrictTotalOrderPerAddr(co, writes);
+    const bool result = CoherenceOrder(co).StrictTotalOrderPerAddr(writes);
+    // Conservative: if the fast path fails, the pairwise checks follow.
+    ASSERT_TRUE(!result || expected);
+    bool ordered_in_writes = true;
+    co.for_each([&](const Event& e1, const Event& e2) {
+      ordered_in_writes &= writes.Contains(e1) && writes.Contains(e2);
+    });
+    if (ordered_in_writes) {
+      // Otherwise the pairwise checks are more lenient.
+      ASSERT_EQ(expected, result);
+    }
+    ++(expected ? num_valid : num_invalid);
+
+    cats::ExecWitness ew;
+    cats::Arch_SC sc;
+    ew.events = writes;
+    ew.co = co;
+    ASSERT_EQ(expected, cats::Checker(&sc, &ew).wf_co_error() == nullptr);
+
+    model12::ExecWitness ew12;
+    model12::Arch_SC sc12;
+    ew12.events = writes;
+    ew12.ws = co;
+    ASSERT_EQ(expected,
+              model12::Checker(&sc12, &ew12).wf_ws_error() == nullptr);
+  }
+
+  ASSERT_GT(num_valid, 1000);
+  ASSERT_GT(num_invalid, 1000);
+}
+
+TEST(MemConsistency, CheckResult) {
+  cats::ExecWitness ew;
+  model12::ExecWitness ew12;
+  cats::Arch_SC sc;
+  cats::Arch_TSO tso;
+  model12::Arch_SC sc12;
+
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Wy1 = Event(Event::kWrite, 20, Iiid(1, 33));
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 55));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 22));
+
+  ew.events |= EventSet({Ix, Iy, Wx0, Wy1, Ry0, Rx1});
+  ew.po.Insert(Wx0, Ry0);
+  ew.po.Insert(Wy1, Rx1);
+  ew.co.Insert(Ix, Wx0);
+  ew.co.Insert(Iy, Wy1);
+  ew.rf.Insert(Ix, Rx1);
+  ew.rf.Insert(Iy, Ry0);
+  ew.table.ToIdx(ew.events);
+
+  ew12.events = ew.events;
+  ew12.po = ew.po;
+  ew12.ws = ew.co;
+  ew12.rf = ew.rf;
+
+  CheckResult result = tso.MakeChecker(&tso, &ew)->check();
+  ASSERT_TRUE(result.valid());
+  ASSERT_TRUE(result.failed == nullptr);
+  ASSERT_EQ(0u, result.cycle.capacity());
+  ASSERT_EQ(0u, result.cycle_path.capacity());
+
+  EventRel::Path cyclic;
+  auto c_sc = sc.MakeChecker(&sc, &ew);
+  ASSERT_THROW(c_sc->valid_exec(&cyclic), Error);
+
+  result = c_sc->check();
+  ASSERT_EQ(CheckResult::kInvalid, result.verdict);
+  ASSERT_EQ(std::string("PROPAGATION"), result.failed);
+  ASSERT_EQ(cyclic.size(), result.cycle.size());
+  for (std::size_t i = 0; i < cyclic.size(); ++i) {
+    ASSERT_EQ(cyclic[i], ew.table.Get(result.cycle[i]));
+  }
+
+  ASSERT_TRUE(cyclic == result.cycle_path);
+
+  // Not in the table: only as events.
+  result = sc12.MakeChecker(&sc12, &ew12)->check();
+  ASSERT_EQ(CheckResult::kInvalid, result.verdict);
+  ASSERT_EQ(std::string("CHECK_EXEC"), result.failed);
+  ASSERT_FALSE(result.cycle.empty());
+  for (const auto idx : result.cycle) {
+    ASSERT_TRUE(idx == EventTable::kInvalid);
+  }
+  ASSERT_EQ(result.cycle.size(), result.cycle_path.size());
+  ASSERT_EQ(result.cycle_path.front(), result.cycle_path.back());
+  for (std::size_t i = 0; i + 1 < result.cycle_path.size(); ++i) {
+    ASSERT_TRUE(ew12.events.Contains(result.cycle_path[i]));
+  }
+
+  ew.rf.Insert(Wx0, Rx1);
+  result = c_sc->check();
+  ASSERT_EQ(CheckResult::kIllFormed, result.verdict);
+  ASSERT_EQ(std::string("WF_RF_MULTI_SOURCE"), result.failed);
+  ASSERT_TRUE(result.cycle.empty());
+
+  try {
+    c_sc->valid_exec();
+    FAIL();
+  } catch (const Error& e) {
+    ASSERT_EQ(std::string("WF_RF_MULTI_SOURCE"), e.what());
+  }
+}
+
+TEST(MemConsistency, CatsStreamingChecker) {
+  cats::ExecWitness ew;
+  cats::Arch_TSO tso;
+  cats::StreamingChecker streaming(&tso, &ew);
+
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Rx1a = Event(Event::kRead, 10, Iiid(1, 22));
+  Event Rx1b = Event(Event::kRead, 10, Iiid(1, 23));
+
+  ew.events |= EventSet({Ix, Iy, Wx0, Rx1a, Rx1b});
+  ew.po.Insert(Rx1a, Rx1b);
+  ew.table.ToIdx(ew.events);
+
+  ew.co.Insert(Ix, Wx0);
+  ASSERT_TRUE(streaming.InsertCo(Ix, Wx0));
+  ew.rf.Insert(Wx0, Rx1a);
+  ASSERT_TRUE(streaming.InsertRf(Wx0, Rx1a));
+
+  // CoRR: fails with the tuple closing the cycle.
+  ew.rf.Insert(Ix, Rx1b);
+  ASSERT_FALSE(streaming.InsertRf(Ix, Rx1b));
+  ASSERT_EQ(std::string("SC_PER_LOCATION"), streaming.result().failed);
+  ASSERT_EQ(streaming.cycle().size(), streaming.result().cycle.size());
+  ASSERT_EQ(streaming.cycle().front(), streaming.cycle().back());
+
+  CheckResult result = streaming.Finish();
+  ASSERT_EQ(CheckResult::kInvalid, result.verdict);
+  ASSERT_EQ(std::string("SC_PER_LOCATION"), result.failed);
+  ASSERT_EQ(tso.MakeChecker(&tso, &ew)->check().failed, result.failed);
+
+  // Fix the observation: rebuilt on next use, as the check failed.
+  ew.rf.Erase(Ix, Rx1b);
+  streaming.EraseRf(Ix, Rx1b);
+  ew.rf.Insert(Wx0, Rx1b);
+  ASSERT_TRUE(streaming.InsertRf(Wx0, Rx1b));
+  ASSERT_TRUE(streaming.Finish().valid());
+  ASSERT_TRUE(tso.MakeChecker(&tso, &ew)->check().valid());
+
+  // Load buffering: R -> W is in ppo of TSO.
+  ew.Clear();
+  tso.Clear();
+  streaming.Reset();
+
+  Event Rx0 = Event(Event::kRead, 10, Iiid(0, 30));
+  Event Wy0 = Event(Event::kWrite, 20, Iiid(0, 31));
+  Event Ry1 = Event(Event::kRead, 20, Iiid(1, 40));
+  Event Wx1 = Event(Event::kWrite, 10, Iiid(1, 41));
+
+  ew.events |= EventSet({Ix, Iy, Rx0, Wy0, Ry1, Wx1});
+  ew.po.Insert(Rx0, Wy0);
+  ew.po.Insert(Ry1, Wx1);
+  ew.table.ToIdx(ew.events);
+
+  ew.co.Insert(Ix, Wx1);
+  ASSERT_TRUE(streaming.InsertCo(Ix, Wx1));
+  ew.co.Insert(Iy, Wy0);
+  ASSERT_TRUE(streaming.InsertCo(Iy, Wy0));
+  ew.rf.Insert(Wx1, Rx0);
+  ASSERT_TRUE(streaming.InsertRf(Wx1, Rx0));
+  ew.rf.Insert(Wy0, Ry1);
+  ASSERT_FALSE(streaming.InsertRf(Wy0, Ry1));
+  ASSERT_EQ(std::string("NO_THIN_AIR"), streaming.result().failed);
+  ASSERT_EQ(5u, streaming.cycle().size());
+  for (const auto idx : streaming.result().cycle) {
+    ASSERT_TRUE(idx != EventTable::kInvalid);
+  }
+
+  result = tso.MakeChecker(&tso, &ew)->check();
+  ASSERT_EQ(CheckResult::kInvalid, result.verdict);
+  ASSERT_EQ(std::string("NO_THIN_AIR"), result.failed);
+}
+
+TEST(MemConsistency, CatsStreamingCheckerRestart) {
+  cats::ExecWitness ew;
+  cats::Arch_TSO tso;
+  cats::StreamingChecker streaming(&tso, &ew);
+
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 10));
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 11));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 20));
+  Event Wy1 = Event(Event::kWrite, 20, Iiid(1, 21));
+
+  ew.events |= EventSet({Ix, Iy, Ry0, Wx0, Rx1, Wy1});
+  ew.po.Insert(Ry0, Wx0);
+  ew.po.Insert(Rx1, Wy1);
+  ew.po.set_props(EventRel::kTransitiveClosure);
+  ew.table.ToIdx(ew.events);
+
+  // First observation: rfe Wx0 -> Rx1, which is restarted to read Ix.
+  ew.rf.Insert(Wx0, Rx1);
+  ASSERT_TRUE(streaming.InsertRf(Wx0, Rx1));
+  ew.rf.Erase(Wx0, Rx1);
+  streaming.EraseRf(Wx0, Rx1);
+  ew.rf.Insert(Ix, Rx1);
+  ASSERT_TRUE(streaming.InsertRf(Ix, Rx1));
+
+  ew.co.Insert(Ix, Wx0);
+  ASSERT_TRUE(streaming.InsertCo(Ix, Wx0));
+  ew.co.Insert(Iy, Wy1);
+  ASSERT_TRUE(streaming.InsertCo(Iy, Wy1));
+
+  // Would close a cycle with the erased rfe.
+  ew.rf.Insert(Wy1, Ry0);
+  ASSERT_TRUE(streaming.InsertRf(Wy1, Ry0));
+  ASSERT_TRUE(streaming.valid());
+
+  ASSERT_TRUE(streaming.Finish().valid());
+  ASSERT_TRUE(tso.MakeChecker(&tso, &ew)->check().valid());
+  ASSERT_TRUE(cats::Checker(&tso, &ew).check().valid());
+
+  // Restarted again, to read Wx0: confirmed, after the erasure.
+  ew.rf.Erase(Ix, Rx1);
+  streaming.EraseRf(Ix, Rx1);
+  ASSERT_TRUE(streaming.valid());
+  ew.rf.Insert(Wx0, Rx1);
+  ASSERT_FALSE(streaming.InsertRf(Wx0, Rx1));
+  ASSERT_EQ(std::string("NO_THIN_AIR"), streaming.result().failed);
+  ASSERT_EQ(std::string("NO_THIN_AIR"),
+            tso.MakeChecker(&tso, &ew)->check().failed);
+}
+
+// TSO, but with fre and W -> R in hb as well: not default_hb().
+class StrictHbTSO : public cats::Arch_TSO {
+ public:
+  EventRel hb(const cats::ExecWitness& ew) const override {
+    EventRel result = Arch_TSO::hb(ew);
+    result |= ew.fre();
+    result |= ew.po.Eval();
+    return result;
+  }
+};
+
+TEST(MemConsistency, CatsStreamingCheckerCustomHb) {
+  cats::ExecWitness ew;
+  StrictHbTSO arch;
+  cats::StreamingChecker streaming(&arch, &ew);
+
+  ASSERT_TRUE(cats::Arch_TSO().default_hb());
+  ASSERT_FALSE(arch.default_hb());
+  ASSERT_FALSE(cats::ArchProxy<StrictHbTSO>(&arch).default_hb());
+
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 10));
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 11));
+  Event Wy1 = Event(Event::kWrite, 20, Iiid(1, 20));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 21));
+
+  ew.events |= EventSet({Ix, Iy, Wx0, Ry0, Wy1, Rx1});
+  ew.po.Insert(Wx0, Ry0);
+  ew.po.Insert(Wy1, Rx1);
+  ew.po.set_props(EventRel::kTransitiveClosure);
+  ew.table.ToIdx(ew.events);
+
+  ew.co.Insert(Ix, Wx0);
+  ASSERT_TRUE(streaming.InsertCo(Ix, Wx0));
+  ew.co.Insert(Iy, Wy1);
+  ASSERT_TRUE(streaming.InsertCo(Iy, Wy1));
+  ew.rf.Insert(Ix, Rx1);
+  ASSERT_TRUE(streaming.InsertRf(Ix, Rx1));
+
+  // Store buffering: valid on TSO, but hb is cyclic.
+  ew.rf.Insert(Iy, Ry0);
+  const cats::Arch_TSO tso;
+  ASSERT_TRUE(tso.MakeChecker(&tso, &ew)->check().valid());
+  ASSERT_FALSE(streaming.InsertRf(Iy, Ry0));
+  ASSERT_EQ(std::string("NO_THIN_AIR"), streaming.result().failed);
+  ASSERT_EQ(5u, streaming.cycle().size());
+
+  CheckResult result = streaming.Finish();
+  ASSERT_EQ(std::string("NO_THIN_AIR"), result.failed);
+  ASSERT_EQ(arch.MakeChecker(&arch, &ew)->check().failed, result.failed);
+
+  ew.rf.Erase(Iy, Ry0);
+  streaming.EraseRf(Iy, Ry0);
+  ew.rf.Insert(Wy1, Ry0);
+  ASSERT_TRUE(streaming.InsertRf(Wy1, Ry0));
+  ASSERT_TRUE(streaming.Finish().valid());
+  ASSERT_TRUE(arch.MakeChecker(&arch, &ew)->check().valid());
+}
+
+// Random execution of up to 4 threads on 3 addresses: well-formed, but
+// frequently not valid on TSO (or SC).
+static void RandomExec(std::mt19937* urng, EventSet* events, EventRel* po,
+                       EventRel* co, EventRel* rf, EventRel* mfence) {
+  const auto rand = [urng](int n) {
+    return std::uniform_int_distribution<int>(0, n - 1)(*urng);
+  };
+
+  std::vector<std::vector<Event>> writes(3);
+  std::vector<Event> reads;
+
+  for (int addr = 0; addr < 3; ++addr) {
+    writes[addr].push_back(Event(Event::kWrite, addr, Iiid(-1, addr)));
+  }
+
+  const int num_threads = 1 + rand(4);
+  for (int pid = 0; pid < num_threads; ++pid) {
+    std::vector<Event> thread;
+    const int num_events = 1 + rand(6);
+    for (int poi = 0; poi < num_events; ++poi) {
+      const int addr = rand(3);
+      if (rand(2) == 0) {
+        thread.push_back(Event(Event::kRead, addr, Iiid(pid, poi)));
+        reads.push_back(thread.back());
+      } else {
+        thread.push_back(Event(Event::kWrite, addr, Iiid(pid, poi)));
+        writes[addr].push_back(thread.back());
+      }
+
+      events->Insert(thread.back());
+      if (poi > 0) {
+        po->Insert(thread[poi - 1], thread[poi]);
+      }
+    }
+
+    for (int i = 0; i < num_events; ++i) {
+      if (rand(4) == 0 && i + 1 < num_events) {
+        mfence->Insert(thread[i], thread[i + 1 + rand(num_events - i - 1)]);
+      }
+    }
+  }
+
+  for (auto& ws : writes) {
+    events->Insert(ws.front());
+    std::shuffle(ws.begin() + 1, ws.end(), *urng);
+    for (std::size_t i = 1; i < ws.size(); ++i) {
+      co->Insert(ws[i - 1], ws[i]);
+    }
+  }
+
+  for (const auto& r : reads) {
+    const auto& ws = writes[r.addr];
+    rf->Insert(ws[rand(static_cast<int>(ws.size()))], r);
+  }
+
+  po->set_props(EventRel::kTransitiveClosure);
+  co->set_props(EventRel::kTransitiveClosure);
+}
+
+TEST(MemConsistency, TsoCheckerDifferential) {
+  std::mt19937 urng(1234);
+  int num_valid = 0;
+  int num_invalid = 0;
+
+  for (int i = 0; i < 2000; ++i) {
+    cats::ExecWitness ew;
+    cats::Arch_TSO tso;
+    RandomExec(&urng, &ew.events, &ew.po, &ew.co, &ew.rf, &tso.mfence);
+    ew.table.ToIdx(ew.events);
+
+    const auto checker = tso.MakeChecker(&tso, &ew);
+    const auto tso_checker =
+        dynamic_cast<const cats::TsoChecker*>(checker.get());
+    ASSERT_TRUE(tso_checker != nullptr);
+    const CheckResult result = checker->check();
+    const CheckResult expected = cats::Checker(&tso, &ew).check();
+    // Not only the same results, but also without falling back.
+    ASSERT_EQ(expected.valid(), tso_checker->tso_acyclic());
+    ASSERT_EQ(expected.verdict, result.verdict);
+    ASSERT_EQ(std::string(expected.valid() ? "" : expected.failed),
+              std::string(result.valid() ? "" : result.failed));
+    ASSERT_TRUE(expected.cycle == result.cycle);
+    ++(result.valid() ? num_valid : num_invalid);
+
+    model12::ExecWitness ew12;
+    model12::Arch_TSO tso12;
+    ew12.events = ew.events;
+    ew12.po = ew.po;
+    ew12.ws = ew.co;
+    ew12.rf = ew.rf;
+    ew12.table.ToIdx(ew12.events);
+    tso12.mfence = tso.mfence;
+
+    const CheckResult result12 = tso12.MakeChecker(&tso12, &ew12)->check();
+    const CheckResult expected12 = model12::Checker(&tso12, &ew12).check();
+    ASSERT_EQ(expected12.verdict, result12.verdict);
+    ASSERT_TRUE(expected12.cycle == result12.cycle);
+    ASSERT_EQ(expected.valid(), expected12.valid());
+  }
+
+  ASSERT_GT(num_valid, 100);
+  ASSERT_GT(num_invalid, 100);
+
+  cats::Arch_TSO tso;
+  tso.set_linear_checker(false);
+  cats::ExecWitness ew;
+  ASSERT_TRUE(dynamic_cast<const cats::TsoChecker*>(
+                  tso.MakeChecker(&tso, &ew).get()) == nullptr);
+}
+
+// TSO without store buffering, i.e. ppo is all of po.
+class Arch_TSONoSB : public cats::Arch_TSO {
+ public:
+  EventRel ppo(const cats::ExecWitness& ew) const override {
+    return ew.program_order().Eval();
+  }
+};
+
+class Arch_TSONoSB12 : public model12::Arch_TSO {
+ public:
+  EventRel ppo(const model12::ExecWitness& ew) const override {
+    return ew.program_order().Eval();
+  }
+};
+
+TEST(MemConsistency, TsoCheckerSubclass) {
+  cats::ExecWitness ew;
+  Arch_TSONoSB arch;
+  model12::ExecWitness ew12;
+  Arch_TSONoSB12 arch12;
+
+  // Store buffering (SB): valid on TSO, but not without store buffering.
+  Event Ix = Event(Event::kWrite, 10, Iiid(-1, 0));
+  Event Iy = Event(Event::kWrite, 20, Iiid(-1, 1));
+
+  Event Wx0 = Event(Event::kWrite, 10, Iiid(0, 12));
+  Event Wy1 = Event(Event::kWrite, 20, Iiid(1, 33));
+  Event Ry0 = Event(Event::kRead, 20, Iiid(0, 55));
+  Event Rx1 = Event(Event::kRead, 10, Iiid(1, 22));
+
+  ew.events |= EventSet({Ix, Iy, Wx0, Wy1, Ry0, Rx1});
+  ew.po.Insert(Wx0, Ry0);
+  ew.po.Insert(Wy1, Rx1);
+  ew.po.set_props(EventRel::kTransitiveClosure);
+  ew.co.Insert(Ix, Wx0);
+  ew.co.Insert(Iy, Wy1);
+  ew.rf.Insert(Ix, Rx1);
+  ew.rf.Insert(Iy, Ry0);
+
+  ew12.events = ew.events;
+  ew12.po = ew.po;
+  ew12.ws = ew.co;
+  ew12.rf = ew.rf;
+
+  const auto checker = arch.MakeChecker(&arch, &ew);
+  ASSERT_TRUE(dynamic_cast<const cats::TsoChecker*>(checker.get()) ==
+              nullptr);
+  ASSERT_FALSE(checker->check().valid());
+
+  const auto checker12 = arch12.MakeChecker(&arch12, &ew12);
+  ASSERT_TRUE(dynamic_cast<const model12::TsoChecker*>(checker12.get()) ==
+              nullptr);
+  ASSERT_FALSE(checker12->check().valid());
+
+  cats::Arch_TSO tso;
+  ASSERT_TRUE(tso.MakeChecker(&tso, &ew)->check().valid());
+}
+
+// ARMv7 with ppo computed by the naive fix-point, i.e. recomputing all
+// compositions in every round, as reference.
+class Arch_ARMv7Naive : public cats::Arch_ARMv7 {
+ public:
+  EventRel ppo(const cats::ExecWitness& ew) const override {
+    EventRel addr, data, ctrl_part;
+    dd_reg.for_each(
+        [&addr, &data, &ctrl_part, this](const Event& e1, const Event& e2) {
+          if (!e1.AnyType(EventTypeRead())) {
+            return;
+          }
+
+          if (e2.AnyType(Event::kMemoryOperation)) {
+            if (e2.AllType(Event::kRegInAddr)) {
+              addr.Insert(e1, e2);
+            }
+
+            if (e2.AllType(Event::kRegInData)) {
+              data.Insert(e1, e2);
+            }
+          }
+
+          if (e2.AllType(Event::kBranch)) {
+            ctrl_part.Insert(e1, e2);
+          }
+        });
+
+    EventRel ctrl = EventRelSeq({ctrl_part, ew.po}).EvalClear();
+    EventRel ctrl_cfence = EventRelSeq({ctrl_part, isb}).EvalClear();
+
+    const auto po_loc = ew.po.Filter(
+        [](const Event& e1, const Event& e2) { return e1.addr == e2.addr; });
+    const auto rfe = ew.rfe();
+    EventRel dd = addr | data;
+    EventRel rdw = po_loc & EventRelSeq({ew.fre(), rfe}).EvalClear();
+    EventRel detour = po_loc & EventRelSeq({ew.coe(), rfe}).EvalClear();
+    EventRel addrpo = EventRelSeq({addr, ew.po}).EvalClear();
+
+    EventRel ci = ctrl_cfence | detour;
+    EventRel ii = dd | ew.rfi() | rdw;
+    EventRel cc = dd | ctrl | addrpo | po_loc;
+    EventRel ic;
+
+    std::size_t total_size = ci.size() + ii.size() + cc.size() + ic.size();
+    std::size_t prev_total_size;
+
+    do {
+      prev_total_size = total_size;
+
+      ci |=
+          EventRelSeq({ci, ii}).EvalClear() | EventRelSeq({cc, ci}).EvalClear();
+
+      ii |= ci | EventRelSeq({ic, ci}).EvalClear() |
+            EventRelSeq({ii, ii}).EvalClear();
+
+      cc |= ci | EventRelSeq({ci, ic}).EvalClear() |
+            EventRelSeq({cc, cc}).EvalClear();
+
+      ic |= ii | cc | EventRelSeq({ic, cc}).EvalClear() |
+            EventRelSeq({ii, ic}).EvalClear();
+
+      total_size = ci.size() + ii.size() + cc.size() + ic.size();
+    } while (total_size != prev_total_size);
+
+    EventRel result = ic.Filter([this](const Event& e1, const Event& e2) {
+      return e1.AnyType(EventTypeRead()) && e2.AnyType(EventTypeWrite());
+    });
+    result |= ii.Filter([this](const Event& e1, const Event& e2) {
+      return e1.AnyType(EventTypeRead()) && e2.AnyType(EventTypeRead());
+    });
+
+    return result;
+  }
+};
+
+TEST(MemConsistency, ARMv7PpoDifferential) {
+  std::mt19937 urng(4321);
+  const auto rand = [&urng](int n) {
+    return std::uniform_int_distribution<int>(0, n - 1)(urng);
+  };
+
+  int num_nonempty = 0;
+
+  for (int i = 0; i < 1000; ++i) {
+    cats::ExecWitness ew;
+    Arch_ARMv7Naive arm;
+    std::vector<std::vector<Event>> writes(2);
+    std::vector<Event> reads;
+
+    for (int addr = 0; addr < 2; ++addr) {
+      writes[addr].push_back(Event(Event::kWrite, addr, Iiid(-1, addr)));
+      ew.events.Insert(writes[addr].back());
+    }
+
+    const int num_threads = 1 + rand(3);
+    for (int pid = 0; pid < num_threads; ++pid) {
+      std::vector<Event> thread;
+      const int num_events = 2 + rand(8);
+      for (int poi = 0; poi < num_events; ++poi) {
+        const int addr = rand(2);
+        const Event::Type regs = (rand(2) == 0 ? Event::kRegInAddr : 0) |
+                                 (rand(2) == 0 ? Event::kRegInData : 0);
+        switch (rand(5)) {
+          case 0:
+            // Branches do not access memory: use a unique address.
+            thread.push_back(
+                Event(Event::kBranch, 100 + pid * 16 + poi, Iiid(pid, poi)));
+            break;
+          case 1:
+          case 2:
+            thread.push_back(Event(Event::kRead | regs, addr, Iiid(pid, poi)));
+            reads.push_back(thread.back());
+            break;
+          default:
+            thread.push_back(
+                Event(Event::kWrite | regs, addr, Iiid(pid, poi)));
+            writes[addr].push_back(thread.back());
+            break;
+        }
+
+        ew.events.Insert(thread.back());
+        if (poi > 0) {
+          ew.po.Insert(thread[poi - 1], thread[poi]);
+        }
+      }
+
+      for (int e1 = 0; e1 < num_events; ++e1) {
+        for (int e2 = e1 + 1; e2 < num_events; ++e2) {
+          if (rand(3) == 0) {
+            arm.dd_reg.Insert(thread[e1], thread[e2]);
+          }
+
+          if (rand(4) == 0) {
+            arm.isb.Insert(thread[e1], thread[e2]);
+          }
+
+          if (rand(8) == 0) {
+            arm.dmb.Insert(thread[e1], thread[e2]);
+          }
+        }
+      }
+    }
+
+    for (auto& ws : writes) {
+      std::shuffle(ws.begin() + 1, ws.end(), urng);
+      for (std::size_t j = 1; j < ws.size(); ++j) {
+        ew.co.Insert(ws[j - 1], ws[j]);
+      }
+    }
+
+    for (const auto& r : reads) {
+      const auto& ws = writes[r.addr];
+      ew.rf.Insert(ws[rand(static_cast<int>(ws.size()))], r);
+    }
+
+    ew.po.set_props(EventRel::kTransitiveClosure);
+    ew.co.set_props(EventRel::kTransitiveClosure);
+
+    const EventRel expected = arm.ppo(ew);
+    ASSERT_TRUE(expected == arm.cats::Arch_ARMv7::ppo(ew));
+    if (!expected.empty()) {
+      ++num_nonempty;
+    }
+  }
+
+  ASSERT_GT(num_nonempty, 500);
+}
@@ -0,0 +1,85 @@
+// This code is licensed under the BSD 3-Clause license. See the LICENSE file
+// in the project root for license terms.
+
+#include "mc2lib/parallel.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace mc2lib::parallel;
+
+TEST(Parallel, ThreadPool) {
+  ThreadPool pool(3);
+  ASSERT_EQ(3u, pool.size());
+
+  std::vector<std::future<std::size_t>> futures;
+  for (std::size_t i = 0; i < 1000; ++i) {
+    futures.push_back(pool.Submit([i]() { return i * i; }));
+  }
+
+  for (std::size_t i = 0; i < futures.size(); ++i) {
+    ASSERT_EQ(i * i, futures[i].get());
+  }
+
+  auto error = pool.Submit([]() -> int { throw std::runtime_error("test"); });
+  ASSERT_THROW(error.get(), std::runtime_error);
+}
+
+TEST(Parallel, ThreadPoolNestedSubmit) {
+  std::atomic<std::size_t> count(0);
+
+  {
+    ThreadPool pool(4);
+
+    // Tasks submitted by workers go to their own queues; idle workers must
+    // steal them. Destruction waits for all tasks.
+    for (std::size_t i = 0; i < 8; ++i) {
+      pool.Submit([&pool, &count]() {
+        for (std::size_t j = 0; j < 100; ++j) {
+          pool.Submit([&count]() { ++count; });
+        }
+      });
+    }
+  }
+
+  ASSERT_EQ(800u, count.load());
+}
+
+TEST(Parallel, ForEach) {
+  ThreadPool pool(3);
+
+  std::vector<std::size_t> result(1000, 0);
+  ForEach(&pool, result.size(), [&result](std::size_t i) { result[i] = i; });
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    ASSERT_EQ(i, result[i]);
+  }
+
+  ForEach(&pool, 0, [](std::size_t) { FAIL(); });
+
+  ASSERT_THROW(ForEach(&pool, 100,
+                       [](std::size_t i) {
+                         if (i == 42) {
+                           throw std::runtime_error("test");
+                         }
+                       }),
+               std::runtime_error);
+}
+
+TEST(Parallel, ForEachNested) {
+  std::atomic<std::size_t> count(0);
+  ThreadPool pool(1);
+
+  // The only worker waits in ForEach, and must not depend on other tasks.
+  pool.Submit([&pool, &count]() {
+        ForEach(&pool, 100, [&pool, &count](std::size_t) {
+          ForEach(&pool, 10, [&count](std::size_t) { ++count; });
+        });
+      }).get();
+
+  ASSERT_EQ(1000u, count.load());
+}
@@ -4,6 +4,11 @@
 #include "mc2lib/memconsistency/eventsets.hpp"
 #include "mc2lib/sets.hpp"
 
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 using namespace mc2lib;
@@ -106,8 +111,8 @@ TEST(Sets, CycleDetectionYes2) {
 
   EventRel::Path p;
   ASSERT_FALSE(er.Acyclic(&p));
-  ASSERT_TRUE(p[1] == p.back());
-  ASSERT_EQ(p.size(), 6);
+  ASSERT_TRUE(p.front() == p.back());
+  ASSERT_EQ(p.size(), 5);
 
   p.clear();
   er.set_props(EventRel::kTransitiveClosure);
@@ -373,3 +378,939 @@ TEST(Sets, EventRelSubset) {
   ASSERT_FALSE(er2.Subset(er1));
   ASSERT_TRUE(er1.Subset(er2));
 }
+
+typedef sets::Set<sets::DenseTypes<Event>> DenseEventSet;
+typedef sets::Relation<sets::DenseTypes<Event>> DenseEventRel;
+typedef sets::RelationSeq<sets::DenseTypes<Event>> DenseEventRelSeq;
+
+TEST(Sets, DenseSet) {
+  Event e1 = ResetEvt();
+  Event e2 = NextEvt();
+  Event e3 = NextEvt();
+
+  DenseEventSet s1({e1, e2});
+  DenseEventSet s2({e2, e3});
+
+  ASSERT_EQ((s1 | s2).size(), 3);
+  ASSERT_EQ((s1 & s2).size(), 1);
+  ASSERT_TRUE((s1 & s2).Contains(e2));
+  ASSERT_EQ((s1 - s2).size(), 1);
+  ASSERT_TRUE((s1 - s2).Contains(e1));
+  ASSERT_TRUE((s1 & s2).Subset(s1));
+  ASSERT_FALSE(s1.SubsetEq(s2));
+  ASSERT_EQ((s1 * s2).size(), 4);
+
+  // Equality must not depend on capacity.
+  DenseEventSet s3 = s1 | s2;
+  s3 -= s2;
+  ASSERT_TRUE(s3 == (s1 - s2));
+  s3.Erase(e1);
+  ASSERT_TRUE(s3 == DenseEventSet());
+  ASSERT_TRUE(s3.empty());
+
+  const DenseEventSet s4 = s1 | s2;
+  std::size_t count = 0;
+  for (const auto& e : s4.get()) {
+    ASSERT_TRUE(e == e1 || e == e2 || e == e3);
+    ++count;
+  }
+  ASSERT_EQ(count, 3);
+}
+
+TEST(Sets, DenseRelMatchesHashed) {
+  Event e1 = ResetEvt();
+  Event e2;
+
+  EventRel er;
+  DenseEventRel der;
+  for (int i = 0; i < 32; ++i) {
+    e2 = NextEvt();
+    er.Insert(e1, e2);
+    der.Insert(e1, e2);
+    if (i % 3 == 0) {
+      e1 = e2;
+    }
+  }
+
+  ASSERT_EQ(er.size(), der.size());
+  ASSERT_TRUE(der.Acyclic());
+
+  er.set_props(EventRel::kTransitiveClosure);
+  der.set_props(DenseEventRel::kTransitiveClosure);
+  ASSERT_EQ(er.size(), der.size());
+  ASSERT_EQ(er.Eval().size(), der.Eval().size());
+
+  DenseEventRelSeq ders;
+  ders += der;
+  ders += der.Inverse();
+  EventRelSeq ers;
+  ers += er;
+  ers += er.Inverse();
+  ASSERT_EQ(ders.Eval().size(), ers.Eval().size());
+
+  DenseEventRel der2 = der.Eval();
+  der2.Insert(e2, ResetEvt());
+  ASSERT_FALSE(der2.Acyclic());
+  ASSERT_TRUE(der.SubsetEq(der2));
+  ASSERT_EQ((der2 - der.Eval()).size(), 1);
+}
+
+TEST(Sets, DenseInternScope) {
+  typedef sets::Interner<Event, Event::Hash> Interner;
+  typedef sets::InternScope<Interner> InternScope;
+
+  Interner table1;
+  Interner table2;
+  const Event e1 = ResetEvt();
+  const Event e2 = NextEvt();
+
+  {
+    const InternScope scope(&table1);
+    const DenseEventSet s({e1, e2});
+    ASSERT_EQ(2u, table1.size());
+    ASSERT_EQ(0u, table1.Find(e1));
+
+    {
+      // Indexed independently of table1.
+      const InternScope nested(&table2);
+      const DenseEventSet s2({e2});
+      ASSERT_EQ(0u, table2.Find(e2));
+      ASSERT_TRUE(s2.Contains(e2));
+      ASSERT_FALSE(s2.Contains(e1));
+    }
+
+    ASSERT_TRUE(Interner::Current() == &table1);
+    ASSERT_TRUE(s.Contains(e2));
+
+    // Elements already interned are only looked up: other threads may use
+    // the same table concurrently.
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.push_back(std::thread([&table1, &s, e1, e2]() {
+        const InternScope thread_scope(&table1);
+        const DenseEventSet s3({e2, e1});
+        EXPECT_TRUE(s3 == s);
+      }));
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    ASSERT_EQ(2u, table1.size());
+  }
+
+  ASSERT_TRUE(Interner::Current() == nullptr);
+  ASSERT_EQ(1u, table2.size());
+}
+
+typedef sets::Set<sets::FlatTypes<Event>> FlatEventSet;
+typedef sets::Relation<sets::FlatTypes<Event>> FlatEventRel;
+typedef sets::Set<sets::FlatTypes<types::Addr, std::hash<types::Addr>>>
+    FlatAddrSet;
+
+TEST(Sets, FlatSetMatchesHashed) {
+  std::default_random_engine urng(77);
+  std::uniform_int_distribution<types::Addr> dist(0, 199);
+
+  sets::Set<sets::Types<types::Addr, std::hash<types::Addr>>> expected;
+  FlatAddrSet s;
+  for (int i = 0; i < 2000; ++i) {
+    const types::Addr addr = dist(urng);
+    if (i % 3 == 0) {
+      ASSERT_EQ(s.Erase(addr), expected.Erase(addr));
+    } else {
+      s.Insert(addr);
+      expected.Insert(addr);
+    }
+
+    ASSERT_EQ(s.size(), expected.size());
+  }
+
+  for (types::Addr addr = 0; addr < 200; ++addr) {
+    ASSERT_EQ(s.Contains(addr), expected.Contains(addr));
+  }
+
+  std::size_t count = 0;
+  for (const auto& addr : s.get()) {
+    ASSERT_TRUE(expected.Contains(addr));
+    ++count;
+  }
+  ASSERT_EQ(count, expected.size());
+
+  FlatAddrSet half;
+  for (types::Addr addr = 0; addr < 100; ++addr) {
+    half.Insert(addr);
+  }
+
+  FlatAddrSet moved = std::move(half);
+  ASSERT_TRUE(half.empty());
+  half.Insert(1);
+  ASSERT_EQ(half.size(), 1);
+
+  ASSERT_EQ((s & moved).size(), (s - (s - moved)).size());
+  ASSERT_TRUE((s & moved).SubsetEq(moved));
+  ASSERT_EQ((s | moved).size(), s.size() + moved.size() - (s & moved).size());
+}
+
+// Exposes the probe lengths of a FlatSetContainer.
+class ProbedAddrContainer
+    : public sets::FlatSetContainer<types::Addr, std::hash<types::Addr>> {
+ public:
+  std::size_t MaxProbeLength() const {
+    const std::size_t mask = slots_.size() - 1;
+    std::size_t result = 0;
+    for (std::size_t idx = NextFull(0); idx != npos();
+         idx = NextFull(idx + 1)) {
+      result = std::max(result, (idx - Bucket(slots_[idx])) & mask);
+    }
+
+    return result;
+  }
+};
+
+TEST(Sets, FlatSetSlotOrderInsert) {
+  ProbedAddrContainer large;
+  for (types::Addr addr = 0; addr < (1 << 16); ++addr) {
+    large.insert(addr);
+  }
+  ASSERT_LT(large.MaxProbeLength(), 64u);
+
+  // Keys in the slot order of a larger table (e.g. when copying a prefix of
+  // it) must not cluster in smaller tables.
+  ProbedAddrContainer prefix;
+  for (auto it = large.begin(); prefix.size() < large.size() / 8; ++it) {
+    prefix.insert(*it);
+  }
+  ASSERT_LT(prefix.MaxProbeLength(), 64u);
+}
+
+TEST(Sets, FlatRelMatchesHashed) {
+  Event e1 = ResetEvt();
+  Event e2;
+
+  EventRel er;
+  FlatEventRel fer;
+  for (int i = 0; i < 32; ++i) {
+    e2 = NextEvt();
+    er.Insert(e1, e2);
+    fer.Insert(e1, e2);
+    if (i % 3 == 0) {
+      e1 = e2;
+    }
+  }
+
+  ASSERT_EQ(er.size(), fer.size());
+  ASSERT_TRUE(fer.Acyclic());
+
+  er.set_props(EventRel::kTransitiveClosure);
+  fer.set_props(FlatEventRel::kTransitiveClosure);
+  ASSERT_EQ(er.size(), fer.size());
+  ASSERT_EQ(er.Eval().size(), fer.Eval().size());
+
+  FlatEventRel fer2 = fer.Eval();
+  fer2.Insert(e2, ResetEvt());
+  ASSERT_FALSE(fer2.Acyclic());
+  ASSERT_TRUE(fer.SubsetEq(fer2));
+  ASSERT_EQ((fer2 - fer.Eval()).size(), 1);
+
+  const FlatEventSet domain = fer2.Domain();
+  ASSERT_EQ(domain.size(), er.Domain().size() + 1);
+}
+
+typedef sets::Set<sets::SmallTypes<Event>> SmallEventSet;
+typedef sets::Relation<sets::SmallTypes<Event>> SmallEventRel;
+
+TEST(Sets, SmallSetMatchesHashed) {
+  std::default_random_engine urng(78);
+  std::uniform_int_distribution<int> dist(0, 7);
+
+  std::vector<Event> evts;
+  evts.push_back(ResetEvt());
+  for (int i = 1; i < 8; ++i) {
+    evts.push_back(NextEvt());
+  }
+
+  // Same iiid, but not equal.
+  evts[7] = evts[6];
+  evts[7].addr += 1;
+
+  for (int round = 0; round < 50; ++round) {
+    EventSet expected;
+    SmallEventSet s;
+    for (int i = 0; i < 12; ++i) {
+      const Event& e = evts[dist(urng)];
+      if (i % 4 == 3) {
+        ASSERT_EQ(s.Erase(e), expected.Erase(e));
+      } else {
+        s.Insert(e);
+        expected.Insert(e);
+      }
+
+      ASSERT_EQ(s.size(), expected.size());
+      for (const auto& e2 : evts) {
+        ASSERT_EQ(s.Contains(e2), expected.Contains(e2));
+      }
+    }
+
+    std::size_t count = 0;
+    for (const auto& e : s.get()) {
+      ASSERT_TRUE(expected.Contains(e));
+      ++count;
+    }
+    ASSERT_EQ(count, expected.size());
+
+    const SmallEventSet copy = s;
+    ASSERT_TRUE(copy == s);
+    ASSERT_EQ(copy.get().spilled(), s.get().spilled());
+  }
+}
+
+TEST(Sets, SmallRelMatchesHashed) {
+  Event e1 = ResetEvt();
+  Event e2;
+
+  EventRel er;
+  SmallEventRel ser;
+  for (int i = 0; i < 32; ++i) {
+    e2 = NextEvt();
+    er.Insert(e1, e2);
+    ser.Insert(e1, e2);
+    if (i % 7 == 0) {
+      e1 = e2;
+    }
+  }
+
+  ASSERT_EQ(er.size(), ser.size());
+  ASSERT_TRUE(ser.Acyclic());
+
+  er.set_props(EventRel::kTransitiveClosure);
+  ser.set_props(SmallEventRel::kTransitiveClosure);
+  ASSERT_EQ(er.size(), ser.size());
+  ASSERT_EQ(er.Eval().size(), ser.Eval().size());
+
+  SmallEventRel ser2 = ser.Filter(
+      [](const Event& e1, const Event& e2) { return e1.iiid < e2.iiid; });
+  ser2.Insert(e2, ResetEvt());
+  ASSERT_FALSE(ser2.Acyclic());
+  ASSERT_EQ((ser2 - ser.Eval()).size(), 1);
+}
+
+typedef sets::Types<Event, Event::Hash, sets::ArenaAllocator<Event>>
+    ArenaEventTypes;
+typedef sets::Relation<ArenaEventTypes> ArenaEventRel;
+
+TEST(Sets, ArenaAllocator) {
+  sets::Arena arena(1024);
+  Event e1 = ResetEvt();
+  Event e2;
+
+  // Allocated from heap, but modified within scope.
+  ArenaEventRel heap_rel;
+  heap_rel.Insert(e1, NextEvt());
+  ASSERT_EQ(arena.allocated(), 0);
+
+  {
+    const sets::ArenaScope scope(&arena);
+
+    ArenaEventRel er;
+    for (int i = 0; i < 100; ++i) {
+      e2 = NextEvt();
+      er.Insert(e1, e2);
+      heap_rel.Insert(e2, e1);
+      e1 = e2;
+    }
+
+    ASSERT_GT(arena.allocated(), 1024);
+    er.set_props(ArenaEventRel::kTransitiveClosure);
+    ASSERT_EQ(er.Eval().size(), 100 * 101 / 2);
+    ASSERT_FALSE((er | heap_rel).Acyclic());
+
+    {
+      const sets::ArenaScope nested(nullptr);
+      const std::size_t allocated = arena.allocated();
+      ASSERT_EQ(ArenaEventRel(heap_rel).size(), heap_rel.size());
+      ASSERT_EQ(arena.allocated(), allocated);
+    }
+  }
+
+  ASSERT_TRUE(sets::Arena::Current() == nullptr);
+  heap_rel.Erase(ResetEvt(), NextEvt());
+  heap_rel = ArenaEventRel();
+  arena.Release();
+  ASSERT_EQ(arena.allocated(), 0);
+}
+
+TEST(Sets, Generation) {
+  Event e1 = Event(Event::kWrite, 10, Iiid(0, 0));
+  Event e2 = Event(Event::kRead, 10, Iiid(1, 0));
+
+  EventSet es;
+  const auto es_gen = es.generation();
+  ASSERT_NE(0u, es_gen);
+  ASSERT_EQ(es_gen, es.generation());
+  es.Insert(e1);
+  ASSERT_NE(es_gen, es.generation());
+
+  // Copies share contents, and therefore the generation.
+  EventSet es_copy = es;
+  ASSERT_EQ(es.generation(), es_copy.generation());
+  es_copy.Insert(e2);
+  ASSERT_NE(es.generation(), es_copy.generation());
+
+  EventRel er;
+  auto er_gen = er.generation();
+  er.Insert(e1, e2);
+  ASSERT_NE(er_gen, er.generation());
+  er_gen = er.generation();
+  ASSERT_TRUE(er.R(e1, e2));
+  ASSERT_EQ(er_gen, er.generation());
+  er.set_props(EventRel::kReflexiveClosure);
+  ASSERT_NE(er_gen, er.generation());
+  er_gen = er.generation();
+
+  EventRel er_moved = std::move(er);
+  ASSERT_EQ(er_gen, er_moved.generation());
+  ASSERT_NE(er_gen, er.generation());
+}
+
+TEST(Sets, EventTable) {
+  Event e1 = ResetEvt();
+  Event e2 = e1;
+  e2.iiid.pid = 1;
+  Event e3 = e1;
+  e3.addr += 1;
+
+  ASSERT_NE(Event::Hash()(e1), Event::Hash()(e2));
+  ASSERT_NE(Event::Hash()(e1), Event::Hash()(e3));
+
+  EventTable table;
+  ASSERT_EQ(table.Insert(e1), 0);
+  ASSERT_EQ(table.Insert(e2), 1);
+  ASSERT_EQ(table.Insert(e1), 0);
+  ASSERT_EQ(table.Find(e3), EventTable::kInvalid);
+
+  EventRel er;
+  er.Insert(e1, e2);
+  er.Insert(e2, e3);
+  er.set_props(EventRel::kTransitiveClosure);
+
+  const EventIdxRel ier = table.ToIdx(er);
+  ASSERT_EQ(table.size(), 3);
+  ASSERT_TRUE(ier.props() == EventRel::kTransitiveClosure);
+  ASSERT_TRUE(ier.R(0, 2));
+  ASSERT_FALSE(ier.R(2, 0));
+  ASSERT_EQ(ier.size(), 3);
+  ASSERT_TRUE(table.ToEvents(ier) == er);
+  ASSERT_TRUE(table.ToEvents(ier.Domain()) == er.Domain());
+}
+
+TEST(Sets, ProgramOrder) {
+  std::default_random_engine urng(99);
+  std::uniform_int_distribution<int> dist_addr(0, 3);
+
+  Event e = ResetEvt();
+  EventRel po;
+  std::vector<Event> evts;
+  for (types::Pid pid = 0; pid < 3; ++pid) {
+    e.iiid.pid = pid;
+    e.iiid.poi = 0;
+    for (int i = 0; i < 10; ++i) {
+      Event next = e;
+      next.iiid.poi = i + 1;
+      next.addr = dist_addr(urng);
+      po.Insert(e, next);
+      evts.push_back(e);
+      e = next;
+    }
+    evts.push_back(e);
+  }
+  po.set_props(EventRel::kTransitiveClosure);
+
+  const ProgramOrder program_order(po);
+  ASSERT_TRUE(program_order.valid());
+  ASSERT_EQ(program_order.chains().size(), 3);
+  ASSERT_EQ(program_order.size(), po.size());
+  ASSERT_TRUE(program_order.Eval() == po.Eval());
+  ASSERT_TRUE(program_order.Chains().Eval() == po.Eval());
+
+  for (const auto& e1 : evts) {
+    ASSERT_EQ(program_order.Reachable(e1).size(), po.Reachable(e1).size());
+    for (const auto& e2 : evts) {
+      ASSERT_EQ(program_order.R(e1, e2), po.R(e1, e2));
+    }
+  }
+
+  const auto same_addr = [](const Event& e1, const Event& e2) {
+    return e1.addr == e2.addr;
+  };
+  const ProgramOrder po_loc =
+      program_order.Partition([](const Event& e) { return e.addr; });
+  ASSERT_TRUE(po_loc.Eval() == po.Filter(same_addr));
+  ASSERT_TRUE(program_order.Filter(same_addr) == po.Filter(same_addr));
+
+  EventRel lhs;
+  lhs.Insert(evts[0], evts[3]);
+  lhs.Insert(evts[12], evts[25]);
+  ASSERT_TRUE(program_order.Seq(lhs) == EventRelSeq({lhs, po}).EvalClear());
+
+  // Not chains.
+  EventRel branch = po;
+  branch.Insert(evts[0], evts[2]);
+  ASSERT_FALSE(ProgramOrder(branch).valid());
+
+  EventRel cycle = po;
+  cycle.Insert(evts[10], evts[0]);
+  ASSERT_FALSE(ProgramOrder(cycle).valid());
+  ASSERT_TRUE(ProgramOrder(cycle).empty());
+}
+
+TEST(Sets, CoherenceOrder) {
+  std::default_random_engine urng(100);
+
+  // Per address: initial write, then writes of 3 threads in random order.
+  Event e = ResetEvt();
+  std::vector<std::vector<Event>> writes(4);
+  for (types::Addr addr = 0; addr < writes.size(); ++addr) {
+    for (types::Pid pid = 0; pid < 4; ++pid) {
+      e.iiid.pid = pid;
+      e.iiid.poi = addr;
+      e.addr = addr;
+      e.type = Event::kWrite;
+      writes[addr].push_back(e);
+    }
+    std::shuffle(writes[addr].begin() + 1, writes[addr].end(), urng);
+  }
+
+  EventRel co_chains;
+  EventRel co_closure;
+  EventRel rf;
+  for (const auto& ws : writes) {
+    for (std::size_t i = 0; i < ws.size(); ++i) {
+      if (i > 0) {
+        co_chains.Insert(ws[i - 1], ws[i]);
+      }
+
+      for (std::size_t j = i + 1; j < ws.size(); ++j) {
+        co_closure.Insert(ws[i], ws[j]);
+      }
+
+      Event r = ws[i];
+      r.type = Event::kRead;
+      r.iiid.poi += 100;
+      rf.Insert(ws[i], r);
+      r.iiid.pid = (r.iiid.pid + 1) % 4;
+      rf.Insert(ws[i], r);
+    }
+  }
+
+  ASSERT_FALSE(CoherenceOrder(co_chains).valid());
+  co_chains.set_props(EventRel::kTransitiveClosure);
+
+  const auto all = [](const EventRel::Tuple&, const EventRel::Tuple&) {
+    return true;
+  };
+
+  EventRel expected;
+  for (const auto& rf_tuples : rf.get()) {
+    const EventSet co_reach = co_closure.Reachable(rf_tuples.first);
+    for (const auto& w : co_reach.get()) {
+      for (const auto& r : rf_tuples.second.get()) {
+        expected.Insert(r, w);
+      }
+    }
+  }
+
+  for (const EventRel* co : {&co_chains, &co_closure}) {
+    const CoherenceOrder coherence_order(*co);
+    ASSERT_TRUE(coherence_order.valid());
+    ASSERT_TRUE(coherence_order.Fr(rf, all) == expected);
+
+    EventRel fri, fre;
+    coherence_order.Fr(rf, &fri, &fre);
+    ASSERT_TRUE((fri | fre) == expected);
+    ASSERT_TRUE((fri & fre).empty());
+    fri.for_each([](const Event& e1, const Event& e2) {
+      ASSERT_EQ(e1.iiid.pid, e2.iiid.pid);
+    });
+
+    for (const auto& ws : writes) {
+      for (const auto& w1 : ws) {
+        for (const auto& w2 : ws) {
+          ASSERT_EQ(coherence_order.R(w1, w2), co_closure.R(w1, w2));
+        }
+      }
+    }
+  }
+
+  // Not total.
+  EventRel co_partial = co_closure;
+  co_partial.Erase(writes[0][1], writes[0][2]);
+  ASSERT_FALSE(CoherenceOrder(co_partial).valid());
+
+  // Cross-address.
+  EventRel co_cross = co_closure;
+  co_cross.Insert(writes[0][3], writes[1][0]);
+  ASSERT_FALSE(CoherenceOrder(co_cross).valid());
+
+  // Cyclic.
+  co_chains.Insert(writes[2][3], writes[2][0]);
+  ASSERT_FALSE(CoherenceOrder(co_chains).valid());
+}
+
+TEST(Sets, EventRelLongChain) {
+  // Deep enough to overflow the stack with a recursive search.
+  constexpr std::size_t kLength = 200000;
+
+  // Poi is too narrow; use addresses to create distinct events.
+  Event e1 = ResetEvt();
+  const Event first = e1;
+  Event e2 = e1;
+
+  EventRel er;
+  for (std::size_t i = 0; i < kLength; ++i) {
+    ++e2.addr;
+    er.Insert(e1, e2);
+    e1 = e2;
+  }
+  er.set_props(EventRel::kTransitiveClosure);
+
+  EventRel::SearchState state;
+  ASSERT_TRUE(er.R(first, e2, nullptr, &state));
+  ASSERT_FALSE(er.R(e2, first, nullptr, &state));
+  ASSERT_EQ(er.Reachable(first, &state).size(), kLength);
+  ASSERT_TRUE(er.Acyclic());
+
+  EventRel::Path p;
+  er.Insert(e2, first);
+  ASSERT_FALSE(er.Acyclic(&p));
+  ASSERT_EQ(p.size(), kLength + 2);
+  ASSERT_TRUE(p.front() == p.back());
+  ASSERT_EQ(er.Reachable(first, &state).size(), kLength + 1);
+}
+
+TEST(Sets, EventRelScc) {
+  Event e1 = ResetEvt();
+  const Event a = e1;
+  const Event b = NextEvt();
+  const Event c = NextEvt();
+  const Event d = NextEvt();
+  const Event e = NextEvt();
+
+  // a -> {b <-> c} -> d; e -> e
+  EventRel er;
+  er.Insert(a, b);
+  er.Insert(b, c);
+  er.Insert(c, b);
+  er.Insert(c, d);
+  er.Insert(e, e);
+
+  sets::SccDecomposition<EventTypes> sccs;
+  EventRel::Path p;
+  ASSERT_FALSE(er.Acyclic(&p, &sccs));
+  ASSERT_EQ(sccs.num_nodes(), 5);
+  ASSERT_EQ(sccs.num_components(), 4);
+  ASSERT_EQ(sccs.ComponentOf(b), sccs.ComponentOf(c));
+  ASSERT_NE(sccs.ComponentOf(a), sccs.ComponentOf(b));
+  ASSERT_TRUE(sccs.Cyclic(sccs.ComponentOf(b)));
+  ASSERT_TRUE(sccs.Cyclic(sccs.ComponentOf(e)));
+  ASSERT_FALSE(sccs.Cyclic(sccs.ComponentOf(a)));
+
+  // Reverse topological order.
+  ASSERT_GT(sccs.ComponentOf(a), sccs.ComponentOf(b));
+  ASSERT_GT(sccs.ComponentOf(b), sccs.ComponentOf(d));
+
+  ASSERT_TRUE(p.front() == p.back());
+  if (p.size() == 2) {
+    ASSERT_TRUE(p.front() == e);
+  } else {
+    ASSERT_EQ(p.size(), 3);
+    ASSERT_TRUE(p[0] == b || p[0] == c);
+    ASSERT_TRUE(p[1] == b || p[1] == c);
+  }
+
+  er.Erase(e, e);
+  er.Erase(c, b);
+  ASSERT_TRUE(er.Acyclic(nullptr, &sccs));
+  ASSERT_EQ(sccs.num_components(), 4);
+  ASSERT_EQ(sccs.ComponentOf(e), decltype(sccs)::kInvalid);
+}
+
+TEST(Sets, EventRelClosureMatchesSearch) {
+  std::default_random_engine urng(1238);
+  std::uniform_int_distribution<int> dist(0, 39);
+
+  std::vector<Event> evts;
+  evts.push_back(ResetEvt());
+  for (int i = 1; i < 40; ++i) {
+    evts.push_back(NextEvt());
+  }
+
+  for (const EventRel::Properties props :
+       {EventRel::kTransitiveClosure, EventRel::kReflexiveTransitiveClosure}) {
+    EventRel er;
+    for (int i = 0; i < 60; ++i) {
+      er.Insert(evts[dist(urng)], evts[dist(urng)]);
+    }
+    er.set_props(props);
+
+    EventRel expected;
+    const EventSet domain = er.Domain();
+    for (const auto& e1 : domain.get()) {
+      expected.Insert(e1, er.Reachable(e1));
+    }
+
+    const EventRel evald = er.Eval();
+    ASSERT_EQ(evald.size(), expected.size());
+    ASSERT_EQ(er.size(), expected.size());
+    ASSERT_TRUE(evald == expected);
+  }
+}
+
+TEST(Sets, EventRelSeqMatchesNaive) {
+  std::default_random_engine urng(4321);
+  std::uniform_int_distribution<int> dist(0, 24);
+
+  std::vector<Event> evts;
+  evts.push_back(ResetEvt());
+  for (int i = 1; i < 25; ++i) {
+    evts.push_back(NextEvt());
+  }
+
+  for (int round = 0; round < 10; ++round) {
+    EventRel rels[3];
+    for (auto& er : rels) {
+      for (int i = 0; i < 15; ++i) {
+        er.Insert(evts[dist(urng)], evts[dist(urng)]);
+      }
+    }
+    rels[1].set_props(EventRel::kTransitiveClosure);
+    rels[2].set_props(EventRel::kReflexiveClosure);
+
+    const EventRelSeq ers({rels[0], rels[1], rels[2]});
+
+    EventRel expected;
+    for (const auto& e1 : evts) {
+      for (const auto& e2 : evts) {
+        for (const auto& x : evts) {
+          for (const auto& y : evts) {
+            if (rels[0].R(e1, x) && rels[1].R(x, y) && rels[2].R(y, e2)) {
+              expected.Insert(e1, e2);
+            }
+          }
+        }
+      }
+    }
+
+    ASSERT_TRUE(ers.Eval() == expected);
+
+    for (const auto& e1 : evts) {
+      for (const auto& e2 : evts) {
+        EventRel::Path p;
+        ASSERT_EQ(ers.R(e1, e2, &p), expected.R(e1, e2));
+        if (expected.R(e1, e2)) {
+          ASSERT_TRUE(p.front() == e1);
+          ASSERT_TRUE(p.back() == e2);
+        }
+      }
+    }
+
+    EventRel::Path cyclic;
+    ASSERT_EQ(ers.Irreflexive(&cyclic), expected.Irreflexive());
+    if (!cyclic.empty()) {
+      ASSERT_TRUE(cyclic.front() == cyclic.back());
+    }
+  }
+}
+
+TEST(Sets, EventRelOnlineOrder) {
+  std::default_random_engine urng(42);
+  std::uniform_int_distribution<int> dist(0, 29);
+
+  std::vector<Event> evts;
+  evts.push_back(ResetEvt());
+  for (int i = 1; i < 30; ++i) {
+    evts.push_back(NextEvt());
+  }
+
+  for (int round = 0; round < 20; ++round) {
+    EventRel er;
+    er.set_online_order(true);
+
+    for (int i = 0; i < 100; ++i) {
+      const int a = dist(urng);
+      const int b = dist(urng);
+      // Mostly edges from higher to lower index (acyclic, but inserted in
+      // random order to exercise reordering); occasionally a back-edge.
+      const bool back = i % 7 == 0;
+      const Event& e1 = evts[back ? std::min(a, b) : std::max(a, b)];
+      const Event& e2 = evts[back ? std::max(a, b) : std::min(a, b)];
+      const EventRel copy = er;
+
+      er.Insert(e1, e2);
+
+      // Copy is unaffected.
+      ASSERT_EQ(copy.Acyclic(), EventRel(copy.get()).Acyclic());
+
+      EventRel::Path p;
+      const bool acyclic = er.Acyclic(&p);
+      ASSERT_EQ(acyclic, EventRel(er.get()).Acyclic());
+
+      if (!acyclic) {
+        ASSERT_TRUE(p.front() == p.back());
+        for (std::size_t j = 0; j + 1 < p.size(); ++j) {
+          ASSERT_TRUE(er.R(p[j], p[j + 1]));
+        }
+
+        // Remove last edge of cycle; falls back to full check.
+        er.Erase(p[p.size() - 2], p.back());
+        ASSERT_EQ(er.Acyclic(), EventRel(er.get()).Acyclic());
+        continue;
+      }
+
+      const auto order = er.online_order();
+      for (const auto& tuples : er.get()) {
+        for (const auto& e : tuples.second.get()) {
+          ASSERT_LT(order->Position(tuples.first), order->Position(e));
+        }
+      }
+    }
+  }
+}
+
+TEST(Sets, EventRelReachableModified) {
+  Event e1 = ResetEvt();
+  const Event start = e1;
+  Event e2;
+
+  EventRel er;
+  er.Insert(e1, e2 = NextEvt());
+  er.Insert(e2, e1 = NextEvt());
+  er.Insert(e1, e2 = NextEvt());
+  er.set_props(EventRel::kTransitiveClosure);
+  ASSERT_EQ(er.Reachable(start).size(), 3);
+
+  EventRel copy = er;
+  copy.Insert(e2, e1 = NextEvt());
+  ASSERT_EQ(copy.Reachable(start).size(), 4);
+  ASSERT_EQ(er.Reachable(start).size(), 3);
+
+  er.unset_props(EventRel::kTransitiveClosure);
+  ASSERT_EQ(er.Reachable(start).size(), 1);
+  er.set_props(EventRel::kTransitiveClosure);
+  ASSERT_EQ(er.Reachable(start).size(), 3);
+
+  er.Erase(start, er.Reachable(start));
+  ASSERT_EQ(er.Reachable(start).size(), 0);
+}
+
+TEST(Sets, EventRelReachableCache) {
+  Event e1 = ResetEvt();
+  const Event start = e1;
+  Event e2;
+
+  EventRel er;
+  er.Insert(e1, e2 = NextEvt());
+  er.Insert(e2, e1 = NextEvt());
+  er.Insert(e1, e2 = NextEvt());
+  er.set_props(EventRel::kTransitiveClosure);
+  er.set_reachable_cache(true);
+
+  EventRel::SearchState state;
+  ASSERT_EQ(er.Reachable(start, &state).size(), 3);
+  ASSERT_EQ(er.Reachable(start, &state).size(), 3);
+  ASSERT_EQ(state.reachable_cache_stats().misses, 1);
+  ASSERT_EQ(state.reachable_cache_stats().hits, 1);
+
+  // Copies are of the same generation until modified.
+  EventRel copy = er;
+  ASSERT_EQ(copy.Reachable(start, &state).size(), 3);
+  ASSERT_EQ(state.reachable_cache_stats().hits, 2);
+
+  copy.Insert(e2, e1 = NextEvt());
+  ASSERT_EQ(copy.Reachable(start, &state).size(), 4);
+  ASSERT_EQ(er.Reachable(start, &state).size(), 3);
+  ASSERT_EQ(state.reachable_cache_stats().misses, 3);
+
+  er.unset_props(EventRel::kTransitiveClosure);
+  ASSERT_EQ(er.Reachable(start, &state).size(), 1);
+  er.set_props(EventRel::kTransitiveClosure);
+  ASSERT_EQ(er.Reachable(start, &state).size(), 3);
+  ASSERT_EQ(state.reachable_cache_stats().misses, 4);
+  ASSERT_EQ(state.reachable_cache_stats().hits, 2);
+
+  // Concurrent queries, with a state each.
+  const auto table = EventTable::Current();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.push_back(std::thread([&er, start, table]() {
+      const EventTableScope table_scope(table);
+      EventRel::SearchState thread_state;
+      for (int j = 0; j < 10; ++j) {
+        EXPECT_EQ(er.Reachable(start, &thread_state).size(), 3);
+        EXPECT_EQ(er.Reachable(start).size(), 3);
+      }
+      EXPECT_EQ(thread_state.reachable_cache_stats().misses, 1);
+      EXPECT_EQ(thread_state.reachable_cache_stats().hits, 9);
+    }));
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  er.Erase(start, er.Reachable(start));
+  ASSERT_EQ(er.Reachable(start, &state).size(), 0);
+}
+
+TEST(Sets, EventRelDefaultSearchState) {
+  Event e1 = ResetEvt();
+  const Event start = e1;
+  Event e2;
+
+  EventRel chain;
+  for (int i = 0; i < 100; ++i) {
+    chain.Insert(e1, e2 = NextEvt());
+    e1 = e2;
+  }
+  chain.set_props(EventRel::kTransitiveClosure);
+  const Event last = e2;
+
+  EventRel cycle = chain;
+  cycle.Insert(last, start);
+
+  // Queries without a SearchState share one per thread: interleaved queries
+  // on different relations, within an arena, or by other threads must not
+  // interfere.
+  const auto check = [&chain, &cycle, start, last]() {
+    EXPECT_TRUE(chain.R(start, last));
+    EXPECT_FALSE(chain.R(last, start));
+    EXPECT_TRUE(cycle.R(last, start));
+    EXPECT_EQ(100u, chain.Reachable(start).size());
+    EXPECT_EQ(101u, cycle.Reachable(last).size());
+    EXPECT_TRUE(chain.Reachable(last).empty());
+  };
+
+  check();
+  check();
+
+  {
+    sets::Arena arena;
+    const sets::ArenaScope scope(&arena);
+    check();
+  }
+  check();
+
+  const auto table = EventTable::Current();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.push_back(std::thread([&check, table]() {
+      const EventTableScope table_scope(table);
+      check();
+    }));
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}